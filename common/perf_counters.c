@@ -0,0 +1,323 @@
+#include <errno.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perf_counters.h"
+
+// Deepest nesting of open phases.
+#define MAX_COUNTER_DEPTH 8
+// The counters, then the ratios of them reported alongside.
+#define NUM_METRICS (NUM_COUNTERS + 3)
+
+const char * counter_names[NUM_COUNTERS] = { "cycles", "instructions", "cache_references", "cache_misses", "branches", "branch_misses", "task_clock_ns" };
+static const char * metric_names[NUM_METRICS] = { "cycles", "instructions", "cache_references", "cache_misses", "branches", "branch_misses", "task_clock_ns", "instructions_per_cycle", "cache_miss_rate", "branch_miss_rate" };
+
+#ifdef __linux__
+// The event behind each counter. The task clock is counted by the kernel, so
+// is usually there even where the hardware counters are not.
+static const unsigned int counter_types[NUM_COUNTERS] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE };
+static const unsigned long long counter_configs[NUM_COUNTERS] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_TASK_CLOCK };
+#endif
+
+static int counting = 0;
+static MPI_Comm counters_comm;
+// -1 for counters that could not be opened.
+static int counter_fds[NUM_COUNTERS];
+// Why the first counter that could not be opened was not, or 0.
+static int counter_error = 0;
+static struct counted_phase counted_phases[MAX_COUNTED_PHASES];
+static int num_counted_phases = 0;
+// The phases currently open and the counters when each was begun.
+static int open_counted_phases[MAX_COUNTER_DEPTH];
+static double open_counter_values[MAX_COUNTER_DEPTH][NUM_COUNTERS];
+static int counter_depth = 0;
+
+// Read a counter, scaled up for any time the kernel had it switched out to
+// share the hardware with other counters.
+static double read_counter( int fd ){
+#ifdef __linux__
+	unsigned long long reading[3];
+	if( read( fd, reading, sizeof(reading) ) != sizeof(reading) || reading[2] == 0 ){
+		return 0.0;
+	}
+	return (double)reading[0] * ((double)reading[1] / reading[2]);
+#else
+	return 0.0;
+#endif
+}
+
+// Must be called by every rank of comm, which counters_finish gathers over.
+void counters_init( int enabled, MPI_Comm comm ){
+	counting = enabled;
+	if( !counting ){
+		return;
+	}
+	counters_comm = comm;
+	num_counted_phases = 0;
+	counter_depth = 0;
+	counter_error = 0;
+	for( int counter=0; counter<NUM_COUNTERS; counter++ ){
+		counter_fds[counter] = -1;
+#ifdef __linux__
+		// Only this process, in user space, so the default paranoia allows it.
+		struct perf_event_attr attributes;
+		memset( &attributes, 0, sizeof(attributes) );
+		attributes.size = sizeof(attributes);
+		attributes.type = counter_types[counter];
+		attributes.config = counter_configs[counter];
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		counter_fds[counter] = syscall( SYS_perf_event_open, &attributes, 0, -1, -1, 0 );
+		if( counter_fds[counter] < 0 && counter_error == 0 ){
+			counter_error = errno;
+		}
+#else
+		counter_error = ENOSYS;
+#endif
+	}
+}
+
+void counters_begin( const char * name ){
+	if( !counting ){
+		return;
+	}
+	int phase_i = 0;
+	while( phase_i < num_counted_phases && strncmp( counted_phases[phase_i].name, name, MAX_PHASE_NAME - 1 ) != 0 ){
+		phase_i++;
+	}
+	if( phase_i == num_counted_phases && num_counted_phases < MAX_COUNTED_PHASES ){
+		memset( &counted_phases[phase_i], 0, sizeof(counted_phases[phase_i]) );
+		strncpy( counted_phases[phase_i].name, name, MAX_PHASE_NAME - 1 );
+		num_counted_phases++;
+	}
+	// Phases past the most that are kept, or nested too deep, are not counted.
+	if( counter_depth < MAX_COUNTER_DEPTH ){
+		open_counted_phases[counter_depth] = phase_i < num_counted_phases ? phase_i : -1;
+		// Read the counters last so finding the phase is not counted in it.
+		for( int counter=0; counter<NUM_COUNTERS; counter++ ){
+			if( counter_fds[counter] >= 0 ){
+				open_counter_values[counter_depth][counter] = read_counter( counter_fds[counter] );
+			}
+		}
+	}
+	counter_depth++;
+}
+
+void counters_end(){
+	if( !counting || counter_depth == 0 ){
+		return;
+	}
+	double values[NUM_COUNTERS];
+	for( int counter=0; counter<NUM_COUNTERS; counter++ ){
+		if( counter_fds[counter] >= 0 ){
+			values[counter] = read_counter( counter_fds[counter] );
+		}
+	}
+	counter_depth--;
+	if( counter_depth >= MAX_COUNTER_DEPTH || open_counted_phases[counter_depth] < 0 ){
+		return;
+	}
+	struct counted_phase * phase = &counted_phases[open_counted_phases[counter_depth]];
+	phase->calls++;
+	for( int counter=0; counter<NUM_COUNTERS; counter++ ){
+		if( counter_fds[counter] >= 0 ){
+			phase->totals[counter] += values[counter] - open_counter_values[counter_depth][counter];
+		}
+	}
+}
+
+// A metric of one rank's phase, or -1 if that rank could not count it.
+static double phase_metric( const struct counted_phase * phase, int available, int metric ){
+	if( metric < NUM_COUNTERS ){
+		return (available >> metric) & 1 ? phase->totals[metric] : -1.0;
+	}
+	// Ratios of pairs of counters, numerator then denominator.
+	static const int ratios[3][2] = { { 1, 0 }, { 3, 2 }, { 5, 4 } };
+	int numerator = ratios[metric - NUM_COUNTERS][0];
+	int denominator = ratios[metric - NUM_COUNTERS][1];
+	if( !((available >> numerator) & 1) || !((available >> denominator) & 1) || phase->totals[denominator] <= 0.0 ){
+		return -1.0;
+	}
+	return phase->totals[numerator] / phase->totals[denominator];
+}
+
+// Root's report on every phase, from each rank's phases and which of its
+// counters it could open.
+static void write_counters( FILE * file, int json, const struct counted_phase * phases, const int * num_phases, const int * displacements, const int * available, int n_procs ){
+	int any_available = 0;
+	for( int rank=0; rank<n_procs; rank++ ){
+		any_available |= available[rank];
+	}
+	if( json ){
+		fprintf(file, "{\n\"ranks\":%d,\n\"unavailable\":[", n_procs);
+		int first = 1;
+		for( int counter=0; counter<NUM_COUNTERS; counter++ ){
+			if( !((any_available >> counter) & 1) ){
+				fprintf(file, "%s\"%s\"", first ? "" : ",", counter_names[counter]);
+				first = 0;
+			}
+		}
+		fprintf(file, "],\n\"error\":\"%s\",\n\"phases\":[", counter_error != 0 ? strerror(counter_error) : "");
+	} else {
+		fprintf(file, "Counters per phase over %d ranks, as minimum / mean / maximum:\n", n_procs);
+		if( counter_error != 0 ){
+			fprintf(file, "Some counters are unavailable: %s.\n", strerror(counter_error));
+		}
+	}
+
+	// Phases are reported in the order they first appear, rank by rank.
+	int num_reported = 0;
+	for( int rank=0; rank<n_procs; rank++ ){
+		for( int phase_i=0; phase_i<num_phases[rank]; phase_i++ ){
+			const char * name = phases[displacements[rank] + phase_i].name;
+			int seen = 0;
+			for( int earlier=0; earlier<rank && !seen; earlier++ ){
+				for( int earlier_i=0; earlier_i<num_phases[earlier]; earlier_i++ ){
+					seen |= strcmp( phases[displacements[earlier] + earlier_i].name, name ) == 0;
+				}
+			}
+			if( seen ){
+				continue;
+			}
+
+			// Every rank's count of the phase, where it has one.
+			int num_ranks = 0;
+			double calls_min = 0.0, calls_sum = 0.0, calls_max = 0.0;
+			const struct counted_phase * rank_phases[n_procs];
+			int rank_available[n_procs];
+			for( int other=0; other<n_procs; other++ ){
+				for( int other_i=0; other_i<num_phases[other]; other_i++ ){
+					const struct counted_phase * phase = &phases[displacements[other] + other_i];
+					if( strcmp( phase->name, name ) != 0 ){
+						continue;
+					}
+					rank_phases[num_ranks] = phase;
+					rank_available[num_ranks] = available[other];
+					double calls = phase->calls;
+					calls_min = num_ranks == 0 || calls < calls_min ? calls : calls_min;
+					calls_max = num_ranks == 0 || calls > calls_max ? calls : calls_max;
+					calls_sum += calls;
+					num_ranks++;
+				}
+			}
+			if( json ){
+				fprintf(file, "%s\n{\"name\":\"%s\",\"ranks\":%d,\"calls\":{\"min\":%.0f,\"mean\":%.1f,\"max\":%.0f}", num_reported > 0 ? "," : "", name, num_ranks, calls_min, calls_sum / num_ranks, calls_max);
+			} else {
+				fprintf(file, "%s, on %d ranks, %.0f / %.1f / %.0f calls\n", name, num_ranks, calls_min, calls_sum / num_ranks, calls_max);
+			}
+			for( int metric=0; metric<NUM_METRICS; metric++ ){
+				int num_values = 0;
+				double min = 0.0, sum = 0.0, max = 0.0;
+				for( int rank_i=0; rank_i<num_ranks; rank_i++ ){
+					double value = phase_metric( rank_phases[rank_i], rank_available[rank_i], metric );
+					if( value < 0.0 ){
+						continue;
+					}
+					min = num_values == 0 || value < min ? value : min;
+					max = num_values == 0 || value > max ? value : max;
+					sum += value;
+					num_values++;
+				}
+				if( json ){
+					if( num_values > 0 ){
+						fprintf(file, ",\"%s\":{\"min\":%.6g,\"mean\":%.6g,\"max\":%.6g}", metric_names[metric], min, sum / num_values, max);
+					} else {
+						fprintf(file, ",\"%s\":null", metric_names[metric]);
+					}
+				} else if( num_values > 0 ){
+					fprintf(file, "  %-24s %12.6g / %12.6g / %12.6g\n", metric_names[metric], min, sum / num_values, max);
+				} else {
+					fprintf(file, "  %-24s unavailable\n", metric_names[metric]);
+				}
+			}
+			if( json ){
+				fprintf(file, "}");
+			}
+			num_reported++;
+		}
+	}
+	if( json ){
+		fprintf(file, "\n]\n}\n");
+	}
+}
+
+// Gather every rank's counts to root, which prints them, or writes them to path
+// as JSON if path is not NULL. Must be called by every rank of the communicator
+// given to counters_init. Returns 0 on success and -1 if root could not write
+// the file, on root only.
+int counters_finish( const char * path, int root ){
+	if( !counting ){
+		return 0;
+	}
+	counting = 0;
+	int my_rank, n_procs;
+	MPI_Comm_rank( counters_comm, &my_rank );
+	MPI_Comm_size( counters_comm, &n_procs );
+	int available = 0;
+	for( int counter=0; counter<NUM_COUNTERS; counter++ ){
+		if( counter_fds[counter] >= 0 ){
+			available |= 1 << counter;
+#ifdef __linux__
+			close( counter_fds[counter] );
+#endif
+			counter_fds[counter] = -1;
+		}
+	}
+
+	int * num_phases = NULL;
+	int * availables = NULL;
+	int * sizes = NULL;
+	int * displacements = NULL;
+	int * byte_displacements = NULL;
+	struct counted_phase * phases = NULL;
+	if( my_rank == root ){
+		num_phases = (int*)malloc(sizeof(int)*n_procs);
+		availables = (int*)malloc(sizeof(int)*n_procs);
+		sizes = (int*)malloc(sizeof(int)*n_procs);
+		displacements = (int*)malloc(sizeof(int)*n_procs);
+		byte_displacements = (int*)malloc(sizeof(int)*n_procs);
+	}
+	MPI_Gather( &num_counted_phases, 1, MPI_INT, num_phases, 1, MPI_INT, root, counters_comm );
+	MPI_Gather( &available, 1, MPI_INT, availables, 1, MPI_INT, root, counters_comm );
+	if( my_rank == root ){
+		int total_phases = 0;
+		for( int rank=0; rank<n_procs; rank++ ){
+			displacements[rank] = total_phases;
+			byte_displacements[rank] = total_phases * sizeof(struct counted_phase);
+			sizes[rank] = num_phases[rank] * sizeof(struct counted_phase);
+			total_phases += num_phases[rank];
+		}
+		phases = (struct counted_phase*)malloc(sizeof(struct counted_phase)*(total_phases + 1));
+	}
+	MPI_Gatherv( counted_phases, num_counted_phases * sizeof(struct counted_phase), MPI_BYTE, phases, sizes, byte_displacements, MPI_BYTE, root, counters_comm );
+
+	int status = 0;
+	if( my_rank == root ){
+		FILE * file = path != NULL ? fopen( path, "w" ) : stdout;
+		if( file == NULL ){
+			status = -1;
+		} else {
+			write_counters( file, path != NULL, phases, num_phases, displacements, availables, n_procs );
+			if( path != NULL && fclose( file ) != 0 ){
+				status = -1;
+			}
+		}
+		free(num_phases);
+		free(availables);
+		free(sizes);
+		free(displacements);
+		free(byte_displacements);
+		free(phases);
+	}
+	return status;
+}
@@ -0,0 +1,37 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <mpi.h>
+
+// Hardware performance counters for the MPI programs, read with Linux's
+// perf_event_open around named phases of the work. Each rank counts its own
+// cycles, instructions, cache and branch misses per phase, and at the end root
+// reports the minimum, mean and maximum over the ranks of each, either printed
+// or as JSON.
+//
+// Counting is chosen at run time. When it is off, or a counter can not be
+// opened, e.g. on a virtual machine without a PMU, in a container, or with a
+// high kernel.perf_event_paranoid, that counter is reported as unavailable and
+// the program runs as normal. Phases may nest, and must be ended in the opposite
+// order to which they were begun.
+
+#define NUM_COUNTERS 7
+// Longest phase name kept, and most distinct phases counted per rank.
+#define MAX_PHASE_NAME 32
+#define MAX_COUNTED_PHASES 16
+
+// What a rank counted over every call of one phase.
+struct counted_phase {
+	char name[MAX_PHASE_NAME];
+	long long calls;
+	double totals[NUM_COUNTERS];
+};
+
+extern const char * counter_names[NUM_COUNTERS];
+
+void counters_init( int enabled, MPI_Comm comm );
+void counters_begin( const char * name );
+void counters_end();
+int counters_finish( const char * path, int root );
+
+#endif
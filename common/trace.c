@@ -0,0 +1,150 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+#ifdef TRACE
+
+// Deepest nesting of open spans.
+#define MAX_TRACE_DEPTH 32
+// Longest line a span takes in the trace file.
+#define MAX_SPAN_LENGTH 256
+
+static int tracing = 0;
+static MPI_Comm trace_comm;
+// The time every rank counts from, taken just after a barrier so spans line up
+// between ranks.
+static double trace_start;
+static struct trace_span * spans = NULL;
+static int num_spans = 0;
+static int spans_capacity = 0;
+// Indices into spans of the currently open ones.
+static int open_spans[MAX_TRACE_DEPTH];
+static int depth = 0;
+
+// Must be called by every rank of comm, which trace_finish gathers over.
+void trace_init( int enabled, MPI_Comm comm ){
+	tracing = enabled;
+	if( !tracing ){
+		return;
+	}
+	trace_comm = comm;
+	spans_capacity = 1024;
+	spans = (struct trace_span*)malloc(sizeof(struct trace_span)*spans_capacity);
+	num_spans = 0;
+	depth = 0;
+	MPI_Barrier( comm );
+	trace_start = MPI_Wtime();
+}
+
+void trace_begin( const char * name ){
+	if( !tracing ){
+		return;
+	}
+	if( num_spans == spans_capacity ){
+		spans_capacity *= 2;
+		spans = (struct trace_span*)realloc(spans, sizeof(struct trace_span)*spans_capacity);
+	}
+	struct trace_span * span = &spans[num_spans];
+	span->name = name;
+	span->end = -1.0;
+	if( depth < MAX_TRACE_DEPTH ){
+		open_spans[depth] = num_spans;
+	}
+	depth++;
+	num_spans++;
+	// Read the clock last so growing the buffer is not part of the span.
+	span->start = MPI_Wtime() - trace_start;
+}
+
+void trace_end(){
+	double now = MPI_Wtime() - trace_start;
+	if( !tracing || depth == 0 ){
+		return;
+	}
+	depth--;
+	if( depth < MAX_TRACE_DEPTH ){
+		spans[open_spans[depth]].end = now;
+	}
+}
+
+// Write one span as a complete event, with times in microseconds. Returns the
+// number of characters written.
+static int format_span( const struct trace_span * span, int rank, char * buffer ){
+	return snprintf(
+		buffer,
+		MAX_SPAN_LENGTH,
+		",\n{\"name\":\"%.64s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+		span->name,
+		rank,
+		span->start * 1e6,
+		(span->end - span->start) * 1e6
+	);
+}
+
+// Gather every rank's spans to root, which writes them to path. Must be called
+// by every rank of the communicator given to trace_init. Returns 0 on success
+// and -1 if root could not write the file, on root only.
+int trace_finish( const char * path, int root ){
+	if( !tracing ){
+		return 0;
+	}
+	tracing = 0;
+	int my_rank, n_procs;
+	MPI_Comm_rank( trace_comm, &my_rank );
+	MPI_Comm_size( trace_comm, &n_procs );
+
+	// Spans still open, or lost past the deepest nesting, have no end.
+	char * text = (char*)malloc((long long)MAX_SPAN_LENGTH*(num_spans+1));
+	int length = snprintf( text, MAX_SPAN_LENGTH, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"rank %d\"}}", my_rank, my_rank );
+	for( int span_i=0; span_i<num_spans; span_i++ ){
+		if( spans[span_i].end >= 0.0 ){
+			length += format_span( &spans[span_i], my_rank, text + length );
+		}
+	}
+	free(spans);
+	spans = NULL;
+
+	int * lengths = NULL;
+	int * displacements = NULL;
+	char * gathered = NULL;
+	if( my_rank == root ){
+		lengths = (int*)malloc(sizeof(int)*n_procs);
+		displacements = (int*)malloc(sizeof(int)*n_procs);
+	}
+	MPI_Gather( &length, 1, MPI_INT, lengths, 1, MPI_INT, root, trace_comm );
+	long long total_length = 0;
+	if( my_rank == root ){
+		for( int rank=0; rank<n_procs; rank++ ){
+			displacements[rank] = total_length;
+			total_length += lengths[rank];
+		}
+		gathered = (char*)malloc(total_length);
+	}
+	MPI_Gatherv( text, length, MPI_CHAR, gathered, lengths, displacements, MPI_CHAR, root, trace_comm );
+	free(text);
+
+	int status = 0;
+	if( my_rank == root ){
+		FILE * file = fopen( path, "w" );
+		if( file == NULL ){
+			status = -1;
+		} else {
+			// Every event starts with a separator, so skip the first one.
+			fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+			fwrite( gathered + 2, sizeof(char), total_length - 2, file );
+			fprintf(file, "\n]}\n");
+			if( fclose( file ) != 0 ){
+				status = -1;
+			}
+		}
+		free(lengths);
+		free(displacements);
+		free(gathered);
+	}
+	return status;
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <mpi.h>
+
+// Timeline tracing for the MPI programs. Each rank records the spans it enters
+// into its own buffer, and at the end root gathers them into one file in the
+// Chrome trace event format, which chrome://tracing and ui.perfetto.dev open,
+// with a row per rank.
+//
+// Tracing is only compiled in when TRACE is defined, e.g. make TRACE=1. Without
+// it the macros below expand to nothing and the programs carry no trace code.
+// Spans must be closed in the opposite order to which they were opened.
+
+#ifdef TRACE
+
+// A span as recorded. The name must outlive the trace, so is a string literal.
+struct trace_span {
+	const char * name;
+	double start;
+	double end;
+};
+
+void trace_init( int enabled, MPI_Comm comm );
+void trace_begin( const char * name );
+void trace_end();
+int trace_finish( const char * path, int root );
+
+#define TRACE_INIT( enabled, comm ) trace_init( enabled, comm )
+#define TRACE_BEGIN( name ) trace_begin( name )
+#define TRACE_END() trace_end()
+#define TRACE_FINISH( path, root ) trace_finish( path, root )
+
+#else
+
+#define TRACE_INIT( enabled, comm )
+#define TRACE_BEGIN( name )
+#define TRACE_END()
+#define TRACE_FINISH( path, root ) 0
+
+#endif
+
+#endif
@@ -0,0 +1,217 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "animation.h"
+#include "csv_format.h"
+#include "double_double.h"
+#include "render.h"
+
+#define LINE_SIZE 512
+// How close, as a fraction of the pixel spacing, a pixel of the previous frame
+// must be to count as the same pixel. This only absorbs rounding error in the
+// coordinates, the pixels are otherwise exactly the same point.
+#define REUSE_TOLERANCE 1e-9
+
+// Frame files are named by printf-ing the frame number into a pattern, which
+// must therefore contain exactly one integer conversion such as %05d.
+int valid_frame_pattern( const char * pattern ){
+	int num_conversions = 0;
+	for( const char * c = pattern; *c != '\0'; c++ ){
+		if( *c != '%' ){
+			continue;
+		}
+		c++;
+		if( *c == '%' ){
+			continue;
+		}
+		while( *c == '0' || *c == '-' || *c == '+' || *c == ' ' || (*c >= '1' && *c <= '9') ){
+			c++;
+		}
+		if( *c != 'd' ){
+			return 0;
+		}
+		num_conversions++;
+	}
+	return num_conversions == 1;
+}
+
+// Read keyframes, one "center_x center_y scale" per line. Blank lines and lines
+// starting with # are skipped. Returns the number of keyframes, or -1 if the file
+// could not be read or a line is malformed.
+int read_keyframes( const char * path, struct keyframe ** keyframes ){
+	FILE * file = fopen( path, "r" );
+	if( file == NULL ){
+		return -1;
+	}
+	int num_keyframes = 0;
+	int capacity = 16;
+	*keyframes = (struct keyframe*)malloc(sizeof(struct keyframe)*capacity);
+	char line[LINE_SIZE];
+	char center_x[LINE_SIZE], center_y[LINE_SIZE];
+	double scale;
+	while( fgets( line, LINE_SIZE, file ) != NULL ){
+		char * start = line;
+		while( *start == ' ' || *start == '\t' ){
+			start++;
+		}
+		if( *start == '#' || *start == '\n' || *start == '\0' ){
+			continue;
+		}
+		if( num_keyframes == capacity ){
+			capacity *= 2;
+			*keyframes = (struct keyframe*)realloc(*keyframes, sizeof(struct keyframe)*capacity);
+		}
+		struct keyframe * keyframe = &(*keyframes)[num_keyframes];
+		if( sscanf( start, "%s %s %lf", center_x, center_y, &scale ) != 3
+				|| dd_parse( center_x, &keyframe->center_x ) != 0
+				|| dd_parse( center_y, &keyframe->center_y ) != 0
+				|| scale <= 0.0 ){
+			fclose( file );
+			free( *keyframes );
+			*keyframes = NULL;
+			return -1;
+		}
+		keyframe->scale = scale;
+		num_keyframes++;
+	}
+	fclose( file );
+	return num_keyframes;
+}
+
+// Spread the frames evenly over the keyframes. The center moves linearly and the
+// scale geometrically, so a zoom proceeds at a constant rate.
+void interpolate_keyframes( const struct keyframe * keyframes, int num_keyframes, int frame_i, int num_frames, struct keyframe * frame ){
+	if( num_keyframes == 1 || num_frames == 1 ){
+		*frame = keyframes[0];
+		return;
+	}
+	double t = (double)frame_i * (num_keyframes - 1) / (num_frames - 1);
+	int keyframe_i = (int)t;
+	if( keyframe_i >= num_keyframes - 1 ){
+		keyframe_i = num_keyframes - 2;
+	}
+	double u = t - keyframe_i;
+	const struct keyframe * from = &keyframes[keyframe_i];
+	const struct keyframe * to = &keyframes[keyframe_i+1];
+	if( u == 0.0 ){
+		*frame = *from;
+		return;
+	}
+	frame->center_x = dd_add( from->center_x, dd_mul_double( dd_sub( to->center_x, from->center_x ), u ) );
+	frame->center_y = dd_add( from->center_y, dd_mul_double( dd_sub( to->center_y, from->center_y ), u ) );
+	frame->scale = from->scale * pow( to->scale / from->scale, u );
+}
+
+int same_center( const struct keyframe * a, const struct keyframe * b ){
+	return a->center_x.hi == b->center_x.hi && a->center_x.lo == b->center_x.lo
+		&& a->center_y.hi == b->center_y.hi && a->center_y.lo == b->center_y.lo;
+}
+
+// Coordinates the kernel sees for a pixel. Perturbation and double-double work in
+// offsets from the center, and those are only comparable between frames with the
+// same center.
+static double pixel_x( const struct renderer * renderer, int x_i ){
+	if( offsets_from_center( renderer->precision ) ){
+		return viewport_delta_x( &renderer->viewport, x_i );
+	}
+	return viewport_x( &renderer->viewport, x_i );
+}
+
+static double pixel_y( const struct renderer * renderer, int y_i ){
+	if( offsets_from_center( renderer->precision ) ){
+		return viewport_delta_y( &renderer->viewport, y_i );
+	}
+	return viewport_y( &renderer->viewport, y_i );
+}
+
+static int map_axis( const struct renderer * previous, const struct renderer * current, int horizontal, int * map ){
+	int resolution = horizontal ? current->viewport.x_resolution : current->viewport.y_resolution;
+	int previous_resolution = horizontal ? previous->viewport.x_resolution : previous->viewport.y_resolution;
+	double step = horizontal ? current->viewport.x_step : current->viewport.y_step;
+	double previous_step = horizontal ? previous->viewport.x_step : previous->viewport.y_step;
+	double previous_first = horizontal ? pixel_x( previous, 0 ) : pixel_y( previous, 0 );
+	int num_mapped = 0;
+	for( int i=0; i<resolution; i++ ){
+		double coordinate = horizontal ? pixel_x( current, i ) : pixel_y( current, i );
+		long long j = llround( (coordinate - previous_first) / previous_step );
+		map[i] = -1;
+		if( j >= 0 && j < previous_resolution ){
+			double previous_coordinate = horizontal ? pixel_x( previous, j ) : pixel_y( previous, j );
+			if( fabs( previous_coordinate - coordinate ) <= REUSE_TOLERANCE * step ){
+				map[i] = j;
+				num_mapped++;
+			}
+		}
+	}
+	return num_mapped;
+}
+
+// Find the pixels of the current frame that were already computed for the
+// previous one. This happens where frames overlap and the scale changed by an
+// integer ratio, e.g. every other pixel when zooming in by a factor of 2.
+// Returns the number of reusable pixels.
+int map_previous_frame( const struct renderer * previous, const struct renderer * current, int * x_map, int * y_map ){
+	if( previous == NULL || previous->precision != current->precision || previous->limit != current->limit ){
+		return 0;
+	}
+	if( offsets_from_center( current->precision ) ){
+		const struct viewport * a = &previous->viewport;
+		const struct viewport * b = &current->viewport;
+		if( a->center_x.hi != b->center_x.hi || a->center_x.lo != b->center_x.lo
+				|| a->center_y.hi != b->center_y.hi || a->center_y.lo != b->center_y.lo ){
+			return 0;
+		}
+	}
+	return map_axis( previous, current, 1, x_map ) * map_axis( previous, current, 0, y_map );
+}
+
+// Render a frame, copying pixels shared with the previous frame rather than
+// computing them again. Returns the number of pixels copied.
+int render_frame( const struct renderer * renderer, const struct renderer * previous, const int * previous_iterations, int * iterations ){
+	const struct viewport * viewport = &renderer->viewport;
+	int * x_map = (int*)malloc(sizeof(int)*viewport->x_resolution);
+	int * y_map = (int*)malloc(sizeof(int)*viewport->y_resolution);
+	int num_reused = map_previous_frame( previous, renderer, x_map, y_map );
+
+	for( int y_i=0; y_i<viewport->y_resolution; y_i++ ){
+		int * row = iterations + (long long)y_i * viewport->x_resolution;
+		if( num_reused == 0 || y_map[y_i] < 0 ){
+			render_row( renderer, y_i, row );
+			continue;
+		}
+		const int * previous_row = previous_iterations + (long long)y_map[y_i] * previous->viewport.x_resolution;
+		for( int x_i=0; x_i<viewport->x_resolution; x_i++ ){
+			if( x_map[x_i] >= 0 ){
+				row[x_i] = previous_row[x_map[x_i]];
+			} else {
+				row[x_i] = render_pixel( renderer, x_i, y_i );
+			}
+		}
+	}
+
+	free(x_map);
+	free(y_map);
+	return num_reused;
+}
+
+// Returns 0 on success and -1 if the file could not be written.
+int write_frame( const char * path, const struct viewport * viewport, int limit, const int * iterations ){
+	FILE * file = fopen( path, "w+" );
+	if( file == NULL ){
+		return -1;
+	}
+	struct csv_formatter formatter;
+	init_csv_formatter( &formatter, viewport, limit );
+	char * row_buffer = (char*)malloc(sizeof(char)*csv_row_max_size( &formatter ));
+	fprintf(file, CSV_HEADER);
+	for( int y_i=0; y_i<viewport->y_resolution; y_i++ ){
+		csv_formatter_set_row( &formatter, viewport, y_i );
+		const int * row = iterations + (long long)y_i * viewport->x_resolution;
+		fwrite( row_buffer, sizeof(char), format_csv_row( &formatter, row, row_buffer ), file );
+	}
+	free(row_buffer);
+	free_csv_formatter( &formatter );
+	return fclose( file ) == 0 ? 0 : -1;
+}
@@ -0,0 +1,23 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "double_double.h"
+#include "render.h"
+
+#define DEFAULT_FRAME_PATTERN "mandelbrot_set_%05d.csv"
+
+struct keyframe {
+	struct double_double center_x;
+	struct double_double center_y;
+	double scale;
+};
+
+int valid_frame_pattern( const char * pattern );
+int read_keyframes( const char * path, struct keyframe ** keyframes );
+void interpolate_keyframes( const struct keyframe * keyframes, int num_keyframes, int frame_i, int num_frames, struct keyframe * frame );
+int same_center( const struct keyframe * a, const struct keyframe * b );
+int map_previous_frame( const struct renderer * previous, const struct renderer * current, int * x_map, int * y_map );
+int render_frame( const struct renderer * renderer, const struct renderer * previous, const int * previous_iterations, int * iterations );
+int write_frame( const char * path, const struct viewport * viewport, int limit, const int * iterations );
+
+#endif
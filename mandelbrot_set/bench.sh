@@ -0,0 +1,148 @@
+#!/bin/sh
+# Sweep par_mandelbrot_set over rank counts, resolutions, limits and -h ratios
+# and summarise how well it scales. Each list can be overridden from the
+# environment, e.g. RANKS="1 2 4 8" ./bench.sh
+#
+# Writes to $BENCH_DIR:
+#   runs.csv     one line per run, with the min, mean and max over the ranks of
+#                the wall time and of each phase, as written by -t
+#   summary.csv  speedup and efficiency against the run with the fewest ranks of
+#                the same problem, and load imbalance (max / mean) of each phase
+#   summary.json the same as summary.csv
+#
+# Strong scaling runs keep the problem fixed as ranks are added. Weak scaling
+# runs grow the number of rows with the number of ranks, so their efficiency is
+# the time of the smallest run over the time of each run.
+
+RANKS=${RANKS:-"1 2 4"}
+RESOLUTIONS=${RESOLUTIONS:-"500 1000"}
+LIMITS=${LIMITS:-"200 1000"}
+RATIOS=${RATIOS:-"0.0 0.5"}
+# Rows per rank for the weak scaling runs, which use the first limit and ratio.
+WEAK_ROWS=${WEAK_ROWS:-250}
+REPEATS=${REPEATS:-3}
+BENCH_DIR=${BENCH_DIR:-bench}
+MPIRUN=${MPIRUN:-mpirun}
+
+mkdir -p "$BENCH_DIR"
+RUNS="$BENCH_DIR/runs.csv"
+rm -f "$RUNS" "$BENCH_DIR/strong.csv" "$BENCH_DIR/weak.csv"
+OUTPUT="$BENCH_DIR/mandelbrot_set.csv"
+
+for resolution in $RESOLUTIONS; do
+	for limit in $LIMITS; do
+		for ratio in $RATIOS; do
+			for ranks in $RANKS; do
+				repeat=0
+				while [ $repeat -lt "$REPEATS" ]; do
+					$MPIRUN -np "$ranks" ./par_mandelbrot_set "$limit" "$resolution" "$resolution" -h "$ratio" -o "$OUTPUT" -t "$BENCH_DIR/strong.csv" || exit 1
+					repeat=$((repeat + 1))
+				done
+			done
+		done
+	done
+done
+
+set -- $LIMITS
+weak_limit=$1
+set -- $RATIOS
+weak_ratio=$1
+set -- $RESOLUTIONS
+weak_resolution=$1
+for ranks in $RANKS; do
+	repeat=0
+	while [ $repeat -lt "$REPEATS" ]; do
+		$MPIRUN -np "$ranks" ./par_mandelbrot_set "$weak_limit" "$weak_resolution" $((WEAK_ROWS * ranks)) -h "$weak_ratio" -o "$OUTPUT" -t "$BENCH_DIR/weak.csv" || exit 1
+		repeat=$((repeat + 1))
+	done
+done
+rm -f "$OUTPUT"
+
+# Tag each run with its kind and keep one header.
+awk -F, -v OFS=, '
+	FNR == 1 { if( NR == 1 ){ print "scaling", $0 } next }
+	{ print (FILENAME ~ /weak.csv$/ ? "weak" : "strong"), $0 }
+' "$BENCH_DIR/strong.csv" "$BENCH_DIR/weak.csv" > "$RUNS"
+rm -f "$BENCH_DIR/strong.csv" "$BENCH_DIR/weak.csv"
+
+# Average the repeats of each configuration, taking the time of a run to be its
+# slowest rank, then compare every configuration with the one using the fewest
+# ranks for the same problem. Weak scaling runs are one problem per limit and
+# ratio, whatever their number of rows.
+awk -F, -v OFS=, -v csv="$BENCH_DIR/summary.csv" -v json="$BENCH_DIR/summary.json" '
+	NR == 1 {
+		for( i=1; i<=NF; i++ ){
+			column[$i] = i
+		}
+		num_phases = 0
+		for( i=1; i<=NF; i++ ){
+			if( $i ~ /_max$/ && $i != "wall_max" ){
+				phase = substr( $i, 1, length($i) - 4 )
+				phases[++num_phases] = phase
+			}
+		}
+		next
+	}
+	{
+		problem = $column["scaling"] SUBSEP $column["limit"] SUBSEP $column["x_resolution"] SUBSEP $column["high_density_ratio"]
+		if( $column["scaling"] == "strong" ){
+			problem = problem SUBSEP $column["y_resolution"]
+		}
+		key = problem SUBSEP $column["ranks"]
+		if( !(key in count) ){
+			order[++num_keys] = key
+			key_problem[key] = problem
+			key_line[key] = $column["scaling"] OFS $column["ranks"] OFS $column["limit"] OFS $column["x_resolution"] OFS $column["y_resolution"] OFS $column["high_density_ratio"]
+			key_json[key] = sprintf( "\"scaling\": \"%s\", \"ranks\": %d, \"limit\": %d, \"x_resolution\": %d, \"y_resolution\": %d, \"high_density_ratio\": %s", $column["scaling"], $column["ranks"], $column["limit"], $column["x_resolution"], $column["y_resolution"], $column["high_density_ratio"] )
+		}
+		count[key]++
+		wall[key] += $column["wall_max"]
+		for( p=1; p<=num_phases; p++ ){
+			phase_max[key, p] += $column[phases[p] "_max"]
+			phase_mean[key, p] += $column[phases[p] "_mean"]
+		}
+		if( !(problem in base_ranks) || $column["ranks"] < base_ranks[problem] ){
+			base_ranks[problem] = $column["ranks"]
+			base_key[problem] = key
+		}
+	}
+	END {
+		header = "scaling,ranks,limit,x_resolution,y_resolution,high_density_ratio,wall,speedup,efficiency"
+		for( p=1; p<=num_phases; p++ ){
+			header = header "," phases[p] "," phases[p] "_imbalance"
+		}
+		print header > csv
+		print "[" > json
+		for( k=1; k<=num_keys; k++ ){
+			key = order[k]
+			problem = key_problem[key]
+			time = wall[key] / count[key]
+			base = base_key[problem]
+			base_time = wall[base] / count[base]
+			split( key_line[key], fields, OFS )
+			ranks = fields[2]
+			ratio = ranks / base_ranks[problem]
+			speedup = time > 0 ? base_time / time : 0
+			if( fields[1] == "weak" ){
+				efficiency = speedup
+				speedup *= ratio
+			} else {
+				efficiency = speedup / ratio
+			}
+			line = sprintf( "%s,%f,%f,%f", key_line[key], time, speedup, efficiency )
+			entry = sprintf( "  { %s, \"wall\": %f, \"speedup\": %f, \"efficiency\": %f, \"phases\": {", key_json[key], time, speedup, efficiency )
+			for( p=1; p<=num_phases; p++ ){
+				slowest = phase_max[key, p] / count[key]
+				average = phase_mean[key, p] / count[key]
+				imbalance = average > 0 ? slowest / average : 1
+				line = line sprintf( ",%f,%f", slowest, imbalance )
+				entry = entry sprintf( "%s \"%s\": { \"seconds\": %f, \"imbalance\": %f }", p > 1 ? "," : "", phases[p], slowest, imbalance )
+			}
+			print line > csv
+			print entry " } }" (k < num_keys ? "," : "") > json
+		}
+		print "]" > json
+	}
+' "$RUNS"
+
+cat "$BENCH_DIR/summary.csv"
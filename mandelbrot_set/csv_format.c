@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "csv_format.h"
+#include "render.h"
+
+// Longest "%d" of an int, "-2147483648".
+#define MAX_INT_LENGTH 11
+
+static const char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+void init_csv_formatter( struct csv_formatter * formatter, const struct viewport * viewport, int limit ){
+	double * x = (double*)malloc(sizeof(double)*viewport->x_resolution);
+	for( int x_i=0; x_i<viewport->x_resolution; x_i++ ){
+		x[x_i] = viewport_x( viewport, x_i );
+	}
+	// y changes linearly, so the widest y is at one of the ends.
+	double y[2] = { viewport_y( viewport, 0 ), viewport_y( viewport, viewport->y_resolution - 1 ) };
+	init_csv_formatter_from_coordinates( formatter, x, viewport->x_resolution, y, 2, limit );
+	free(x);
+}
+
+// Set up a formatter for columns at the given x coordinates. The y coordinates
+// are only used to bound the size of rows, and counts are between 0 and limit.
+void init_csv_formatter_from_coordinates( struct csv_formatter * formatter, const double * x, int x_resolution, const double * y, int num_y, int limit ){
+	// Every row repeats the same x values, so format them once with the same
+	// %f as the per pixel printf did, to keep the output byte for byte the same.
+	char column[MAX_DOUBLE_LENGTH];
+	formatter->x_resolution = x_resolution;
+	formatter->x_offsets = (int*)malloc(sizeof(int)*x_resolution);
+	formatter->x_lengths = (int*)malloc(sizeof(int)*x_resolution);
+	int capacity = 16 * x_resolution + 1;
+	formatter->x_strings = (char*)malloc(sizeof(char)*capacity);
+	formatter->max_x_length = 0;
+	int offset = 0;
+	for( int x_i=0; x_i<x_resolution; x_i++ ){
+		int length = snprintf( column, sizeof(column), "%f,", x[x_i] );
+		if( offset + length >= capacity ){
+			capacity = 2 * capacity + length;
+			formatter->x_strings = (char*)realloc(formatter->x_strings, sizeof(char)*capacity);
+		}
+		memcpy( formatter->x_strings + offset, column, length );
+		formatter->x_offsets[x_i] = offset;
+		formatter->x_lengths[x_i] = length;
+		if( length > formatter->max_x_length ){
+			formatter->max_x_length = length;
+		}
+		offset += length;
+	}
+	formatter->y_length = 0;
+
+	formatter->max_y_length = 0;
+	for( int y_i=0; y_i<num_y; y_i++ ){
+		int length = snprintf( column, sizeof(column), "%f,", y[y_i] );
+		if( length > formatter->max_y_length ){
+			formatter->max_y_length = length;
+		}
+	}
+	formatter->max_z_length = format_int( limit, column );
+}
+
+void csv_formatter_set_row( struct csv_formatter * formatter, const struct viewport * viewport, int y_i ){
+	csv_formatter_set_y( formatter, viewport_y( viewport, y_i ) );
+}
+
+void csv_formatter_set_y( struct csv_formatter * formatter, double y ){
+	formatter->y_length = snprintf( formatter->y_string, sizeof(formatter->y_string), "%f,", y );
+}
+
+// An upper bound on the size of any row, for sizing buffers.
+long long csv_row_max_size( const struct csv_formatter * formatter ){
+	long long max_line = formatter->max_x_length + formatter->max_y_length + formatter->max_z_length + 1;
+	return max_line * formatter->x_resolution;
+}
+
+// Write value in decimal, two digits at a time, and return the number of
+// characters written. No terminator is written.
+int format_int( int value, char * buffer ){
+	char digits[MAX_INT_LENGTH];
+	int length = 0;
+	unsigned int magnitude = value < 0 ? -(unsigned int)value : (unsigned int)value;
+	char * end = digits + MAX_INT_LENGTH;
+	char * start = end;
+	while( magnitude >= 100 ){
+		unsigned int pair = (magnitude % 100) * 2;
+		magnitude /= 100;
+		start -= 2;
+		start[0] = digit_pairs[pair];
+		start[1] = digit_pairs[pair + 1];
+	}
+	if( magnitude >= 10 ){
+		start -= 2;
+		start[0] = digit_pairs[magnitude * 2];
+		start[1] = digit_pairs[magnitude * 2 + 1];
+	} else {
+		start--;
+		start[0] = '0' + magnitude;
+	}
+	if( value < 0 ){
+		buffer[length] = '-';
+		length++;
+	}
+	memcpy( buffer + length, start, end - start );
+	return length + (end - start);
+}
+
+// Format one row of pixels, whose y was given to csv_formatter_set_row, into
+// buffer and return the number of characters written. No terminator is written.
+long long format_csv_row( const struct csv_formatter * formatter, const int * iterations, char * buffer ){
+	char * moving_pointer = buffer;
+	for( int x_i=0; x_i<formatter->x_resolution; x_i++ ){
+		memcpy( moving_pointer, formatter->x_strings + formatter->x_offsets[x_i], formatter->x_lengths[x_i] );
+		moving_pointer += formatter->x_lengths[x_i];
+		memcpy( moving_pointer, formatter->y_string, formatter->y_length );
+		moving_pointer += formatter->y_length;
+		moving_pointer += format_int( iterations[x_i], moving_pointer );
+		*moving_pointer = '\n';
+		moving_pointer++;
+	}
+	return moving_pointer - buffer;
+}
+
+void free_csv_formatter( struct csv_formatter * formatter ){
+	free(formatter->x_strings);
+	free(formatter->x_offsets);
+	free(formatter->x_lengths);
+}
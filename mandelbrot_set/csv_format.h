@@ -0,0 +1,37 @@
+#ifndef CSV_FORMAT_H
+#define CSV_FORMAT_H
+
+#include "render.h"
+
+// Longest "%f," of a double, e.g. -DBL_MAX.
+#define MAX_DOUBLE_LENGTH 320
+
+// Formats rows of "x,y,z\n" lines exactly as printf("%f,%f,%d\n") would, without
+// calling printf per pixel.
+struct csv_formatter {
+	int x_resolution;
+	// The "x," prefix of every column, formatted once.
+	char * x_strings;
+	int * x_offsets;
+	int * x_lengths;
+	int max_x_length;
+	// The "y," part of the current row.
+	char y_string[MAX_DOUBLE_LENGTH];
+	int y_length;
+	// Longest y and iteration count, for bounding the size of rows.
+	int max_y_length;
+	int max_z_length;
+};
+
+#define CSV_HEADER "x,y,z\n"
+
+void init_csv_formatter( struct csv_formatter * formatter, const struct viewport * viewport, int limit );
+void init_csv_formatter_from_coordinates( struct csv_formatter * formatter, const double * x, int x_resolution, const double * y, int num_y, int limit );
+void csv_formatter_set_row( struct csv_formatter * formatter, const struct viewport * viewport, int y_i );
+void csv_formatter_set_y( struct csv_formatter * formatter, double y );
+long long csv_row_max_size( const struct csv_formatter * formatter );
+int format_int( int value, char * buffer );
+long long format_csv_row( const struct csv_formatter * formatter, const int * iterations, char * buffer );
+void free_csv_formatter( struct csv_formatter * formatter );
+
+#endif
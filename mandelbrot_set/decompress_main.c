@@ -0,0 +1,155 @@
+#include <argp.h>
+#include <complex.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "double_double.c"
+#include "mandelbrot_set.c"
+#include "perturbation.c"
+#include "render.c"
+#include "csv_format.c"
+#include "rle_format.c"
+#include "raw_format.c"
+
+static char doc[] = "decompress_mandelbrot_set -- Turns the run length encoded output of par_mandelbrot_set -f rle, or its raw output from -f raw, back into csv.";
+
+static char args_doc[] = "File";
+
+static struct argp_option options[] = {
+	{ "verbose", 'v', 0, 0, "Provide verbose output." },
+	{ "output", 'o', "FILE", 0, "Output to specified file instead of standard mandelbrot_set.csv." },
+	{ "rows", 'r', "FIRST:LAST", 0, "Only decode rows FIRST to LAST, counting from 0 and including both. Only the chunks holding those rows are read." },
+	{ 0 }
+};
+
+struct arguments {
+	char *args[1];
+	int verbose;
+	char *output_file;
+	int first_row;
+	int last_row;
+};
+
+static error_t parse_opt( int key, char *arg, struct argp_state *state) {
+	struct arguments *arguments = state->input;
+	switch(key) {
+		case 'v':
+			arguments->verbose = 1;
+			break;
+		case 'o':
+			arguments->output_file = arg;
+			break;
+		case 'r':
+			if( sscanf( arg, "%d:%d", &arguments->first_row, &arguments->last_row ) != 2
+					|| arguments->first_row < 0 || arguments->last_row < arguments->first_row ){
+				argp_error( state, "invalid rows '%s'", arg );
+			}
+			break;
+		case ARGP_KEY_ARG:
+			if( state->arg_num >= 1 ){
+				argp_usage( state );
+			}
+			arguments->args[state->arg_num] = arg;
+			break;
+		case ARGP_KEY_END:
+			if( state->arg_num < 1 ){
+				argp_usage( state );
+			}
+			break;
+		default:
+			return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+
+static struct argp argp = { options, parse_opt, args_doc, doc };
+
+int main(int argc, char **argv){
+
+	struct arguments arguments;
+	arguments.verbose = 0;
+	arguments.output_file = "mandelbrot_set.csv";
+	arguments.first_row = 0;
+	arguments.last_row = -1;
+
+	argp_parse (&argp, argc, argv, 0, 0, &arguments);
+
+	// Raw files are read a batch of rows at a time, as if in chunks.
+	struct rle_file rle;
+	struct raw_file raw;
+	int is_raw = 0;
+	int x_resolution, y_resolution, limit, rows_per_chunk;
+	const double * x;
+	const double * y;
+	if( open_rle_file( arguments.args[0], &rle ) == 0 ){
+		x_resolution = rle.header.x_resolution;
+		y_resolution = rle.header.y_resolution;
+		limit = rle.header.limit;
+		rows_per_chunk = rle.header.rows_per_chunk;
+		x = rle.x;
+		y = rle.y;
+		if( arguments.verbose ){
+			printf("%d by %d pixels with limit %d, in %d chunks of %d rows.\n", x_resolution, y_resolution, limit, rle.header.num_chunks, rows_per_chunk);
+		}
+	} else if( open_raw_file( arguments.args[0], &raw ) == 0 ){
+		is_raw = 1;
+		x_resolution = raw.header.x_resolution;
+		y_resolution = raw.header.y_resolution;
+		limit = raw.header.limit;
+		rows_per_chunk = RAW_ROWS_PER_BATCH;
+		x = raw.x;
+		y = raw.y;
+		if( arguments.verbose ){
+			printf("%d by %d pixels with limit %d, unencoded.\n", x_resolution, y_resolution, limit);
+		}
+	} else {
+		fprintf(stderr, "%s is not a run length encoded or raw Mandelbrot set.\n", arguments.args[0]);
+		return 1;
+	}
+	int first_row = arguments.first_row;
+	int last_row = arguments.last_row;
+	if( last_row < 0 || last_row >= y_resolution ){
+		last_row = y_resolution - 1;
+	}
+
+	struct csv_formatter formatter;
+	init_csv_formatter_from_coordinates( &formatter, x, x_resolution, y, y_resolution, limit );
+	char * row_buffer = (char*)malloc(sizeof(char)*csv_row_max_size( &formatter ));
+	// Decode a chunk's worth of rows at a time.
+	int * iterations = (int*)malloc(sizeof(int)*rows_per_chunk*x_resolution);
+
+	FILE * file;
+	file = fopen(arguments.output_file, "w+");
+	fprintf(file, CSV_HEADER);
+	int status = 0;
+	for( int y_i=first_row; y_i<=last_row; ){
+		// Stop at the end of the chunk y_i is in.
+		int max_y_i = (y_i / rows_per_chunk + 1) * rows_per_chunk;
+		if( max_y_i > last_row + 1 ){
+			max_y_i = last_row + 1;
+		}
+		int start_y_i = y_i;
+		int error = is_raw ? read_raw_rows( &raw, start_y_i, max_y_i, iterations ) : read_rle_rows( &rle, start_y_i, max_y_i, iterations );
+		if( error != 0 ){
+			fprintf(stderr, "Could not decode rows %d to %d.\n", y_i, max_y_i - 1);
+			status = 1;
+			break;
+		}
+		for( ; y_i<max_y_i; y_i++ ){
+			csv_formatter_set_y( &formatter, y[y_i] );
+			const int * row = iterations + (long long)(y_i - start_y_i) * x_resolution;
+			fwrite( row_buffer, sizeof(char), format_csv_row( &formatter, row, row_buffer ), file );
+		}
+	}
+	fclose(file);
+
+	free(iterations);
+	free(row_buffer);
+	free_csv_formatter( &formatter );
+	if( is_raw ){
+		close_raw_file( &raw );
+	} else {
+		close_rle_file( &rle );
+	}
+	return status;
+}
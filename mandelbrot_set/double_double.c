@@ -0,0 +1,162 @@
+#include <ctype.h>
+#include <math.h>
+
+#include "double_double.h"
+
+// Error free transformations. Each returns the rounded result in hi and the
+// rounding error in lo.
+static struct double_double quick_two_sum( double a, double b ){
+	// Only valid when |a| >= |b|.
+	struct double_double result;
+	result.hi = a + b;
+	result.lo = b - (result.hi - a);
+	return result;
+}
+
+static struct double_double two_sum( double a, double b ){
+	struct double_double result;
+	result.hi = a + b;
+	double b_virtual = result.hi - a;
+	result.lo = (a - (result.hi - b_virtual)) + (b - b_virtual);
+	return result;
+}
+
+static struct double_double two_prod( double a, double b ){
+	struct double_double result;
+	result.hi = a * b;
+	result.lo = fma( a, b, -result.hi );
+	return result;
+}
+
+struct double_double dd_from_double( double a ){
+	struct double_double result = { a, 0.0 };
+	return result;
+}
+
+double dd_to_double( struct double_double a ){
+	return a.hi + a.lo;
+}
+
+struct double_double dd_add( struct double_double a, struct double_double b ){
+	struct double_double sum = two_sum( a.hi, b.hi );
+	struct double_double error = two_sum( a.lo, b.lo );
+	sum.lo += error.hi;
+	sum = quick_two_sum( sum.hi, sum.lo );
+	sum.lo += error.lo;
+	return quick_two_sum( sum.hi, sum.lo );
+}
+
+struct double_double dd_sub( struct double_double a, struct double_double b ){
+	b.hi = -b.hi;
+	b.lo = -b.lo;
+	return dd_add( a, b );
+}
+
+struct double_double dd_mul( struct double_double a, struct double_double b ){
+	struct double_double product = two_prod( a.hi, b.hi );
+	product.lo += a.hi * b.lo + a.lo * b.hi;
+	return quick_two_sum( product.hi, product.lo );
+}
+
+struct double_double dd_mul_double( struct double_double a, double b ){
+	struct double_double product = two_prod( a.hi, b );
+	product.lo += a.lo * b;
+	return quick_two_sum( product.hi, product.lo );
+}
+
+struct double_double dd_div( struct double_double a, struct double_double b ){
+	// Long division, one double worth of quotient at a time.
+	double q1 = a.hi / b.hi;
+	struct double_double remainder = dd_sub( a, dd_mul_double( b, q1 ) );
+	double q2 = remainder.hi / b.hi;
+	remainder = dd_sub( remainder, dd_mul_double( b, q2 ) );
+	double q3 = remainder.hi / b.hi;
+	struct double_double quotient = quick_two_sum( q1, q2 );
+	return dd_add( quotient, dd_from_double( q3 ) );
+}
+
+// Parse a decimal string such as "-0.7436438870371587047521915" or "1.5e-20".
+// strtod would round the value to a double, losing the digits a deep zoom
+// depends on. Returns 0 on success and -1 if the string is not a number.
+int dd_parse( const char * string, struct double_double * result ){
+	const char * c = string;
+	while( isspace( (unsigned char)*c ) ){
+		c++;
+	}
+
+	int negative = 0;
+	if( *c == '-' || *c == '+' ){
+		negative = *c == '-';
+		c++;
+	}
+
+	struct double_double mantissa = dd_from_double( 0.0 );
+	int num_digits = 0;
+	int exponent = 0;
+	int seen_point = 0;
+	while( isdigit( (unsigned char)*c ) || ( *c == '.' && !seen_point ) ){
+		if( *c == '.' ){
+			seen_point = 1;
+		} else {
+			mantissa = dd_add( dd_mul_double( mantissa, 10.0 ), dd_from_double( *c - '0' ) );
+			num_digits++;
+			if( seen_point ){
+				exponent--;
+			}
+		}
+		c++;
+	}
+	if( num_digits == 0 ){
+		return -1;
+	}
+
+	if( *c == 'e' || *c == 'E' ){
+		c++;
+		int exponent_negative = 0;
+		if( *c == '-' || *c == '+' ){
+			exponent_negative = *c == '-';
+			c++;
+		}
+		if( !isdigit( (unsigned char)*c ) ){
+			return -1;
+		}
+		int written_exponent = 0;
+		while( isdigit( (unsigned char)*c ) ){
+			written_exponent = written_exponent * 10 + (*c - '0');
+			c++;
+		}
+		exponent += exponent_negative ? -written_exponent : written_exponent;
+	}
+
+	while( isspace( (unsigned char)*c ) ){
+		c++;
+	}
+	if( *c != '\0' ){
+		return -1;
+	}
+
+	// Build 10^|exponent| by repeated squaring and apply it with a single
+	// multiplication or division so the rounding error does not accumulate.
+	struct double_double power = dd_from_double( 1.0 );
+	struct double_double base = dd_from_double( 10.0 );
+	int remaining = exponent < 0 ? -exponent : exponent;
+	while( remaining > 0 ){
+		if( remaining & 1 ){
+			power = dd_mul( power, base );
+		}
+		base = dd_mul( base, base );
+		remaining >>= 1;
+	}
+	if( exponent < 0 ){
+		mantissa = dd_div( mantissa, power );
+	} else {
+		mantissa = dd_mul( mantissa, power );
+	}
+
+	if( negative ){
+		mantissa.hi = -mantissa.hi;
+		mantissa.lo = -mantissa.lo;
+	}
+	*result = mantissa;
+	return 0;
+}
@@ -0,0 +1,15 @@
+#ifndef DOUBLE_DOUBLE_H
+#define DOUBLE_DOUBLE_H
+
+#include "double_double_type.h"
+
+struct double_double dd_from_double( double a );
+double dd_to_double( struct double_double a );
+struct double_double dd_add( struct double_double a, struct double_double b );
+struct double_double dd_sub( struct double_double a, struct double_double b );
+struct double_double dd_mul( struct double_double a, struct double_double b );
+struct double_double dd_mul_double( struct double_double a, double b );
+struct double_double dd_div( struct double_double a, struct double_double b );
+int dd_parse( const char * string, struct double_double * result );
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef DOUBLE_DOUBLE_TYPE_H
+#define DOUBLE_DOUBLE_TYPE_H
+
+// A value stored as the unevaluated sum of two doubles, giving roughly 32
+// significant decimal digits. Kept apart from double_double.h so libmandelbrot.h
+// can use it without declaring the arithmetic.
+struct double_double {
+	double hi;
+	double lo;
+};
+
+#endif
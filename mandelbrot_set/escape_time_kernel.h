@@ -0,0 +1,35 @@
+// The escape time loop, written once for every precision. mandelbrot_set.c
+// includes this file once per precision, after defining:
+//   KERNEL_NAME            name of the generated function
+//   KERNEL_REAL            type of a real number
+//   KERNEL_ZERO            zero of that type
+//   KERNEL_ADD, KERNEL_SUB, KERNEL_MUL
+//                          arithmetic on two KERNEL_REALs
+//   KERNEL_ESCAPED(re, im) whether |re + im i| > 2
+// There is deliberately no include guard.
+
+int KERNEL_NAME( KERNEL_REAL c_re, KERNEL_REAL c_im, int limit ){
+	// Since c = z_1, |c| > 2 are not in the set.
+	if( KERNEL_ESCAPED( c_re, c_im ) ){
+		return 0;
+	}
+
+	// The absolute value of z must remain <= 2 for c to be in the set.
+	KERNEL_REAL z_re = KERNEL_ZERO;
+	KERNEL_REAL z_im = KERNEL_ZERO;
+
+	// Perform naive escape time algorithm.
+	int i=0;
+	while( i<limit ){
+		// z = z * z + c, in the same order of operations as a double complex
+		// multiply, so the double kernel gives the same counts as one.
+		KERNEL_REAL next_re = KERNEL_ADD( KERNEL_SUB( KERNEL_MUL( z_re, z_re ), KERNEL_MUL( z_im, z_im ) ), c_re );
+		z_im = KERNEL_ADD( KERNEL_ADD( KERNEL_MUL( z_re, z_im ), KERNEL_MUL( z_im, z_re ) ), c_im );
+		z_re = next_re;
+		if( KERNEL_ESCAPED( z_re, z_im ) ){
+			return i;
+		}
+		i++;
+	}
+	return i;
+}
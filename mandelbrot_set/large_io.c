@@ -0,0 +1,131 @@
+#include <limits.h>
+#include <mpi.h>
+#include <stdlib.h>
+
+#include "large_io.h"
+
+// MPI takes counts and block lengths as ints, so anything longer is spread over
+// several blocks of at most this many elements.
+#ifndef MAX_IO_COUNT
+#define MAX_IO_COUNT INT_MAX
+#endif
+
+void init_extents( struct extents * extents ){
+	extents->num_extents = 0;
+	extents->capacity = 16;
+	extents->lengths = (int*)malloc(sizeof(int)*extents->capacity);
+	extents->offsets = (MPI_Aint*)malloc(sizeof(MPI_Aint)*extents->capacity);
+}
+
+// Add length bytes at offset. An extent that starts where the last one ends is
+// merged into it, up to MAX_IO_COUNT bytes each. Extents of a file view must
+// be added in file order.
+void add_extent( struct extents * extents, long long offset, long long length ){
+	if( extents->num_extents > 0 ){
+		int last = extents->num_extents - 1;
+		if( extents->offsets[last] + extents->lengths[last] == offset ){
+			long long room = MAX_IO_COUNT - extents->lengths[last];
+			long long grow = length < room ? length : room;
+			extents->lengths[last] += grow;
+			offset += grow;
+			length -= grow;
+		}
+	}
+	while( length > 0 ){
+		if( extents->num_extents == extents->capacity ){
+			extents->capacity *= 2;
+			extents->lengths = (int*)realloc(extents->lengths, sizeof(int)*extents->capacity);
+			extents->offsets = (MPI_Aint*)realloc(extents->offsets, sizeof(MPI_Aint)*extents->capacity);
+		}
+		int piece = length < MAX_IO_COUNT ? length : MAX_IO_COUNT;
+		extents->offsets[extents->num_extents] = offset;
+		extents->lengths[extents->num_extents] = piece;
+		extents->num_extents++;
+		offset += piece;
+		length -= piece;
+	}
+}
+
+void commit_extents_type( const struct extents * extents, MPI_Datatype * type ){
+	MPI_Type_create_hindexed( extents->num_extents, extents->lengths, extents->offsets, MPI_BYTE, type );
+	MPI_Type_commit( type );
+}
+
+void free_extents( struct extents * extents ){
+	free(extents->lengths);
+	free(extents->offsets);
+}
+
+// The int count and type to pass MPI for count elements of type. Counts MPI can
+// take are passed as they are, larger ones as one element of a type made of as
+// many blocks of MAX_IO_COUNT elements as fit and then the rest, which the
+// caller frees with free_large_type.
+static int large_type( long long count, MPI_Datatype type, MPI_Datatype * large ){
+	if( count <= MAX_IO_COUNT ){
+		*large = type;
+		return count;
+	}
+	MPI_Aint lower_bound, extent;
+	MPI_Type_get_extent( type, &lower_bound, &extent );
+	MPI_Datatype block;
+	MPI_Type_contiguous( MAX_IO_COUNT, type, &block );
+	int lengths[2] = { count / MAX_IO_COUNT, count % MAX_IO_COUNT };
+	MPI_Aint displacements[2] = { 0, (MPI_Aint)lengths[0] * MAX_IO_COUNT * extent };
+	MPI_Datatype types[2] = { block, type };
+	MPI_Type_create_struct( 2, lengths, displacements, types, large );
+	MPI_Type_commit( large );
+	MPI_Type_free( &block );
+	return 1;
+}
+
+static void free_large_type( MPI_Datatype type, MPI_Datatype * large ){
+	if( *large != type ){
+		MPI_Type_free( large );
+	}
+}
+
+// As MPI_File_write_all, for any count.
+int write_all_large( MPI_File file, const void * buffer, long long count, MPI_Datatype type ){
+	MPI_Datatype large;
+	int large_count = large_type( count, type, &large );
+	int error = MPI_File_write_all( file, buffer, large_count, large, MPI_STATUS_IGNORE );
+	free_large_type( type, &large );
+	return error;
+}
+
+// As MPI_File_write_at_all, for any count.
+int write_at_all_large( MPI_File file, MPI_Offset offset, const void * buffer, long long count, MPI_Datatype type ){
+	MPI_Datatype large;
+	int large_count = large_type( count, type, &large );
+	int error = MPI_File_write_at_all( file, offset, buffer, large_count, large, MPI_STATUS_IGNORE );
+	free_large_type( type, &large );
+	return error;
+}
+
+// As MPI_File_read_at_all, for any count.
+int read_at_all_large( MPI_File file, MPI_Offset offset, void * buffer, long long count, MPI_Datatype type ){
+	MPI_Datatype large;
+	int large_count = large_type( count, type, &large );
+	int error = MPI_File_read_at_all( file, offset, buffer, large_count, large, MPI_STATUS_IGNORE );
+	free_large_type( type, &large );
+	return error;
+}
+
+// As MPI_File_write_at, for any count, in pieces of at most MAX_IO_COUNT
+// elements. Stops at the first piece that fails.
+int write_at_large( MPI_File file, MPI_Offset offset, const void * buffer, long long count, MPI_Datatype type ){
+	MPI_Aint lower_bound, extent;
+	MPI_Type_get_extent( type, &lower_bound, &extent );
+	const char * bytes = (const char*)buffer;
+	do {
+		int piece = count < MAX_IO_COUNT ? count : MAX_IO_COUNT;
+		int error = MPI_File_write_at( file, offset, bytes, piece, type, MPI_STATUS_IGNORE );
+		if( error != MPI_SUCCESS ){
+			return error;
+		}
+		offset += (MPI_Offset)piece * extent;
+		bytes += (long long)piece * extent;
+		count -= piece;
+	} while( count > 0 );
+	return MPI_SUCCESS;
+}
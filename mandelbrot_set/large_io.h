@@ -0,0 +1,23 @@
+#ifndef LARGE_IO_H
+#define LARGE_IO_H
+
+#include <mpi.h>
+
+// Byte extents, of a file or of memory, in order, for an hindexed type.
+struct extents {
+	int num_extents;
+	int capacity;
+	int * lengths;
+	MPI_Aint * offsets;
+};
+
+void init_extents( struct extents * extents );
+void add_extent( struct extents * extents, long long offset, long long length );
+void commit_extents_type( const struct extents * extents, MPI_Datatype * type );
+void free_extents( struct extents * extents );
+int write_all_large( MPI_File file, const void * buffer, long long count, MPI_Datatype type );
+int write_at_all_large( MPI_File file, MPI_Offset offset, const void * buffer, long long count, MPI_Datatype type );
+int read_at_all_large( MPI_File file, MPI_Offset offset, void * buffer, long long count, MPI_Datatype type );
+int write_at_large( MPI_File file, MPI_Offset offset, const void * buffer, long long count, MPI_Datatype type );
+
+#endif
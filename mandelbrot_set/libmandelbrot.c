@@ -0,0 +1,141 @@
+#include <complex.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "double_double.c"
+#include "mandelbrot_set.c"
+#include "perturbation.c"
+#include "render.c"
+
+#include "libmandelbrot.h"
+
+// Fill in a region centered on the text center_x + center_y i, parsed to full
+// double-double precision, iterated in double as in_mandelbrot_set is. Returns
+// 0 on success and -1 if a coordinate or size is invalid.
+int mandelbrot_region_init( struct mandelbrot_region * region, const char * center_x, const char * center_y, double scale, int x_resolution, int y_resolution, int limit ){
+	if( dd_parse( center_x, &region->center_x ) != 0 || dd_parse( center_y, &region->center_y ) != 0 ){
+		return -1;
+	}
+	region->scale = scale;
+	region->x_resolution = x_resolution;
+	region->y_resolution = y_resolution;
+	region->limit = limit;
+	region->precision = PRECISION_DOUBLE;
+	return scale > 0.0 && x_resolution > 0 && y_resolution > 0 && limit > 0 ? 0 : -1;
+}
+
+static int valid_region( const struct mandelbrot_region * region ){
+	return region->scale > 0.0 && region->x_resolution > 0 && region->y_resolution > 0 && region->limit > 0
+		&& (region->precision == PRECISION_AUTO || region->precision == PRECISION_DOUBLE
+			|| region->precision == PRECISION_PERTURBATION || region->precision == PRECISION_DOUBLE_DOUBLE);
+}
+
+static int valid_rows( const struct mandelbrot_region * region, int first_row, int num_rows ){
+	return valid_region( region ) && first_row >= 0 && num_rows >= 0 && first_row <= region->y_resolution - num_rows;
+}
+
+static void init_region_renderer( const struct mandelbrot_region * region, struct renderer * renderer ){
+	struct viewport viewport;
+	init_viewport( &viewport, region->center_x, region->center_y, region->scale, region->x_resolution, region->y_resolution );
+	init_renderer( renderer, &viewport, region->limit, region->precision, 1 );
+}
+
+// Render rows first_row up to first_row + num_rows of the region into
+// iterations, which must hold num_rows * x_resolution counts. Returns 0 on
+// success and -1 if the rows are not in the region.
+int mandelbrot_render( const struct mandelbrot_region * region, int first_row, int num_rows, int * iterations ){
+	if( !valid_rows( region, first_row, num_rows ) ){
+		return -1;
+	}
+	struct renderer renderer;
+	init_region_renderer( region, &renderer );
+	for( int row_i=0; row_i<num_rows; row_i++ ){
+		render_row( &renderer, first_row + row_i, iterations + (long long)row_i * region->x_resolution );
+	}
+	free_renderer( &renderer );
+	return 0;
+}
+
+// As mandelbrot_render, for every stride-th row from first_row, num_rows of
+// them, packed together in iterations. Returns -1 if stride is not positive or
+// any of the rows are not in the region.
+int mandelbrot_render_strided( const struct mandelbrot_region * region, int first_row, int num_rows, int stride, int * iterations ){
+	if( !valid_region( region ) || stride <= 0 || first_row < 0 || num_rows < 0
+			|| (num_rows > 0 && first_row + (long long)(num_rows - 1) * stride >= region->y_resolution) ){
+		return -1;
+	}
+	struct renderer renderer;
+	init_region_renderer( region, &renderer );
+	for( int row_i=0; row_i<num_rows; row_i++ ){
+		render_row( &renderer, first_row + row_i * stride, iterations + (long long)row_i * region->x_resolution );
+	}
+	free_renderer( &renderer );
+	return 0;
+}
+
+// Shared by the threads of one mandelbrot_render_threaded call.
+struct render_job {
+	const struct renderer * renderer;
+	int first_row;
+	int num_rows;
+	int * iterations;
+	// Threads take rows one at a time, so none sits idle while another is stuck
+	// with the rows inside the set.
+	pthread_mutex_t lock;
+	int next_row;
+};
+
+static void * render_job_rows( void * argument ){
+	struct render_job * job = (struct render_job*)argument;
+	int x_resolution = job->renderer->viewport.x_resolution;
+	while( 1 ){
+		pthread_mutex_lock( &job->lock );
+		int row_i = job->next_row;
+		job->next_row++;
+		pthread_mutex_unlock( &job->lock );
+		if( row_i >= job->num_rows ){
+			return NULL;
+		}
+		render_row( job->renderer, job->first_row + row_i, job->iterations + (long long)row_i * x_resolution );
+	}
+}
+
+// As mandelbrot_render, sharing the rows between num_threads threads, or one per
+// online processor if num_threads is not positive. Returns -1 without rendering
+// anything if no thread could be started.
+int mandelbrot_render_threaded( const struct mandelbrot_region * region, int first_row, int num_rows, int * iterations, int num_threads ){
+	if( !valid_rows( region, first_row, num_rows ) ){
+		return -1;
+	}
+	if( num_threads <= 0 ){
+		num_threads = sysconf( _SC_NPROCESSORS_ONLN );
+		if( num_threads <= 0 ){
+			num_threads = 1;
+		}
+	}
+	struct renderer renderer;
+	init_region_renderer( region, &renderer );
+	struct render_job job;
+	job.renderer = &renderer;
+	job.first_row = first_row;
+	job.num_rows = num_rows;
+	job.iterations = iterations;
+	job.next_row = 0;
+	pthread_mutex_init( &job.lock, NULL );
+
+	// Carry on with however many threads could be started.
+	pthread_t * threads = (pthread_t*)malloc(sizeof(pthread_t)*num_threads);
+	int num_started = 0;
+	while( num_started < num_threads && pthread_create( &threads[num_started], NULL, render_job_rows, &job ) == 0 ){
+		num_started++;
+	}
+	for( int thread_i=0; thread_i<num_started; thread_i++ ){
+		pthread_join( threads[thread_i], NULL );
+	}
+
+	free(threads);
+	pthread_mutex_destroy( &job.lock );
+	free_renderer( &renderer );
+	return num_started > 0 ? 0 : -1;
+}
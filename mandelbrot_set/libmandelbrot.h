@@ -0,0 +1,43 @@
+#ifndef LIBMANDELBROT_H
+#define LIBMANDELBROT_H
+
+#include "double_double_type.h"
+#include "precision.h"
+
+// Renders the Mandelbrot set straight into an array of iteration counts, for
+// programs that would otherwise run par_mandelbrot_set and parse its csv. Build
+// with make, then link libmandelbrot.a or libmandelbrot.so, or the _mpi
+// versions of them for mandelbrot_render_mpi.
+//
+// Iteration counts are laid out a row at a time, x_resolution to a row, rows in
+// order of increasing imaginary part, the same order as the csv output. Each
+// count is what par_mandelbrot_set would write for that pixel.
+//
+// The libraries are built with -fvisibility=hidden, and the renderer they are
+// built from is kept out of their symbols and out of this header, so only the
+// functions marked MANDELBROT_EXPORT can be linked against. libmandelbrot_mpi
+// only holds mandelbrot_render_mpi, so is linked along with libmandelbrot.
+
+#define MANDELBROT_EXPORT __attribute__((visibility("default")))
+
+// What to render, as par_mandelbrot_set takes it on the command line.
+struct mandelbrot_region {
+	struct double_double center_x;
+	struct double_double center_y;
+	// Width and height of the square region.
+	double scale;
+	int x_resolution;
+	int y_resolution;
+	int limit;
+	// One of the PRECISION_ constants of precision.h, PRECISION_DOUBLE unless
+	// set otherwise, which gives the counts in_mandelbrot_set does.
+	// PRECISION_AUTO switches to perturbation for zooms too deep for doubles.
+	int precision;
+};
+
+MANDELBROT_EXPORT int mandelbrot_region_init( struct mandelbrot_region * region, const char * center_x, const char * center_y, double scale, int x_resolution, int y_resolution, int limit );
+MANDELBROT_EXPORT int mandelbrot_render( const struct mandelbrot_region * region, int first_row, int num_rows, int * iterations );
+MANDELBROT_EXPORT int mandelbrot_render_strided( const struct mandelbrot_region * region, int first_row, int num_rows, int stride, int * iterations );
+MANDELBROT_EXPORT int mandelbrot_render_threaded( const struct mandelbrot_region * region, int first_row, int num_rows, int * iterations, int num_threads );
+
+#endif
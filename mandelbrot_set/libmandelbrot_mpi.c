@@ -0,0 +1,63 @@
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmandelbrot_mpi.h"
+
+// As mandelbrot_render, sharing the rows between the ranks of comm, which must
+// all call this with the same arguments. Only root's iterations are filled in,
+// the other ranks may pass NULL. Rows are dealt out round robin, so the costly
+// rows inside the set are spread over every rank. Each rank computes its own
+// reference orbit if perturbation is used. Returns 0 on success and -1, on every
+// rank, if the rows are not in the region.
+int mandelbrot_render_mpi( const struct mandelbrot_region * region, int first_row, int num_rows, int * iterations, int root, MPI_Comm comm ){
+	// Rendering no rows checks the region without rendering anything.
+	if( first_row < 0 || num_rows < 0 || first_row > region->y_resolution - num_rows
+			|| mandelbrot_render_strided( region, first_row, 0, 1, NULL ) != 0 ){
+		return -1;
+	}
+	int my_rank, n_procs;
+	MPI_Comm_rank( comm, &my_rank );
+	MPI_Comm_size( comm, &n_procs );
+	int x_resolution = region->x_resolution;
+
+	int my_num_rows = my_rank < num_rows ? (num_rows - my_rank + n_procs - 1) / n_procs : 0;
+	int * my_iterations = (int*)malloc(sizeof(int)*((long long)my_num_rows*x_resolution + 1));
+	mandelbrot_render_strided( region, first_row + my_rank, my_num_rows, n_procs, my_iterations );
+
+	// Gather every rank's rows together, then deal them back into order.
+	int * counts = NULL;
+	int * displacements = NULL;
+	int * gathered = NULL;
+	if( my_rank == root ){
+		counts = (int*)malloc(sizeof(int)*n_procs);
+		displacements = (int*)malloc(sizeof(int)*n_procs);
+		int displacement = 0;
+		for( int rank=0; rank<n_procs; rank++ ){
+			int rank_num_rows = rank < num_rows ? (num_rows - rank + n_procs - 1) / n_procs : 0;
+			counts[rank] = rank_num_rows * x_resolution;
+			displacements[rank] = displacement;
+			displacement += counts[rank];
+		}
+		gathered = (int*)malloc(sizeof(int)*((long long)num_rows*x_resolution + 1));
+	}
+	MPI_Gatherv( my_iterations, my_num_rows * x_resolution, MPI_INT, gathered, counts, displacements, MPI_INT, root, comm );
+	free(my_iterations);
+
+	if( my_rank == root ){
+		for( int rank=0; rank<n_procs; rank++ ){
+			for( int rank_row_i=0; rank_row_i*x_resolution<counts[rank]; rank_row_i++ ){
+				long long row_i = rank + (long long)rank_row_i * n_procs;
+				memcpy(
+					iterations + row_i * x_resolution,
+					gathered + displacements[rank] + (long long)rank_row_i * x_resolution,
+					sizeof(int) * x_resolution
+				);
+			}
+		}
+		free(counts);
+		free(displacements);
+		free(gathered);
+	}
+	return 0;
+}
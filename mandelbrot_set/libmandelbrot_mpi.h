@@ -0,0 +1,10 @@
+#ifndef LIBMANDELBROT_MPI_H
+#define LIBMANDELBROT_MPI_H
+
+#include <mpi.h>
+
+#include "libmandelbrot.h"
+
+MANDELBROT_EXPORT int mandelbrot_render_mpi( const struct mandelbrot_region * region, int first_row, int num_rows, int * iterations, int root, MPI_Comm comm );
+
+#endif
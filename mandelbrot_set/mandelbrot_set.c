@@ -1,24 +1,69 @@
 #include <complex.h>
+#include <math.h>
 
+#include "double_double.h"
 #include "mandelbrot_set.h"
 
-int in_mandelbrot_set( double complex c, int limit ){
-	// The absolute value of z must remain <= 2 for c to be in the set.
-	double complex z = 0.0 + 0.0 * I;
+#define KERNEL_ADD(a, b) ((a) + (b))
+#define KERNEL_SUB(a, b) ((a) - (b))
+#define KERNEL_MUL(a, b) ((a) * (b))
 
-	// Since c = z_1, cabs(c) > 2 are not in the set.
-	if( cabs(c) > 2.0 ){
-		return 0;
-	}
+#define KERNEL_NAME escape_time_double
+#define KERNEL_REAL double
+#define KERNEL_ZERO 0.0
+// cabs, as the original double complex kernel used.
+#define KERNEL_ESCAPED(re, im) (hypot( re, im ) > 2.0)
+#include "escape_time_kernel.h"
+#undef KERNEL_NAME
+#undef KERNEL_REAL
+#undef KERNEL_ZERO
+#undef KERNEL_ESCAPED
+
+#undef KERNEL_ADD
+#undef KERNEL_SUB
+#undef KERNEL_MUL
+
+#define KERNEL_NAME escape_time_double_double
+#define KERNEL_REAL struct double_double
+#define KERNEL_ZERO dd_from_double( 0.0 )
+#define KERNEL_ADD(a, b) dd_add( a, b )
+#define KERNEL_SUB(a, b) dd_sub( a, b )
+#define KERNEL_MUL(a, b) dd_mul( a, b )
+// Whether z escaped does not need more than double precision to decide.
+#define KERNEL_ESCAPED(re, im) (hypot( (re).hi, (im).hi ) > 2.0)
+#include "escape_time_kernel.h"
+#undef KERNEL_NAME
+#undef KERNEL_REAL
+#undef KERNEL_ZERO
+#undef KERNEL_ADD
+#undef KERNEL_SUB
+#undef KERNEL_MUL
+#undef KERNEL_ESCAPED
+
+int in_mandelbrot_set( double complex c, int limit ){
+	return escape_time_double( creal(c), cimag(c), limit );
+}
 
-	// Perform naive escape time algorithm.
-	int i=0;
+// Carry on iterating c from z, which stayed within the circle for the first
+// start iterations, up to limit. Returns what escape_time_double( c_re, c_im,
+// limit ) would, and leaves z where the iteration stopped, so a count of limit
+// can later be carried on to a higher limit. Starting from z = 0 at 0 gives the
+// escape time from scratch.
+int continue_escape_time_double( double c_re, double c_im, double * z_re, double * z_im, int start, int limit ){
+	double re = *z_re;
+	double im = *z_im;
+	int i=start;
 	while( i<limit ){
-		z = z * z + c;
-		if( cabs(z) > 2.0 ){
-			return i;
+		// In the same order of operations as escape_time_double.
+		double next_re = ((re * re) - (im * im)) + c_re;
+		im = ((re * im) + (im * re)) + c_im;
+		re = next_re;
+		if( hypot( re, im ) > 2.0 ){
+			break;
 		}
 		i++;
 	}
+	*z_re = re;
+	*z_im = im;
 	return i;
 }
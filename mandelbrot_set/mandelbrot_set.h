@@ -1 +1,15 @@
+#ifndef MANDELBROT_SET_H
+#define MANDELBROT_SET_H
+
+#include <complex.h>
+
+#include "double_double.h"
+
+// Escape time of c, iterating in each precision. All return the number of
+// iterations before z left the circle of radius 2, or limit if it never did.
+int escape_time_double( double c_re, double c_im, int limit );
+int escape_time_double_double( struct double_double c_re, struct double_double c_im, int limit );
 int in_mandelbrot_set( double complex c, int limit );
+int continue_escape_time_double( double c_re, double c_im, double * z_re, double * z_im, int start, int limit );
+
+#endif
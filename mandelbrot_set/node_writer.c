@@ -0,0 +1,163 @@
+#include <mpi.h>
+#include <stdlib.h>
+
+#include "../common/trace.h"
+#include "large_io.h"
+#include "node_writer.h"
+
+// A piece of some rank of the group, as the group's writer sees it.
+struct group_piece {
+	long long offset;
+	long long size;
+	int rank;
+	// Where the piece starts in its rank's part of the window.
+	long long position;
+};
+
+static int compare_group_pieces( const void * a, const void * b ){
+	const struct group_piece * piece_a = (const struct group_piece*)a;
+	const struct group_piece * piece_b = (const struct group_piece*)b;
+	return (piece_a->offset > piece_b->offset) - (piece_a->offset < piece_b->offset);
+}
+
+// Give each of this rank's num_pieces pieces of output, of at most capacities
+// bytes each, a buffer in memory the rank shares with its group's writer, one
+// writer per node. A positive group_size splits the ranks of a node further,
+// with one writer per group_size of them. The rank formats its pieces straight
+// into the buffers, so write_through_node has nothing to copy. Must be called
+// by every rank of comm.
+void open_node_writer( struct node_writer * writer, const long long * capacities, char ** buffers, int num_pieces, int group_size, MPI_Comm comm ){
+	int my_rank;
+	MPI_Comm_rank( comm, &my_rank );
+	writer->comm = comm;
+	MPI_Comm_split_type( comm, MPI_COMM_TYPE_SHARED, my_rank, MPI_INFO_NULL, &writer->group_comm );
+	if( group_size > 0 ){
+		MPI_Comm node_comm = writer->group_comm;
+		int node_rank;
+		MPI_Comm_rank( node_comm, &node_rank );
+		MPI_Comm_split( node_comm, node_rank / group_size, node_rank, &writer->group_comm );
+		MPI_Comm_free( &node_comm );
+	}
+
+	writer->num_pieces = num_pieces;
+	writer->positions = (long long*)malloc(sizeof(long long)*(num_pieces + 1));
+	long long size = 0;
+	for( int piece_i=0; piece_i<num_pieces; piece_i++ ){
+		writer->positions[piece_i] = size;
+		size += capacities[piece_i];
+	}
+	char * base;
+	MPI_Win_allocate_shared( size, 1, MPI_INFO_NULL, writer->group_comm, &base, &writer->window );
+	for( int piece_i=0; piece_i<num_pieces; piece_i++ ){
+		buffers[piece_i] = base + writer->positions[piece_i];
+	}
+	TRACE_BEGIN( "MPI_Win_fence" );
+	MPI_Win_fence( 0, writer->window );
+	TRACE_END();
+}
+
+// Write every rank's pieces, formatted into the buffers open_node_writer gave
+// them, to the file at path. Each writer issues one write of its whole group's
+// pieces, straight from the shared memory, with the pieces that meet in the
+// file, typically those of neighbouring ranks, as one extent. Pieces must not
+// overlap. Must be called by every rank of the writer's comm. Returns 0 on
+// success and -1 if a writer could not open the file.
+int write_through_node( struct node_writer * writer, const char * path, const struct file_piece * pieces ){
+	int my_rank, group_rank, group_n_procs;
+	MPI_Comm_rank( writer->comm, &my_rank );
+	MPI_Comm_rank( writer->group_comm, &group_rank );
+	MPI_Comm_size( writer->group_comm, &group_n_procs );
+
+	// Tell the writer where every piece is and where it goes.
+	struct group_piece * my_pieces = (struct group_piece*)malloc(sizeof(struct group_piece)*(writer->num_pieces + 1));
+	for( int piece_i=0; piece_i<writer->num_pieces; piece_i++ ){
+		my_pieces[piece_i].offset = pieces[piece_i].offset;
+		my_pieces[piece_i].size = pieces[piece_i].size;
+		my_pieces[piece_i].rank = group_rank;
+		my_pieces[piece_i].position = writer->positions[piece_i];
+	}
+	TRACE_BEGIN( "MPI_Allgatherv" );
+	int * counts = (int*)malloc(sizeof(int)*group_n_procs);
+	int * displacements = (int*)malloc(sizeof(int)*group_n_procs);
+	int piece_bytes = writer->num_pieces * sizeof(struct group_piece);
+	MPI_Allgather( &piece_bytes, 1, MPI_INT, counts, 1, MPI_INT, writer->group_comm );
+	int total_piece_bytes = 0;
+	for( int rank=0; rank<group_n_procs; rank++ ){
+		displacements[rank] = total_piece_bytes;
+		total_piece_bytes += counts[rank];
+	}
+	int num_group_pieces = total_piece_bytes / sizeof(struct group_piece);
+	struct group_piece * group_pieces = (struct group_piece*)malloc(total_piece_bytes + sizeof(struct group_piece));
+	MPI_Allgatherv( my_pieces, piece_bytes, MPI_BYTE, group_pieces, counts, displacements, MPI_BYTE, writer->group_comm );
+	TRACE_END();
+	qsort( group_pieces, num_group_pieces, sizeof(struct group_piece), compare_group_pieces );
+
+	// Make what the group formatted visible to the writer.
+	TRACE_BEGIN( "MPI_Win_fence" );
+	MPI_Win_fence( 0, writer->window );
+	TRACE_END();
+
+	MPI_Comm writers_comm;
+	MPI_Comm_split( writer->comm, group_rank == 0 ? 0 : MPI_UNDEFINED, my_rank, &writers_comm );
+	int status = 0;
+	if( group_rank == 0 ){
+		// The pieces are described in place, in file order, by their addresses in
+		// the writer's view of the window, so no count or length passes INT_MAX.
+		char ** bases = (char**)malloc(sizeof(char*)*group_n_procs);
+		for( int rank=0; rank<group_n_procs; rank++ ){
+			MPI_Aint size;
+			int displacement_unit;
+			MPI_Win_shared_query( writer->window, rank, &size, &displacement_unit, &bases[rank] );
+		}
+		struct extents file_extents, memory_extents;
+		init_extents( &file_extents );
+		init_extents( &memory_extents );
+		for( int piece_i=0; piece_i<num_group_pieces; piece_i++ ){
+			const struct group_piece * piece = &group_pieces[piece_i];
+			MPI_Aint address;
+			MPI_Get_address( bases[piece->rank] + piece->position, &address );
+			add_extent( &file_extents, piece->offset, piece->size );
+			add_extent( &memory_extents, address, piece->size );
+		}
+		MPI_Datatype file_type, memory_type;
+		commit_extents_type( &file_extents, &file_type );
+		commit_extents_type( &memory_extents, &memory_type );
+
+		MPI_File file;
+		TRACE_BEGIN( "MPI_File_open" );
+		int error = MPI_File_open( writers_comm, path, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &file );
+		TRACE_END();
+		if( error == MPI_SUCCESS ){
+			TRACE_BEGIN( "MPI_File_write_all" );
+			MPI_File_set_view( file, 0, MPI_BYTE, file_type, "native", MPI_INFO_NULL );
+			MPI_File_write_all( file, MPI_BOTTOM, 1, memory_type, MPI_STATUS_IGNORE );
+			TRACE_END();
+			TRACE_BEGIN( "MPI_File_close" );
+			MPI_File_close( &file );
+			TRACE_END();
+		} else {
+			status = -1;
+		}
+
+		MPI_Type_free( &file_type );
+		MPI_Type_free( &memory_type );
+		free_extents( &file_extents );
+		free_extents( &memory_extents );
+		free(bases);
+		MPI_Comm_free( &writers_comm );
+	}
+
+	free(counts);
+	free(displacements);
+	free(my_pieces);
+	free(group_pieces);
+	return status;
+}
+
+// Free the shared memory, and with it the buffers open_node_writer gave out.
+// Must be called by every rank of the writer's comm.
+void close_node_writer( struct node_writer * writer ){
+	MPI_Win_free( &writer->window );
+	MPI_Comm_free( &writer->group_comm );
+	free(writer->positions);
+}
@@ -0,0 +1,27 @@
+#ifndef NODE_WRITER_H
+#define NODE_WRITER_H
+
+#include <mpi.h>
+
+// One piece of a rank's output and where it goes in the file.
+struct file_piece {
+	long long offset;
+	long long size;
+};
+
+// A rank's part of the memory its group shares with the group's writer, which
+// the rank formats its pieces straight into.
+struct node_writer {
+	MPI_Comm comm;
+	MPI_Comm group_comm;
+	MPI_Win window;
+	int num_pieces;
+	// Where each of this rank's pieces starts in its part of the window.
+	long long * positions;
+};
+
+void open_node_writer( struct node_writer * writer, const long long * capacities, char ** buffers, int num_pieces, int group_size, MPI_Comm comm );
+int write_through_node( struct node_writer * writer, const char * path, const struct file_piece * pieces );
+void close_node_writer( struct node_writer * writer );
+
+#endif
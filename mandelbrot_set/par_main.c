@@ -1,25 +1,68 @@
 #include <argp.h>
 #include <complex.h>
+#include <limits.h>
 #include <mpi.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
-#include "mandelbrot_set.c"
+// Brings in the renderer, double_double.c to render.c, along with the library.
+#include "libmandelbrot.c"
+#include "libmandelbrot_mpi.c"
+#include "tile_cache.c"
+#include "animation.c"
+#include "csv_format.c"
+#include "rle_format.c"
+#include "raw_format.c"
+#include "../common/trace.c"
+#include "../common/perf_counters.c"
+#include "phase_timings.c"
+#include "tile_client.c"
+#include "tile_server.c"
+#include "large_io.c"
+#include "node_writer.c"
+#include "pyramid_format.c"
+#include "pyramid_writer.c"
 
 #define ROOT_RANK 0
 #define BUFSIZE 128
-#define SIZE_PER_LINE 32
+
+#define FORMAT_CSV 0
+#define FORMAT_RLE 1
+#define FORMAT_RAW 2
 
 static char doc[] = "mandelbrot_set -- A simple C script, parallelized with MPI, that calculates the Mandelbrot set. Should be executed with mpirun.";
 
-static char args_doc[] = "Limit X resolution Y resolution";
+static char args_doc[] = "Limit X resolution Y resolution\n--serve SOCKET";
 
 static struct argp_option options[] = {
 	{ "verbose", 'v', 0, 0, "Provide verbose output." },
 	{ "output", 'o', "FILE", 0, "Output to specified file instead of standard mandelbrot_set.csv." },
 	{ "high density ratio", 'h', "RATIO", 0, "Override ratio of y_resolution in high density chunk."  },
+	{ "center-x", 'x', "REAL", 0, "Real component of the center of the viewport. Defaults to -0.5." },
+	{ "center-y", 'y', "IMAGINARY", 0, "Imaginary component of the center of the viewport. Defaults to 0.0." },
+	{ "scale", 's', "SCALE", 0, "Width and height of the viewport. Defaults to 3.0." },
+	{ "precision", 'p', "PRECISION", 0, "One of auto, double, double-double or perturbation. auto uses double, and perturbation for deep zooms." },
+	{ "cache", 'c', "DIRECTORY", 0, "Reuse tiles of earlier renders stored in DIRECTORY, and store new ones there. Moves the viewport by up to half a pixel so overlapping renders share tiles." },
+	{ "cache-size", 'C', "MEGABYTES", 0, "Evict the least recently used tiles once the cache exceeds this size. Defaults to 1024." },
+	{ "keyframes", 'k', "FILE", 0, "Render an animation passing through the keyframes in FILE, one \"center_x center_y scale\" per line. -o is then a pattern such as mandelbrot_set_%05d.csv that is given the frame number." },
+	{ "frames", 'n', "FRAMES", 0, "Number of frames to render with --keyframes. Defaults to the number of keyframes." },
+	{ "format", 'f', "FORMAT", 0, "One of csv, rle or raw. rle writes a run length encoded file, with an index of its chunks of rows, that decompress_mandelbrot_set turns back into csv. raw writes every count at a fixed width, see raw_format.h, along with a journal of the rows written that --resume continues from. decompress_mandelbrot_set also turns raw files into csv. Defaults to csv." },
+	{ "resume", 'R', 0, 0, "Continue a raw render that did not finish, computing only the rows its journal does not list as written, shared between however many ranks are now running. Starts afresh if there is no journal." },
+	{ "trace", 'T', "FILE", 0, "Write a timeline of when each rank computed, formatted, communicated and wrote to FILE in the Chrome trace format, for chrome://tracing or ui.perfetto.dev. Needs a build with make TRACE=1." },
+	{ "counters", 'H', "FILE", OPTION_ARG_OPTIONAL, "Count cycles, instructions, cache and branch misses of each rank while it computes, formats, exchanges and writes, and print the minimum, mean and maximum over the ranks, or write them to FILE as JSON, e.g. --counters=counters.json. Counters the machine does not offer, as in many virtual machines and containers, are reported as unavailable." },
+	{ "timings", 't', "FILE", 0, "Append how long the ranks spent computing, formatting, exchanging offsets and writing, as the minimum, mean and maximum over the ranks, to the csv FILE. Not for --keyframes." },
+	{ "symmetry", 'r', 0, 0, "Copy rows whose reflection in the real axis is also in the viewport instead of computing them again, sharing only the remaining rows between the ranks. Only for csv output without --memory." },
+	{ "serve", 'S', "SOCKET", 0, "Instead of rendering once, keep running and render the tiles requested over the Unix domain socket SOCKET, sharing each tile between the ranks. See tile_protocol.h. The limit and resolutions are then not needed." },
+	{ "aggregate", 'a', "RANKS", OPTION_ARG_OPTIONAL, "Have the ranks on each node format their output straight into memory shared with one of them, which writes it all, so the file system sees one large write per node instead of one per rank. With RANKS, every RANKS ranks of a node share a writer. Only for csv output without --memory or --symmetry." },
+	{ "orbits", 'z', 0, 0, "With -f raw and -p double, also save where z was left for each pixel that reached the limit, so --refine can raise the limit later." },
+	{ "refine", 'e', 0, 0, "Raise the limit of a raw render saved with --orbits to the limit given, carrying on only the pixels that reached its old limit instead of rendering it again. The other arguments must match those of the render." },
+	{ "pyramid", 'P', "FILE", 0, "Also write levels of detail of the render to FILE, each half the resolution of the one before, cut into tiles a viewer can read one at a time. See pyramid_format.h. Only for csv output without --memory or --symmetry." },
+	{ "pooling", 'l', "POOLING", 0, "How a pixel of the --pyramid pools the 2 by 2 pixels beneath it, max or mean of their counts. Defaults to max." },
+	{ "memory", 'm', "SIZE", 0, "Stream the output to the file in bands of rows, using at most SIZE bytes of output buffers per rank. SIZE may end in K, M or G. By default each rank holds all of its output until the end." },
 	{ 0 }
 };
 
@@ -28,10 +71,104 @@ struct arguments {
 	int verbose;
 	char *output_file;
 	double high_density_ratio;
+	char *center_x;
+	char *center_y;
+	double scale;
+	int precision;
+	char *cache_directory;
+	long long cache_megabytes;
+	char *keyframes_file;
+	int num_frames;
+	long long memory_cap;
+	int format;
+	int symmetry;
+	char *timings_file;
+	char *trace_file;
+	int counters;
+	char *counters_file;
+	char *serve_path;
+	int aggregate_group;
+	int resume;
+	char *pyramid_file;
+	int pooling;
+	int keep_orbits;
+	int refine;
 };
 
+// Everything the ranks need from the command line, laid out so root can
+// broadcast it in one message. The center is kept as text so every rank parses
+// it to the full double-double precision.
+struct settings {
+	int max_iterations;
+	int x_resolution;
+	int y_resolution;
+	int verbose;
+	int precision;
+	double high_density_ratio;
+	double scale;
+	char center_x[BUFSIZE];
+	char center_y[BUFSIZE];
+	char output_file[PATH_MAX];
+	// Empty if no cache is used.
+	char cache_directory[PATH_MAX];
+	long long cache_bytes;
+	// Empty unless rendering an animation.
+	char keyframes_file[PATH_MAX];
+	int num_frames;
+	// Bytes of output buffers per rank when streaming, 0 to not stream.
+	long long memory_cap;
+	int format;
+	int symmetry;
+	// Empty unless timings are wanted.
+	char timings_file[PATH_MAX];
+	// Empty unless tracing.
+	char trace_file[PATH_MAX];
+	// Whether to count, and where to write the counts, empty to print them.
+	int counters;
+	char counters_file[PATH_MAX];
+	// Empty unless serving tiles.
+	char serve_path[PATH_MAX];
+	// Ranks per writer when aggregating output, 0 for a whole node, and -1 to
+	// have every rank write.
+	int aggregate_group;
+	int resume;
+	// Empty unless writing a pyramid.
+	char pyramid_file[PATH_MAX];
+	int pooling;
+	// Whether to save the orbits of pixels that reach the limit, or to carry on
+	// saved ones to a higher limit.
+	int keep_orbits;
+	int refine;
+};
+
+// Parse a number of bytes with an optional K, M or G suffix. Returns -1 if the
+// size is malformed.
+long long parse_size( const char * text ){
+	char * end;
+	long long size = strtoll( text, &end, 10 );
+	if( end == text ){
+		return -1;
+	}
+	switch( *end ){
+		case 'K': case 'k':
+			size *= 1024;
+			end++;
+			break;
+		case 'M': case 'm':
+			size *= 1024 * 1024;
+			end++;
+			break;
+		case 'G': case 'g':
+			size *= 1024 * 1024 * 1024;
+			end++;
+			break;
+	}
+	return *end == '\0' ? size : -1;
+}
+
 static error_t parse_opt( int key, char *arg, struct argp_state *state) {
 	struct arguments *arguments = state->input;
+	struct double_double parsed;
 	switch(key) {
 		case 'v':
 			arguments->verbose = 1;
@@ -42,6 +179,108 @@ static error_t parse_opt( int key, char *arg, struct argp_state *state) {
 		case 'h':
 			arguments->high_density_ratio = atof(arg);
 			break;
+		case 'x':
+			if( strlen(arg) >= BUFSIZE || dd_parse( arg, &parsed ) != 0 ){
+				argp_error( state, "invalid center-x '%s'", arg );
+			}
+			arguments->center_x = arg;
+			break;
+		case 'y':
+			if( strlen(arg) >= BUFSIZE || dd_parse( arg, &parsed ) != 0 ){
+				argp_error( state, "invalid center-y '%s'", arg );
+			}
+			arguments->center_y = arg;
+			break;
+		case 's':
+			arguments->scale = atof(arg);
+			if( arguments->scale <= 0.0 ){
+				argp_error( state, "scale must be positive" );
+			}
+			break;
+		case 'p':
+			arguments->precision = parse_precision( arg );
+			if( arguments->precision < 0 ){
+				argp_error( state, "unknown precision '%s'", arg );
+			}
+			break;
+		case 'c':
+			arguments->cache_directory = arg;
+			break;
+		case 'C':
+			arguments->cache_megabytes = atoll(arg);
+			if( arguments->cache_megabytes < 0 ){
+				argp_error( state, "cache-size can not be negative" );
+			}
+			break;
+		case 'k':
+			arguments->keyframes_file = arg;
+			break;
+		case 'n':
+			arguments->num_frames = atoi(arg);
+			if( arguments->num_frames <= 0 ){
+				argp_error( state, "frames must be positive" );
+			}
+			break;
+		case 'f':
+			if( strcmp( arg, "csv" ) == 0 ){
+				arguments->format = FORMAT_CSV;
+			} else if( strcmp( arg, "rle" ) == 0 ){
+				arguments->format = FORMAT_RLE;
+			} else if( strcmp( arg, "raw" ) == 0 ){
+				arguments->format = FORMAT_RAW;
+			} else {
+				argp_error( state, "unknown format '%s'", arg );
+			}
+			break;
+		case 'r':
+			arguments->symmetry = 1;
+			break;
+		case 't':
+			arguments->timings_file = arg;
+			break;
+		case 'T':
+			arguments->trace_file = arg;
+			break;
+		case 'H':
+			arguments->counters = 1;
+			arguments->counters_file = arg;
+			break;
+		case 'S':
+			arguments->serve_path = arg;
+			break;
+		case 'a':
+			arguments->aggregate_group = 0;
+			if( arg != NULL ){
+				arguments->aggregate_group = atoi(arg);
+				if( arguments->aggregate_group <= 0 ){
+					argp_error( state, "ranks per writer must be positive" );
+				}
+			}
+			break;
+		case 'R':
+			arguments->resume = 1;
+			break;
+		case 'z':
+			arguments->keep_orbits = 1;
+			break;
+		case 'e':
+			arguments->refine = 1;
+			break;
+		case 'P':
+			arguments->pyramid_file = arg;
+			break;
+		case 'l':
+			arguments->pooling = parse_pooling( arg );
+			if( arguments->pooling < 0 ){
+				argp_error( state, "unknown pooling '%s'", arg );
+			}
+			break;
+		case 'm':
+			arguments->memory_cap = parse_size( arg );
+			if( arguments->memory_cap <= 0 ){
+				argp_error( state, "invalid memory size '%s'", arg );
+			}
+			break;
 		case ARGP_KEY_ARG:
 			if( state->arg_num >= 3 ){
 				argp_usage( state );
@@ -49,7 +288,7 @@ static error_t parse_opt( int key, char *arg, struct argp_state *state) {
 			arguments->args[state->arg_num] = arg;
 			break;
 		case ARGP_KEY_END:
-			if( state->arg_num < 3 ){
+			if( state->arg_num < 3 && arguments->serve_path == NULL ){
 				argp_usage( state );
 			}
 			break;
@@ -61,66 +300,201 @@ static error_t parse_opt( int key, char *arg, struct argp_state *state) {
 
 static struct argp argp = { options, parse_opt, args_doc, doc };
 
-int main(int argc, char **argv){
+// Send root's reference orbit, including the series approximation, to every rank.
+void broadcast_reference_orbit( struct reference_orbit * orbit, int my_rank ){
+	TRACE_BEGIN( "MPI_Bcast" );
+	int lengths[2] = { orbit->length, orbit->skip };
+	MPI_Bcast( lengths, 2, MPI_INT, ROOT_RANK, MPI_COMM_WORLD );
+	if( my_rank != ROOT_RANK ){
+		orbit->length = lengths[0];
+		orbit->skip = lengths[1];
+		orbit->z = (double complex*)malloc(sizeof(double complex)*orbit->length);
+	}
+	double complex series[3] = { orbit->series_a, orbit->series_b, orbit->series_c };
+	MPI_Bcast( series, 3, MPI_C_DOUBLE_COMPLEX, ROOT_RANK, MPI_COMM_WORLD );
+	orbit->series_a = series[0];
+	orbit->series_b = series[1];
+	orbit->series_c = series[2];
+	MPI_Bcast( orbit->z, orbit->length, MPI_C_DOUBLE_COMPLEX, ROOT_RANK, MPI_COMM_WORLD );
+	TRACE_END();
+}
 
-	int verbose, max_iterations, x_resolution, y_resolution;
-	double high_density_ratio = 0.0;
-	// Array to store the arguments needed by all processes. Space is allocated for
-	// the string length of the output file, so that non-root ranks will know how
-	// much space to allocate.
-	int * arguments_buffer = (int*)malloc(sizeof(int)*5);
-	// Char array to store the name of the output file.
-	char * output_file;
+// Compute the tiles of the viewport missing from the cache, spread across all
+// ranks, so the rows can then be read back from the cache.
+void fill_tile_cache( struct tile_cache * cache, struct phase_timings * timings, int my_rank, int n_procs, int verbose ){
+	int num_tiles = cache->tiles_x * cache->tiles_y;
+	int * missing = (int*)malloc(sizeof(int)*num_tiles);
+	int num_missing = 0;
+	if( my_rank == ROOT_RANK ){
+		for( int tile_i=0; tile_i<num_tiles; tile_i++ ){
+			if( !tile_cache_contains( cache, tile_i ) ){
+				missing[num_missing] = tile_i;
+				num_missing++;
+			}
+		}
+		if( verbose ){
+			printf("%d of %d tiles are missing from the cache.\n", num_missing, num_tiles);
+		}
+	}
+	TRACE_BEGIN( "MPI_Bcast" );
+	MPI_Bcast( &num_missing, 1, MPI_INT, ROOT_RANK, MPI_COMM_WORLD );
+	MPI_Bcast( missing, num_missing, MPI_INT, ROOT_RANK, MPI_COMM_WORLD );
+	TRACE_END();
 
-	int my_rank, n_procs;
+	// Deal the missing tiles out round robin, so neighbouring tiles of similar
+	// cost end up on different ranks.
+	int * iterations = (int*)malloc(sizeof(int)*TILE_SIZE*TILE_SIZE);
+	begin_phase( timings, PHASE_COMPUTE );
+	for( int missing_i=my_rank; missing_i<num_missing; missing_i+=n_procs ){
+		compute_tile( cache, missing[missing_i], iterations );
+	}
+	end_phase( timings, PHASE_COMPUTE );
+	free(iterations);
+	free(missing);
 
-	MPI_Init(&argc,&argv);
-  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
-  MPI_Comm_size(MPI_COMM_WORLD,&n_procs);
+	TRACE_BEGIN( "MPI_Barrier" );
+	MPI_Barrier( MPI_COMM_WORLD );
+	TRACE_END();
+}
 
-	// Have the root process parse the command line arguments so any output will
-	// only be printed once.
-	if(my_rank == ROOT_RANK) {
-		struct arguments arguments;
-		arguments.verbose = 0;
-		arguments.high_density_ratio = 0.0;
-		arguments.output_file = "mandelbrot_set.csv";
+// Render every frame of an animation in this one job. Each rank renders a
+// contiguous block of frames, so it can reuse pixels from the frame it rendered
+// just before.
+void render_sequence( const struct settings * settings, int my_rank, int n_procs ){
+	// Have root read the keyframes and send them to every rank.
+	struct keyframe * keyframes = NULL;
+	int num_keyframes;
+	if( my_rank == ROOT_RANK ){
+		num_keyframes = read_keyframes( settings->keyframes_file, &keyframes );
+		if( num_keyframes <= 0 ){
+			fprintf(stderr, "Could not read keyframes from %s.\n", settings->keyframes_file);
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+	}
+	TRACE_BEGIN( "MPI_Bcast" );
+	MPI_Bcast( &num_keyframes, 1, MPI_INT, ROOT_RANK, MPI_COMM_WORLD );
+	if( my_rank != ROOT_RANK ){
+		keyframes = (struct keyframe*)malloc(sizeof(struct keyframe)*num_keyframes);
+	}
+	MPI_Bcast( keyframes, sizeof(struct keyframe)*num_keyframes, MPI_BYTE, ROOT_RANK, MPI_COMM_WORLD );
+	TRACE_END();
 
-		argp_parse (&argp, argc, argv, 0, 0, &arguments);
+	int num_frames = settings->num_frames > 0 ? settings->num_frames : num_keyframes;
+	int first_frame = (long long)num_frames * my_rank / n_procs;
+	int last_frame = (long long)num_frames * (my_rank + 1) / n_procs;
 
-		sscanf(arguments.args[0],"%d",&arguments_buffer[0]);
-		sscanf(arguments.args[1],"%d",&arguments_buffer[1]);
-		sscanf(arguments.args[2],"%d",&arguments_buffer[2]);
-		arguments_buffer[3] = arguments.verbose;
-		output_file = arguments.output_file;
-		arguments_buffer[4] = strlen(arguments.output_file);
-		high_density_ratio = arguments.high_density_ratio;
+	// A zoom animation usually keeps one center throughout. Then the reference
+	// orbit is the same for every frame, so root computes it once for everyone.
+	struct keyframe first, frame;
+	struct viewport viewport;
+	interpolate_keyframes( keyframes, num_keyframes, 0, num_frames, &first );
+	int shared_center = 1;
+	int any_perturbation = 0;
+	for( int frame_i=0; frame_i<num_frames; frame_i++ ){
+		interpolate_keyframes( keyframes, num_keyframes, frame_i, num_frames, &frame );
+		shared_center = shared_center && same_center( &first, &frame );
+		init_viewport( &viewport, frame.center_x, frame.center_y, frame.scale, settings->x_resolution, settings->y_resolution );
+		if( viewport_too_deep( &viewport ) ){
+			if( my_rank == ROOT_RANK ){
+				fprintf(stderr, "The pixels of frame %d are too close together for its center to tell them apart.\n", frame_i);
+			}
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+		any_perturbation = any_perturbation || select_precision( &viewport, settings->precision ) == PRECISION_PERTURBATION;
 	}
-
-	// Broadcast the command line arguments processed by root.
-	MPI_Bcast( arguments_buffer, 5, MPI_INT, ROOT_RANK, MPI_COMM_WORLD );
-	// Only the non-root ranks need to explicitly allocate space.
-	if(my_rank != ROOT_RANK) {
-		output_file = (char*)malloc(sizeof(char)*arguments_buffer[4]);
+	struct reference_orbit orbit;
+	orbit.z = NULL;
+	struct keyframe orbit_center = first;
+	if( shared_center && any_perturbation ){
+		if( my_rank == ROOT_RANK ){
+			compute_reference_orbit( first.center_x, first.center_y, settings->max_iterations, 0.0, &orbit );
+		}
+		broadcast_reference_orbit( &orbit, my_rank );
 	}
-	MPI_Bcast( output_file, arguments_buffer[4], MPI_CHAR, ROOT_RANK, MPI_COMM_WORLD );
 
-	MPI_Bcast( &high_density_ratio, 1, MPI_DOUBLE, ROOT_RANK, MPI_COMM_WORLD );
+	long long num_pixels = (long long)settings->x_resolution * settings->y_resolution;
+	int * frame_iterations[2];
+	frame_iterations[0] = (int*)malloc(sizeof(int)*num_pixels);
+	frame_iterations[1] = (int*)malloc(sizeof(int)*num_pixels);
+	struct renderer renderers[2];
+	int current = 0;
+	char path[PATH_MAX];
 
-	max_iterations = arguments_buffer[0];
-	x_resolution = arguments_buffer[1];
-	y_resolution = arguments_buffer[2];
-	verbose = arguments_buffer[3];
+	for( int frame_i=first_frame; frame_i<last_frame; frame_i++ ){
+		interpolate_keyframes( keyframes, num_keyframes, frame_i, num_frames, &frame );
+		init_viewport( &viewport, frame.center_x, frame.center_y, frame.scale, settings->x_resolution, settings->y_resolution );
+		struct renderer * renderer = &renderers[current];
+		init_renderer( renderer, &viewport, settings->max_iterations, settings->precision, 0 );
+		if( renderer->precision == PRECISION_PERTURBATION ){
+			// Without a shared center, keep reusing this rank's last orbit for as
+			// long as the center stays put.
+			if( orbit.z == NULL || !same_center( &orbit_center, &frame ) ){
+				if( orbit.z != NULL ){
+					free_reference_orbit( &orbit );
+				}
+				compute_reference_orbit( frame.center_x, frame.center_y, settings->max_iterations, 0.0, &orbit );
+				orbit_center = frame;
+			}
+			share_reference_orbit( renderer, &orbit );
+		}
 
-	free(arguments_buffer);
+		TRACE_BEGIN( "compute" );
+		int previous = 1 - current;
+		int num_reused = render_frame(
+			renderer,
+			frame_i > first_frame ? &renderers[previous] : NULL,
+			frame_iterations[previous],
+			frame_iterations[current]
+		);
+		TRACE_END();
 
-	double x_step = 3.0 / x_resolution;
-	double y_step = 3.0 / y_resolution;
+		TRACE_BEGIN( "write" );
+		snprintf( path, PATH_MAX, settings->output_file, frame_i );
+		if( write_frame( path, &viewport, settings->max_iterations, frame_iterations[current] ) != 0 ){
+			fprintf(stderr, "Rank %d could not write %s.\n", my_rank, path);
+		}
+		TRACE_END();
+		if( settings->verbose ){
+			printf("Rank %d rendered frame %d, reusing %d pixels of the previous frame.\n", my_rank, frame_i, num_reused);
+		}
 
-	clock_t begin, end, set_calc_begin, set_calc_end;
-	if( my_rank == ROOT_RANK && verbose ){
-		begin = clock();
+		if( frame_i > first_frame ){
+			free_renderer( &renderers[previous] );
+		}
+		current = previous;
+	}
+	if( last_frame > first_frame ){
+		free_renderer( &renderers[1 - current] );
+	}
+
+	if( orbit.z != NULL ){
+		free_reference_orbit( &orbit );
 	}
+	free(frame_iterations[0]);
+	free(frame_iterations[1]);
+	free(keyframes);
+}
+
+// Fill in the iteration counts of one row, from the cache if there is one.
+void compute_row( const struct renderer * renderer, struct tile_cache * cache, int y_i, int * iterations ){
+	if( cache != NULL ){
+		tile_cache_row( cache, y_i, iterations );
+	} else {
+		render_row( renderer, y_i, iterations );
+	}
+}
+
+// Render the whole viewport, holding this rank's share of the output in memory
+// until it is written at the end.
+void render_chunked( const struct settings * settings, struct renderer * renderer, struct tile_cache * cache, struct phase_timings * timings, int my_rank, int n_procs ){
+	int max_iterations = settings->max_iterations;
+	int x_resolution = settings->x_resolution;
+	int y_resolution = settings->y_resolution;
+	int verbose = settings->verbose;
+	double high_density_ratio = settings->high_density_ratio;
+	const char * output_file = settings->output_file;
+	const struct viewport * viewport = &renderer->viewport;
+	clock_t set_calc_begin, set_calc_end;
 
 	// For high limits, the bulk of the computational time will be spent verifying
 	// points that are inside the Mandelbrot set.
@@ -162,9 +536,9 @@ int main(int argc, char **argv){
   }
 	// A 2D array to store the displacement of the text each rank will write to the
 	// output file for each chunk of y values.
-	int ** file_offsets = (int**)malloc(sizeof(int*)*num_chunks);
+	long long ** file_offsets = (long long**)malloc(sizeof(long long*)*num_chunks);
   for (int chunk_i=0; chunk_i<num_chunks; chunk_i++) {
-    file_offsets[chunk_i]=(int*)malloc(sizeof(int)*n_procs);
+    file_offsets[chunk_i]=(long long*)calloc(n_procs,sizeof(long long));
   }
 
 	// Have all ranks calculate the range of y values each rank will be responsible
@@ -197,12 +571,43 @@ int main(int argc, char **argv){
 		}
 	}
 
+	// Each of this rank's chunks is a band of the pyramid.
+	struct pyramid_builder pyramid;
+	int use_pyramid = settings->pyramid_file[0] != '\0';
+	if( use_pyramid ){
+		struct pyramid_header pyramid_header;
+		init_pyramid_header( &pyramid_header, x_resolution, y_resolution, max_iterations, PYRAMID_TILE_SIZE, settings->pooling );
+		pyramid_header.x_first = viewport_x( viewport, 0 );
+		pyramid_header.x_last = viewport_x( viewport, x_resolution - 1 );
+		pyramid_header.y_first = viewport_y( viewport, 0 );
+		pyramid_header.y_last = viewport_y( viewport, y_resolution - 1 );
+		init_pyramid_builder( &pyramid, &pyramid_header, start_y_i, max_y_i, num_chunks );
+	}
+
+	// The x values of every row are the same, so format them once up front.
+	struct csv_formatter formatter;
+	init_csv_formatter( &formatter, viewport, max_iterations );
+	long long row_size = csv_row_max_size( &formatter );
+
 	// The buffers to store the results of a rank's calculations in the form they
-	// will be written to the output file.
+	// will be written to the output file. When aggregating they are in memory
+	// shared with the node's writer.
 	char ** result_buffer = (char**)malloc(sizeof(char*)*num_chunks);
-  for (int chunk_i=0; chunk_i<num_chunks; chunk_i++) {
-    result_buffer[chunk_i]=(char*)malloc(sizeof(char)*num_to_send[chunk_i][my_rank]*SIZE_PER_LINE);
-  }
+	struct node_writer node_writer;
+	if( settings->aggregate_group >= 0 ){
+		long long * capacities = (long long*)malloc(sizeof(long long)*num_chunks);
+		for( int chunk_i=0; chunk_i<num_chunks; chunk_i++ ){
+			capacities[chunk_i] = (max_y_i[chunk_i] - start_y_i[chunk_i]) * row_size;
+		}
+		open_node_writer( &node_writer, capacities, result_buffer, num_chunks, settings->aggregate_group, MPI_COMM_WORLD );
+		free(capacities);
+	} else {
+		for( int chunk_i=0; chunk_i<num_chunks; chunk_i++ ){
+			result_buffer[chunk_i] = (char*)malloc(sizeof(char)*(max_y_i[chunk_i]-start_y_i[chunk_i])*row_size);
+		}
+	}
+	// The number of characters actually stored in each result buffer.
+	long long * result_sizes = (long long*)calloc(num_chunks,sizeof(long long));
 
 	if( verbose ){
 		set_calc_begin = clock();
@@ -210,27 +615,27 @@ int main(int argc, char **argv){
 
 	// For each chunk, calculate Mandelbrot set in range and store results in the
 	// corresponding buffer.
-	// A char array to store strings as ranks calculate how much space in the output
-	// file their results will take up and when actually writing to the file.
-	char * char_buffer = (char*)malloc(sizeof(char)*BUFSIZE);
+	int * iterations = (int*)malloc(sizeof(int)*x_resolution);
 	for( int chunk_i=0; chunk_i<num_chunks; chunk_i++ ){
 		int y_i = start_y_i[chunk_i];
 		char * moving_pointer = result_buffer[chunk_i];
 		while( y_i<max_y_i[chunk_i] ){
-			double y = -1.5 + (y_i * y_step);
-			for( int x_i=0; x_i<x_resolution; x_i++ ){
-				double x = -2.0 + x_i * x_step;
-				double complex c = x + y * I;
-				int iterations = in_mandelbrot_set( c, max_iterations );
-				// Calculate how much space the result will take up in the file.
-				snprintf(char_buffer, BUFSIZE, "%f,%f,%d\n", x, y, iterations );
-				int line_size = strlen( char_buffer );
-				strcpy( moving_pointer, char_buffer );
-				moving_pointer = moving_pointer + line_size;
-				file_offsets[chunk_i][my_rank] += line_size;
+			begin_phase( timings, PHASE_COMPUTE );
+			compute_row( renderer, cache, y_i, iterations );
+			end_phase( timings, PHASE_COMPUTE );
+			// Keep track of how much space the results will take up in the file.
+			begin_phase( timings, PHASE_FORMAT );
+			csv_formatter_set_row( &formatter, viewport, y_i );
+			int row_length = format_csv_row( &formatter, iterations, moving_pointer );
+			if( use_pyramid ){
+				pyramid_add_row( &pyramid, chunk_i, y_i, iterations );
 			}
+			end_phase( timings, PHASE_FORMAT );
+			moving_pointer = moving_pointer + row_length;
+			file_offsets[chunk_i][my_rank] += row_length;
 			y_i++;
 		}
+		result_sizes[chunk_i] = file_offsets[chunk_i][my_rank];
 	}
 
 	if( verbose ){
@@ -240,17 +645,20 @@ int main(int argc, char **argv){
 	}
 
 	// Gather the file_offsets calculated by reach rank.
+	begin_phase( timings, PHASE_EXCHANGE );
+	TRACE_BEGIN( "MPI_Allgather" );
 	for( int chunk_i=0; chunk_i<num_chunks; chunk_i++ ){
 		MPI_Allgather(
 			MPI_IN_PLACE,
 			1,
-			MPI_INT,
+			MPI_LONG_LONG,
 			file_offsets[chunk_i],
 			1,
-			MPI_INT,
+			MPI_LONG_LONG,
 			MPI_COMM_WORLD
 		);
 	}
+	TRACE_END();
 
 	// file_offsets currently stores the character length of each rank's chunk of
 	// results to write. Need to recalculate it so it describes how far, from 0,
@@ -278,29 +686,56 @@ int main(int argc, char **argv){
 			}
 		}
 	}
+	if( use_pyramid ){
+		reduce_pyramid( &pyramid, MPI_COMM_WORLD );
+	}
+	end_phase( timings, PHASE_EXCHANGE );
 
 	// Have the processes write the results to a file.
 	// Only need to write the header once, so only have the root write the header.
-	int header_size = strlen("x,y,z\n");
+	begin_phase( timings, PHASE_WRITE );
+	int header_size = strlen(CSV_HEADER);
 	if( my_rank == ROOT_RANK ){
 		FILE * file;
 		file = fopen(output_file, "w+");
-		fprintf(file, "x,y,z\n");
+		fprintf(file, CSV_HEADER);
 		fclose(file);
 	}
 
-	MPI_File file;
-	MPI_File_open( MPI_COMM_WORLD, output_file, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &file );
+	if( settings->aggregate_group >= 0 ){
+		struct file_piece * pieces = (struct file_piece*)malloc(sizeof(struct file_piece)*num_chunks);
+		for( int chunk_i=0; chunk_i<num_chunks; chunk_i++ ){
+			pieces[chunk_i].offset = header_size + file_offsets[chunk_i][my_rank];
+			pieces[chunk_i].size = result_sizes[chunk_i];
+		}
+		if( write_through_node( &node_writer, output_file, pieces ) != 0 ){
+			fprintf(stderr, "Rank %d could not write %s.\n", my_rank, output_file);
+		}
+		free(pieces);
+	} else {
+		MPI_File file;
+		TRACE_BEGIN( "MPI_File_open" );
+		MPI_File_open( MPI_COMM_WORLD, output_file, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &file );
+		TRACE_END();
 
-	for( int chunk_i=0; chunk_i<num_chunks; chunk_i++ ){
-		MPI_File_set_view( file, header_size + file_offsets[chunk_i][my_rank], MPI_CHAR, MPI_CHAR, "native", MPI_INFO_NULL );
-		MPI_File_write_all( file, result_buffer[chunk_i], strlen(result_buffer[chunk_i]), MPI_CHAR, MPI_STATUS_IGNORE );
+		TRACE_BEGIN( "MPI_File_write_all" );
+		for( int chunk_i=0; chunk_i<num_chunks; chunk_i++ ){
+			MPI_File_set_view( file, header_size + file_offsets[chunk_i][my_rank], MPI_CHAR, MPI_CHAR, "native", MPI_INFO_NULL );
+			write_all_large( file, result_buffer[chunk_i], result_sizes[chunk_i], MPI_CHAR );
+		}
+		TRACE_END();
+		TRACE_BEGIN( "MPI_File_close" );
+		MPI_File_close(&file);
+		TRACE_END();
 	}
-	MPI_File_close(&file);
-
-	if(my_rank != ROOT_RANK){
-		free(output_file);
+	if( use_pyramid ){
+		if( write_pyramid( &pyramid, settings->pyramid_file, ROOT_RANK, MPI_COMM_WORLD ) != 0 ){
+			fprintf(stderr, "Rank %d could not write %s.\n", my_rank, settings->pyramid_file);
+		}
+		free_pyramid_builder( &pyramid );
 	}
+	end_phase( timings, PHASE_WRITE );
+
 	free(chunk_sizes);
 	free(start_y_i);
 	free(max_y_i);
@@ -309,16 +744,1172 @@ int main(int argc, char **argv){
   }
   free(num_to_send);
 	for(int chunk_i=0; chunk_i<num_chunks; chunk_i++){
-    free(result_buffer[chunk_i]);
+    free(file_offsets[chunk_i]);
   }
+  free(file_offsets);
+	if( settings->aggregate_group >= 0 ){
+		close_node_writer( &node_writer );
+	} else {
+		for( int chunk_i=0; chunk_i<num_chunks; chunk_i++ ){
+			free(result_buffer[chunk_i]);
+		}
+	}
+	free(result_buffer);
+	free(result_sizes);
+	free_csv_formatter( &formatter );
+	free(iterations);
+}
+
+// Render in bands of rows, holding at most memory_cap bytes of output per rank.
+// Each rank renders a contiguous slice of every band, and the band is written
+// with a nonblocking collective write while the next band is computed into the
+// other half of a double buffer. Since the ranks split every band between them,
+// dense rows of the set are shared out without the chunks render_chunked uses.
+void render_streaming( const struct settings * settings, struct renderer * renderer, struct tile_cache * cache, struct phase_timings * timings, int my_rank, int n_procs ){
+	const struct viewport * viewport = &renderer->viewport;
+	int y_resolution = settings->y_resolution;
+	clock_t set_calc_begin, set_calc_end;
+
+	struct csv_formatter formatter;
+	init_csv_formatter( &formatter, viewport, settings->max_iterations );
+	long long row_size = csv_row_max_size( &formatter );
+
+	// Half of the cap goes to each buffer. Always allow at least one row, and
+	// keep a buffer's length within the int count MPI takes.
+	long long rows_per_rank = settings->memory_cap / (2 * row_size);
+	if( rows_per_rank > INT_MAX / row_size ){
+		rows_per_rank = INT_MAX / row_size;
+	}
+	long long rows_needed = (y_resolution + n_procs - 1) / n_procs;
+	if( rows_per_rank > rows_needed ){
+		rows_per_rank = rows_needed;
+	}
+	if( rows_per_rank < 1 ){
+		rows_per_rank = 1;
+	}
+	long long band_rows = rows_per_rank * n_procs;
+	int num_bands = (y_resolution + band_rows - 1) / band_rows;
+	if( my_rank == ROOT_RANK && settings->verbose ){
+		printf("Streaming %d bands of %lld rows, %lld rows per rank.\n", num_bands, band_rows, rows_per_rank);
+	}
+
+	char * buffers[2];
+	buffers[0] = (char*)malloc(sizeof(char)*rows_per_rank*row_size);
+	buffers[1] = (char*)malloc(sizeof(char)*rows_per_rank*row_size);
+	MPI_Request requests[2] = { MPI_REQUEST_NULL, MPI_REQUEST_NULL };
+	int * iterations = (int*)malloc(sizeof(int)*settings->x_resolution);
+
+	// Only need to write the header once, so only have the root write the header.
+	begin_phase( timings, PHASE_WRITE );
+	if( my_rank == ROOT_RANK ){
+		FILE * file;
+		file = fopen(settings->output_file, "w+");
+		fprintf(file, CSV_HEADER);
+		fclose(file);
+	}
+
+	MPI_File file;
+	TRACE_BEGIN( "MPI_File_open" );
+	MPI_File_open( MPI_COMM_WORLD, settings->output_file, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &file );
+	TRACE_END();
+	end_phase( timings, PHASE_WRITE );
+
+	if( settings->verbose ){
+		set_calc_begin = clock();
+	}
+
+	// Where in the file the current band starts.
+	MPI_Offset band_offset = strlen(CSV_HEADER);
+	for( int band_i=0; band_i<num_bands; band_i++ ){
+		// Wait for the write from two bands ago before reusing its buffer.
+		char * buffer = buffers[band_i % 2];
+		begin_phase( timings, PHASE_WRITE );
+		TRACE_BEGIN( "MPI_Wait" );
+		MPI_Wait( &requests[band_i % 2], MPI_STATUS_IGNORE );
+		TRACE_END();
+		end_phase( timings, PHASE_WRITE );
+
+		long long start_y_i = band_i * band_rows + my_rank * rows_per_rank;
+		long long max_y_i = start_y_i + rows_per_rank;
+		if( start_y_i > y_resolution ){
+			start_y_i = y_resolution;
+		}
+		if( max_y_i > y_resolution ){
+			max_y_i = y_resolution;
+		}
+		long long length = 0;
+		for( int y_i=start_y_i; y_i<max_y_i; y_i++ ){
+			begin_phase( timings, PHASE_COMPUTE );
+			compute_row( renderer, cache, y_i, iterations );
+			end_phase( timings, PHASE_COMPUTE );
+			begin_phase( timings, PHASE_FORMAT );
+			csv_formatter_set_row( &formatter, viewport, y_i );
+			length += format_csv_row( &formatter, iterations, buffer + length );
+			end_phase( timings, PHASE_FORMAT );
+		}
+
+		// Rows are written in rank order, so each rank's text starts after the
+		// text of the ranks before it in this band.
+		long long preceding = 0;
+		long long band_length;
+		begin_phase( timings, PHASE_EXCHANGE );
+		TRACE_BEGIN( "MPI_Exscan" );
+		MPI_Exscan( &length, &preceding, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD );
+		TRACE_END();
+		if( my_rank == 0 ){
+			preceding = 0;
+		}
+		TRACE_BEGIN( "MPI_Allreduce" );
+		MPI_Allreduce( &length, &band_length, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD );
+		TRACE_END();
+		end_phase( timings, PHASE_EXCHANGE );
+
+		begin_phase( timings, PHASE_WRITE );
+		TRACE_BEGIN( "MPI_File_iwrite_at_all" );
+		MPI_File_iwrite_at_all( file, band_offset + preceding, buffer, length, MPI_CHAR, &requests[band_i % 2] );
+		TRACE_END();
+		end_phase( timings, PHASE_WRITE );
+		band_offset += band_length;
+	}
+	begin_phase( timings, PHASE_WRITE );
+	TRACE_BEGIN( "MPI_Waitall" );
+	MPI_Waitall( 2, requests, MPI_STATUSES_IGNORE );
+	TRACE_END();
+	TRACE_BEGIN( "MPI_File_close" );
+	MPI_File_close(&file);
+	TRACE_END();
+	end_phase( timings, PHASE_WRITE );
+
+	if( settings->verbose ){
+		set_calc_end = clock();
+		double seconds = (double)(set_calc_end - set_calc_begin) / CLOCKS_PER_SEC;
+		printf("Rank %d took %f seconds to calculate and write its share of the points.\n", my_rank, seconds);
+	}
+
+	free(buffers[0]);
+	free(buffers[1]);
+	free(iterations);
+	free_csv_formatter( &formatter );
+}
+
+// Render the viewport into a run length encoded file. The chunks of rows are
+// dealt out round robin, so the dense rows in the middle of the set are shared
+// between the ranks, and each rank encodes its chunks independently. Once every
+// chunk's size is known, the ranks all work out the chunk index and write their
+// chunks into place with one collective write.
+void render_rle( const struct settings * settings, struct renderer * renderer, struct tile_cache * cache, struct phase_timings * timings, int my_rank, int n_procs ){
+	const struct viewport * viewport = &renderer->viewport;
+	int x_resolution = settings->x_resolution;
+	int y_resolution = settings->y_resolution;
+	clock_t set_calc_begin, set_calc_end;
+
+	struct rle_header header;
+	init_rle_header( &header, x_resolution, y_resolution, settings->max_iterations, RLE_ROWS_PER_CHUNK );
+	int num_chunks = header.num_chunks;
+	long long chunk_pixels = (long long)header.rows_per_chunk * x_resolution;
+
+	if( settings->verbose ){
+		set_calc_begin = clock();
+	}
+
+	int * iterations = (int*)malloc(sizeof(int)*chunk_pixels);
+	long long * chunk_sizes = (long long*)calloc(num_chunks,sizeof(long long));
+	long long encoded_size = 0;
+	long long encoded_capacity = rle_max_size( chunk_pixels );
+	unsigned char * encoded = (unsigned char*)malloc(encoded_capacity);
+	for( int chunk_i=my_rank; chunk_i<num_chunks; chunk_i+=n_procs ){
+		int start_y_i = chunk_i * header.rows_per_chunk;
+		int max_y_i = start_y_i + header.rows_per_chunk;
+		if( max_y_i > y_resolution ){
+			max_y_i = y_resolution;
+		}
+		begin_phase( timings, PHASE_COMPUTE );
+		for( int y_i=start_y_i; y_i<max_y_i; y_i++ ){
+			compute_row( renderer, cache, y_i, iterations + (long long)(y_i - start_y_i) * x_resolution );
+		}
+		end_phase( timings, PHASE_COMPUTE );
+		// Compressed chunks are usually far smaller than the bound, so only grow
+		// the buffer when the next chunk might not fit.
+		if( encoded_size + rle_max_size( chunk_pixels ) > encoded_capacity ){
+			encoded_capacity = 2 * encoded_capacity + rle_max_size( chunk_pixels );
+			encoded = (unsigned char*)realloc(encoded, encoded_capacity);
+		}
+		begin_phase( timings, PHASE_FORMAT );
+		chunk_sizes[chunk_i] = rle_encode( iterations, (long long)(max_y_i - start_y_i) * x_resolution, encoded + encoded_size );
+		end_phase( timings, PHASE_FORMAT );
+		encoded_size += chunk_sizes[chunk_i];
+	}
+
+	if( settings->verbose ){
+		set_calc_end = clock();
+		double seconds = (double)(set_calc_end - set_calc_begin) / CLOCKS_PER_SEC;
+		printf("Rank %d took %f seconds to calculate and encode its share of the points.\n", my_rank, seconds);
+	}
+
+	// Every chunk's size is non zero on exactly one rank, so summing gives all of
+	// them to every rank. The index is then a prefix sum over the sizes.
+	begin_phase( timings, PHASE_EXCHANGE );
+	TRACE_BEGIN( "MPI_Allreduce" );
+	MPI_Allreduce( MPI_IN_PLACE, chunk_sizes, num_chunks, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD );
+	TRACE_END();
+	long long * index = (long long*)malloc(sizeof(long long)*(num_chunks+1));
+	index[0] = rle_data_offset( &header );
+	for( int chunk_i=0; chunk_i<num_chunks; chunk_i++ ){
+		index[chunk_i+1] = index[chunk_i] + chunk_sizes[chunk_i];
+	}
+	end_phase( timings, PHASE_EXCHANGE );
+	if( my_rank == ROOT_RANK && settings->verbose ){
+		printf("Encoded %lld pixels in %lld bytes.\n", (long long)x_resolution * y_resolution, index[num_chunks]);
+	}
+
+	// Root writes everything ahead of the chunks.
+	begin_phase( timings, PHASE_WRITE );
+	if( my_rank == ROOT_RANK ){
+		FILE * file = fopen(settings->output_file, "w+");
+		fwrite( &header, sizeof(header), 1, file );
+		for( int x_i=0; x_i<x_resolution; x_i++ ){
+			double x = viewport_x( viewport, x_i );
+			fwrite( &x, sizeof(x), 1, file );
+		}
+		for( int y_i=0; y_i<y_resolution; y_i++ ){
+			double y = viewport_y( viewport, y_i );
+			fwrite( &y, sizeof(y), 1, file );
+		}
+		fwrite( index, sizeof(long long), num_chunks + 1, file );
+		fclose(file);
+	}
+
+	// Describe where this rank's chunks go with a file view, so they can all be
+	// written in one call, however large they are.
+	struct extents chunk_extents;
+	init_extents( &chunk_extents );
+	for( int chunk_i=my_rank; chunk_i<num_chunks; chunk_i+=n_procs ){
+		add_extent( &chunk_extents, index[chunk_i], chunk_sizes[chunk_i] );
+	}
+	MPI_Datatype chunks_type;
+	commit_extents_type( &chunk_extents, &chunks_type );
+
+	MPI_File file;
+	TRACE_BEGIN( "MPI_File_open" );
+	MPI_File_open( MPI_COMM_WORLD, settings->output_file, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &file );
+	TRACE_END();
+	TRACE_BEGIN( "MPI_File_write_all" );
+	MPI_File_set_view( file, 0, MPI_BYTE, chunks_type, "native", MPI_INFO_NULL );
+	write_all_large( file, encoded, encoded_size, MPI_BYTE );
+	TRACE_END();
+	TRACE_BEGIN( "MPI_File_close" );
+	MPI_File_close(&file);
+	TRACE_END();
+	end_phase( timings, PHASE_WRITE );
+
+	MPI_Type_free( &chunks_type );
+	free_extents( &chunk_extents );
+	free(index);
+	free(chunk_sizes);
+	free(encoded);
+	free(iterations);
+}
+
+// Write every rank's saved orbits to path, one rank's after another, with root
+// writing the header. Must be called by every rank. Returns 0 on success and -1
+// if the file could not be opened.
+int write_orbits( const char * path, struct orbits_header * header, const struct saved_orbit * orbits, long long num_orbits, int my_rank ){
+	long long first_orbit = 0;
+	TRACE_BEGIN( "MPI_Exscan" );
+	MPI_Exscan( &num_orbits, &first_orbit, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD );
+	MPI_Allreduce( &num_orbits, &header->num_orbits, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD );
+	TRACE_END();
+	// MPI_Exscan leaves the first rank's undefined.
+	if( my_rank == 0 ){
+		first_orbit = 0;
+	}
+
+	MPI_File file;
+	TRACE_BEGIN( "MPI_File_open" );
+	int error = MPI_File_open( MPI_COMM_WORLD, path, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &file );
+	TRACE_END();
+	if( error != MPI_SUCCESS ){
+		return -1;
+	}
+	MPI_Datatype orbit_type;
+	MPI_Type_contiguous( sizeof(struct saved_orbit), MPI_BYTE, &orbit_type );
+	MPI_Type_commit( &orbit_type );
+	TRACE_BEGIN( "MPI_File_write_at_all" );
+	MPI_File_set_size( file, sizeof(*header) + sizeof(struct saved_orbit) * header->num_orbits );
+	if( my_rank == ROOT_RANK ){
+		MPI_File_write_at( file, 0, header, sizeof(*header), MPI_BYTE, MPI_STATUS_IGNORE );
+	}
+	write_at_all_large( file, sizeof(*header) + sizeof(struct saved_orbit) * first_orbit, orbits, num_orbits, orbit_type );
+	TRACE_END();
+	TRACE_BEGIN( "MPI_File_close" );
+	MPI_File_close( &file );
+	TRACE_END();
+	MPI_Type_free( &orbit_type );
+	return 0;
+}
+
+// Have root get the files of a raw render ready, creating the output and a
+// journal with no rows written unless there is a journal of the same render to
+// resume. Fills in the rows still to be written, in order, and returns how many
+// there are.
+static int prepare_raw_render( const struct settings * settings, const struct viewport * viewport, const struct raw_header * header, const struct journal_header * journal_header, const char * journal_path, int * missing_rows ){
+	int x_resolution = header->x_resolution;
+	int y_resolution = header->y_resolution;
+	char * done = (char*)calloc(y_resolution,sizeof(char));
+	int resuming = 0;
+	if( settings->resume ){
+		FILE * journal = fopen( journal_path, "rb" );
+		if( journal != NULL ){
+			struct journal_header found;
+			if( fread( &found, sizeof(found), 1, journal ) != 1 || !same_journal( &found, journal_header ) ){
+				fprintf(stderr, "%s is not the journal of this render. The arguments must match those of the render being resumed.\n", journal_path);
+				MPI_Abort( MPI_COMM_WORLD, 1 );
+			}
+			// Rows past the end of a journal that was cut short are missing.
+			if( fread( done, sizeof(char), y_resolution, journal ) != (size_t)y_resolution && settings->verbose ){
+				printf("The journal ends early, rendering the rows past its end.\n");
+			}
+			fclose( journal );
+			struct raw_file raw;
+			if( open_raw_file( settings->output_file, &raw ) != 0 || memcmp( &raw.header, header, sizeof(*header) ) != 0 ){
+				fprintf(stderr, "%s is not the output %s journals.\n", settings->output_file, journal_path);
+				MPI_Abort( MPI_COMM_WORLD, 1 );
+			}
+			close_raw_file( &raw );
+			resuming = 1;
+		}
+	}
+
+	if( !resuming ){
+		FILE * file = fopen( settings->output_file, "w+" );
+		if( file == NULL ){
+			fprintf(stderr, "Could not write to %s.\n", settings->output_file);
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+		fwrite( header, sizeof(*header), 1, file );
+		for( int x_i=0; x_i<x_resolution; x_i++ ){
+			double x = viewport_x( viewport, x_i );
+			fwrite( &x, sizeof(x), 1, file );
+		}
+		for( int y_i=0; y_i<y_resolution; y_i++ ){
+			double y = viewport_y( viewport, y_i );
+			fwrite( &y, sizeof(y), 1, file );
+		}
+		fclose(file);
+		FILE * journal = fopen( journal_path, "w+" );
+		if( journal == NULL ){
+			fprintf(stderr, "Could not write to %s.\n", journal_path);
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+		fwrite( journal_header, sizeof(*journal_header), 1, journal );
+		fwrite( done, sizeof(char), y_resolution, journal );
+		fclose(journal);
+	}
+
+	int num_missing = 0;
+	for( int y_i=0; y_i<y_resolution; y_i++ ){
+		if( !done[y_i] ){
+			missing_rows[num_missing] = y_i;
+			num_missing++;
+		}
+	}
+	free(done);
+	return num_missing;
+}
+
+// Name a file kept beside the raw output, such as its journal. Output names too
+// long for every suffix are refused along with the other arguments, so failing
+// here means that check was missed, and aborts rather than cut the name short,
+// which could make it the output's own.
+void sidecar_path( char * path, const char * output_file, const char * suffix ){
+	if( snprintf( path, PATH_MAX, "%s%s", output_file, suffix ) >= PATH_MAX ){
+		fprintf(stderr, "%s%s is too long a file name.\n", output_file, suffix);
+		MPI_Abort( MPI_COMM_WORLD, 1 );
+	}
+}
+
+// Render the viewport into a raw file, recording each row in the journal once
+// it is safely written so a render that dies part way can be resumed. The rows
+// left to render are dealt out round robin in batches, so a resumed render
+// shares them between however many ranks it has. Each rank writes its batches
+// in place as it goes, rather than holding its output until the end.
+void render_raw( const struct settings * settings, struct renderer * renderer, struct tile_cache * cache, struct phase_timings * timings, int my_rank, int n_procs ){
+	int x_resolution = settings->x_resolution;
+	int y_resolution = settings->y_resolution;
+	char journal_path[PATH_MAX];
+	sidecar_path( journal_path, settings->output_file, JOURNAL_SUFFIX );
+
+	struct raw_header header;
+	init_raw_header( &header, x_resolution, y_resolution, settings->max_iterations );
+	struct journal_header journal_header;
+	init_journal_header( &journal_header, x_resolution, y_resolution, settings->max_iterations, settings->precision, settings->scale, settings->center_x, settings->center_y );
+
+	begin_phase( timings, PHASE_EXCHANGE );
+	int * missing_rows = (int*)malloc(sizeof(int)*y_resolution);
+	int num_missing = 0;
+	if( my_rank == ROOT_RANK ){
+		num_missing = prepare_raw_render( settings, &renderer->viewport, &header, &journal_header, journal_path, missing_rows );
+		if( settings->verbose ){
+			printf("Rendering %d of %d rows.\n", num_missing, y_resolution);
+		}
+	}
+	TRACE_BEGIN( "MPI_Bcast" );
+	MPI_Bcast( &num_missing, 1, MPI_INT, ROOT_RANK, MPI_COMM_WORLD );
+	MPI_Bcast( missing_rows, num_missing, MPI_INT, ROOT_RANK, MPI_COMM_WORLD );
+	TRACE_END();
+	end_phase( timings, PHASE_EXCHANGE );
+
+	// The ranks write independently, each syncing its own batches, so each opens
+	// the files by itself.
+	MPI_File file, journal;
+	TRACE_BEGIN( "MPI_File_open" );
+	if( MPI_File_open( MPI_COMM_SELF, settings->output_file, MPI_MODE_WRONLY, MPI_INFO_NULL, &file ) != MPI_SUCCESS
+			|| MPI_File_open( MPI_COMM_SELF, journal_path, MPI_MODE_WRONLY, MPI_INFO_NULL, &journal ) != MPI_SUCCESS ){
+		fprintf(stderr, "Rank %d could not open %s or its journal.\n", my_rank, settings->output_file);
+		MPI_Abort( MPI_COMM_WORLD, 1 );
+	}
+	TRACE_END();
+
+	int * iterations = (int*)malloc(sizeof(int)*RAW_ROWS_PER_BATCH*x_resolution);
+	// Where z was left for each pixel of the batch, and for those of every batch
+	// that reached the limit, when keeping orbits.
+	double * z_re = NULL;
+	double * z_im = NULL;
+	struct saved_orbit * orbits = NULL;
+	long long num_orbits = 0;
+	long long orbits_capacity = 0;
+	if( settings->keep_orbits ){
+		z_re = (double*)malloc(sizeof(double)*RAW_ROWS_PER_BATCH*x_resolution);
+		z_im = (double*)malloc(sizeof(double)*RAW_ROWS_PER_BATCH*x_resolution);
+	}
+	char written[RAW_ROWS_PER_BATCH];
+	memset( written, 1, sizeof(written) );
+	int num_batches = (num_missing + RAW_ROWS_PER_BATCH - 1) / RAW_ROWS_PER_BATCH;
+	for( int batch_i=my_rank; batch_i<num_batches; batch_i+=n_procs ){
+		int first = batch_i * RAW_ROWS_PER_BATCH;
+		int last = first + RAW_ROWS_PER_BATCH;
+		if( last > num_missing ){
+			last = num_missing;
+		}
+		begin_phase( timings, PHASE_COMPUTE );
+		for( int row_i=first; row_i<last; row_i++ ){
+			long long row_offset = (long long)(row_i - first) * x_resolution;
+			if( settings->keep_orbits ){
+				render_row_orbits( renderer, missing_rows[row_i], iterations + row_offset, z_re + row_offset, z_im + row_offset );
+			} else {
+				compute_row( renderer, cache, missing_rows[row_i], iterations + row_offset );
+			}
+		}
+		end_phase( timings, PHASE_COMPUTE );
+		if( settings->keep_orbits ){
+			for( long long pixel_i=0; pixel_i<(long long)(last - first) * x_resolution; pixel_i++ ){
+				if( iterations[pixel_i] != settings->max_iterations ){
+					continue;
+				}
+				if( num_orbits == orbits_capacity ){
+					orbits_capacity = 2 * orbits_capacity + x_resolution;
+					orbits = (struct saved_orbit*)realloc(orbits, sizeof(struct saved_orbit)*orbits_capacity);
+				}
+				orbits[num_orbits].pixel = (long long)missing_rows[first + pixel_i / x_resolution] * x_resolution + pixel_i % x_resolution;
+				orbits[num_orbits].z_re = z_re[pixel_i];
+				orbits[num_orbits].z_im = z_im[pixel_i];
+				num_orbits++;
+			}
+		}
+
+		// Rows of the batch that follow one another in the file are written
+		// together. Only once they are on disk does the journal say so.
+		begin_phase( timings, PHASE_WRITE );
+		TRACE_BEGIN( "MPI_File_write_at" );
+		for( int row_i=first; row_i<last; ){
+			int run_end = row_i + 1;
+			while( run_end < last && missing_rows[run_end] == missing_rows[run_end-1] + 1 ){
+				run_end++;
+			}
+			write_at_large( file, raw_row_offset( &header, missing_rows[row_i] ), iterations + (long long)(row_i - first) * x_resolution, (long long)(run_end - row_i) * x_resolution, MPI_INT );
+			row_i = run_end;
+		}
+		TRACE_END();
+		TRACE_BEGIN( "MPI_File_sync" );
+		MPI_File_sync( file );
+		TRACE_END();
+		TRACE_BEGIN( "MPI_File_write_at" );
+		for( int row_i=first; row_i<last; ){
+			int run_end = row_i + 1;
+			while( run_end < last && missing_rows[run_end] == missing_rows[run_end-1] + 1 ){
+				run_end++;
+			}
+			MPI_File_write_at( journal, sizeof(journal_header) + missing_rows[row_i], written, run_end - row_i, MPI_CHAR, MPI_STATUS_IGNORE );
+			row_i = run_end;
+		}
+		TRACE_END();
+		TRACE_BEGIN( "MPI_File_sync" );
+		MPI_File_sync( journal );
+		TRACE_END();
+		end_phase( timings, PHASE_WRITE );
+	}
+
+	TRACE_BEGIN( "MPI_File_close" );
+	MPI_File_close( &file );
+	MPI_File_close( &journal );
+	TRACE_END();
+
+	if( settings->keep_orbits ){
+		begin_phase( timings, PHASE_WRITE );
+		char orbits_path[PATH_MAX];
+		sidecar_path( orbits_path, settings->output_file, ORBITS_SUFFIX );
+		struct orbits_header orbits_header;
+		init_orbits_header( &orbits_header, x_resolution, y_resolution, settings->max_iterations, settings->precision, settings->scale, settings->center_x, settings->center_y );
+		if( write_orbits( orbits_path, &orbits_header, orbits, num_orbits, my_rank ) != 0 ){
+			fprintf(stderr, "Rank %d could not write %s.\n", my_rank, orbits_path);
+		}
+		end_phase( timings, PHASE_WRITE );
+		if( my_rank == ROOT_RANK && settings->verbose ){
+			printf("Saved the orbits of %lld pixels that reached the limit.\n", orbits_header.num_orbits);
+		}
+	}
+	free(z_re);
+	free(z_im);
+	free(orbits);
+	free(iterations);
+	free(missing_rows);
+}
+
+// Have root check a raw render, its saved orbits and its journal, if it has one,
+// can be refined to the limit of settings. Returns the header of the orbits.
+static struct orbits_header check_refinement( const struct settings * settings, const char * orbits_path, const char * journal_path ){
+	struct raw_file raw;
+	if( open_raw_file( settings->output_file, &raw ) != 0 ){
+		fprintf(stderr, "%s is not a raw Mandelbrot set to refine.\n", settings->output_file);
+		MPI_Abort( MPI_COMM_WORLD, 1 );
+	}
+	int limit = raw.header.limit;
+	close_raw_file( &raw );
+
+	struct orbits_header expected, found;
+	init_orbits_header( &expected, settings->x_resolution, settings->y_resolution, limit, settings->precision, settings->scale, settings->center_x, settings->center_y );
+	FILE * file = fopen( orbits_path, "rb" );
+	if( file == NULL || fread( &found, sizeof(found), 1, file ) != 1 || !same_orbits_region( &found, &expected ) || found.limit != limit ){
+		fprintf(stderr, "%s does not hold the orbits of %s at its limit of %d. The arguments must match those it was rendered with, and it must have been rendered with --orbits.\n", orbits_path, settings->output_file, limit);
+		MPI_Abort( MPI_COMM_WORLD, 1 );
+	}
+	fclose(file);
+	if( settings->max_iterations <= limit ){
+		fprintf(stderr, "%s was rendered with a limit of %d, which can only be refined to a higher one.\n", settings->output_file, limit);
+		MPI_Abort( MPI_COMM_WORLD, 1 );
+	}
+
+	// Rows a render did not finish have no orbits to carry on.
+	file = fopen( journal_path, "rb" );
+	if( file != NULL ){
+		char * done = (char*)malloc(sizeof(char)*settings->y_resolution);
+		struct journal_header journal_header;
+		if( fread( &journal_header, sizeof(journal_header), 1, file ) != 1
+				|| fread( done, sizeof(char), settings->y_resolution, file ) != (size_t)settings->y_resolution
+				|| memchr( done, 0, settings->y_resolution ) != NULL ){
+			fprintf(stderr, "%s is unfinished. Finish it with --resume before refining it.\n", settings->output_file);
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+		free(done);
+		fclose(file);
+	}
+	return found;
+}
+
+// Have root record a new limit in the header of a raw file or its journal, at
+// limit_offset.
+static void update_raw_limit( const char * path, long long limit_offset, int limit ){
+	FILE * file = fopen( path, "r+b" );
+	if( file != NULL ){
+		fseek( file, limit_offset, SEEK_SET );
+		fwrite( &limit, sizeof(limit), 1, file );
+		fclose(file);
+	}
+}
+
+// Raise the limit of a raw render made with --orbits, carrying on only the
+// pixels that reached its old limit, from where their orbits were left, instead
+// of rendering again from scratch. The pixels are shared evenly between the
+// ranks by count rather than by row, since they are all that is left to do.
+// Their new counts are written into the raw file in place, and the orbits of the
+// pixels that reach the new limit replace the saved ones, so a render can be
+// refined again and again.
+void refine_raw( const struct settings * settings, const struct renderer * renderer, struct phase_timings * timings, int my_rank, int n_procs ){
+	const struct viewport * viewport = &renderer->viewport;
+	int x_resolution = settings->x_resolution;
+	int limit = settings->max_iterations;
+	char orbits_path[PATH_MAX], new_orbits_path[PATH_MAX], journal_path[PATH_MAX];
+	sidecar_path( orbits_path, settings->output_file, ORBITS_SUFFIX );
+	sidecar_path( new_orbits_path, settings->output_file, NEW_ORBITS_SUFFIX );
+	sidecar_path( journal_path, settings->output_file, JOURNAL_SUFFIX );
+
+	struct orbits_header header;
+	if( my_rank == ROOT_RANK ){
+		header = check_refinement( settings, orbits_path, journal_path );
+	}
+
+	// Each rank reads an even share of the orbits.
+	begin_phase( timings, PHASE_EXCHANGE );
+	TRACE_BEGIN( "MPI_Bcast" );
+	MPI_Bcast( &header, sizeof(header), MPI_BYTE, ROOT_RANK, MPI_COMM_WORLD );
+	TRACE_END();
+	int old_limit = header.limit;
+	long long first_orbit = header.num_orbits * my_rank / n_procs;
+	long long num_orbits = header.num_orbits * (my_rank + 1) / n_procs - first_orbit;
+	if( my_rank == ROOT_RANK && settings->verbose ){
+		printf("Carrying %lld pixels on from a limit of %d to %d.\n", header.num_orbits, old_limit, limit);
+	}
+	struct saved_orbit * orbits = (struct saved_orbit*)malloc(sizeof(struct saved_orbit)*(num_orbits + 1));
+	MPI_Datatype orbit_type;
+	MPI_Type_contiguous( sizeof(struct saved_orbit), MPI_BYTE, &orbit_type );
+	MPI_Type_commit( &orbit_type );
+	MPI_File file;
+	TRACE_BEGIN( "MPI_File_read_at_all" );
+	MPI_File_open( MPI_COMM_WORLD, orbits_path, MPI_MODE_RDONLY, MPI_INFO_NULL, &file );
+	read_at_all_large( file, sizeof(header) + sizeof(struct saved_orbit) * first_orbit, orbits, num_orbits, orbit_type );
+	MPI_File_close( &file );
+	TRACE_END();
+	MPI_Type_free( &orbit_type );
+	// Renders write their orbits in the order they computed them, but the counts
+	// have to be written in file order.
+	qsort( orbits, num_orbits, sizeof(struct saved_orbit), compare_saved_orbits );
+	end_phase( timings, PHASE_EXCHANGE );
+
+	begin_phase( timings, PHASE_COMPUTE );
+	int * counts = (int*)malloc(sizeof(int)*(num_orbits + 1));
+	for( long long orbit_i=0; orbit_i<num_orbits; orbit_i++ ){
+		struct saved_orbit * orbit = &orbits[orbit_i];
+		int x_i = orbit->pixel % x_resolution;
+		int y_i = orbit->pixel / x_resolution;
+		counts[orbit_i] = continue_escape_time_double( viewport_x( viewport, x_i ), viewport_y( viewport, y_i ), &orbit->z_re, &orbit->z_im, old_limit, limit );
+	}
+	end_phase( timings, PHASE_COMPUTE );
+
+	// Write each new count over the old one, merging the pixels that follow one
+	// another in the file.
+	begin_phase( timings, PHASE_WRITE );
+	struct raw_header raw_header;
+	init_raw_header( &raw_header, x_resolution, settings->y_resolution, limit );
+	struct extents extents;
+	init_extents( &extents );
+	for( long long orbit_i=0; orbit_i<num_orbits; orbit_i++ ){
+		long long pixel = orbits[orbit_i].pixel;
+		add_extent( &extents, raw_row_offset( &raw_header, pixel / x_resolution ) + sizeof(int) * (pixel % x_resolution), sizeof(int) );
+	}
+	MPI_Datatype extents_type;
+	commit_extents_type( &extents, &extents_type );
+	TRACE_BEGIN( "MPI_File_open" );
+	MPI_File_open( MPI_COMM_WORLD, settings->output_file, MPI_MODE_WRONLY, MPI_INFO_NULL, &file );
+	TRACE_END();
+	TRACE_BEGIN( "MPI_File_write_all" );
+	MPI_File_set_view( file, 0, MPI_BYTE, extents_type, "native", MPI_INFO_NULL );
+	write_all_large( file, counts, num_orbits, MPI_INT );
+	TRACE_END();
+	TRACE_BEGIN( "MPI_File_close" );
+	MPI_File_close( &file );
+	TRACE_END();
+	MPI_Type_free( &extents_type );
+
+	// Keep the orbits of the pixels that are still undecided.
+	long long num_undecided = 0;
+	for( long long orbit_i=0; orbit_i<num_orbits; orbit_i++ ){
+		if( counts[orbit_i] == limit ){
+			orbits[num_undecided] = orbits[orbit_i];
+			num_undecided++;
+		}
+	}
+	header.limit = limit;
+	if( write_orbits( new_orbits_path, &header, orbits, num_undecided, my_rank ) != 0 ){
+		fprintf(stderr, "Rank %d could not write %s.\n", my_rank, new_orbits_path);
+		MPI_Abort( MPI_COMM_WORLD, 1 );
+	}
+	// The new counts and orbits are all written before the limit is raised.
+	TRACE_BEGIN( "MPI_Barrier" );
+	MPI_Barrier( MPI_COMM_WORLD );
+	TRACE_END();
+	if( my_rank == ROOT_RANK ){
+		rename( new_orbits_path, orbits_path );
+		update_raw_limit( settings->output_file, offsetof( struct raw_header, limit ), limit );
+		if( access( journal_path, F_OK ) == 0 ){
+			update_raw_limit( journal_path, offsetof( struct journal_header, limit ), limit );
+		}
+		if( settings->verbose ){
+			printf("%lld pixels reached the new limit.\n", header.num_orbits);
+		}
+	}
+	end_phase( timings, PHASE_WRITE );
+
+	free_extents( &extents );
+	free(counts);
+	free(orbits);
+}
+
+// A row of output and the computed row its counts come from.
+struct output_row {
+	int y_i;
+	int source;
+};
+
+static int compare_output_rows( const void * a, const void * b ){
+	return ((const struct output_row *)a)->y_i - ((const struct output_row *)b)->y_i;
+}
+
+// Render the viewport computing each pair of rows mirrored in the real axis
+// once. Only the rows that need computing are dealt out, round robin, and each
+// rank also writes the reflections of its rows. Every row's length is shared so
+// the ranks can place their scattered rows with one collective write through a
+// file view.
+void render_symmetric( const struct settings * settings, struct renderer * renderer, struct tile_cache * cache, struct phase_timings * timings, int my_rank, int n_procs ){
+	const struct viewport * viewport = &renderer->viewport;
+	int x_resolution = settings->x_resolution;
+	int y_resolution = settings->y_resolution;
+	clock_t set_calc_begin, set_calc_end;
+
+	int num_unique = 0;
+	int * unique_rows = (int*)malloc(sizeof(int)*y_resolution);
+	for( int y_i=0; y_i<y_resolution; y_i++ ){
+		if( is_unique_row( renderer, y_i ) ){
+			unique_rows[num_unique] = y_i;
+			num_unique++;
+		}
+	}
+	if( my_rank == ROOT_RANK && settings->verbose ){
+		printf("Computing %d of %d rows, the rest are reflections.\n", num_unique, y_resolution);
+	}
+
+	if( settings->verbose ){
+		set_calc_begin = clock();
+	}
+
+	// Compute this rank's rows, and list them and their reflections in the
+	// order they appear in the file.
+	int my_num_unique = 0;
+	for( int unique_i=my_rank; unique_i<num_unique; unique_i+=n_procs ){
+		my_num_unique++;
+	}
+	int * computed = (int*)malloc(sizeof(int)*my_num_unique*x_resolution);
+	struct output_row * my_rows = (struct output_row*)malloc(sizeof(struct output_row)*2*my_num_unique);
+	int my_num_rows = 0;
+	for( int source=0; source<my_num_unique; source++ ){
+		int y_i = unique_rows[my_rank + source * n_procs];
+		begin_phase( timings, PHASE_COMPUTE );
+		compute_row( renderer, cache, y_i, computed + (long long)source * x_resolution );
+		end_phase( timings, PHASE_COMPUTE );
+		my_rows[my_num_rows].y_i = y_i;
+		my_rows[my_num_rows].source = source;
+		my_num_rows++;
+		int mirror_y_i = mirror_row( renderer, y_i );
+		if( mirror_y_i > y_i ){
+			my_rows[my_num_rows].y_i = mirror_y_i;
+			my_rows[my_num_rows].source = source;
+			my_num_rows++;
+		}
+	}
+	qsort( my_rows, my_num_rows, sizeof(struct output_row), compare_output_rows );
+
+	struct csv_formatter formatter;
+	init_csv_formatter( &formatter, viewport, settings->max_iterations );
+	long long row_size = csv_row_max_size( &formatter );
+	char * result_buffer = (char*)malloc(sizeof(char)*my_num_rows*row_size);
+	long long result_size = 0;
+	long long * row_offsets = (long long*)calloc(y_resolution,sizeof(long long));
+	begin_phase( timings, PHASE_FORMAT );
+	for( int row_i=0; row_i<my_num_rows; row_i++ ){
+		csv_formatter_set_row( &formatter, viewport, my_rows[row_i].y_i );
+		const int * iterations = computed + (long long)my_rows[row_i].source * x_resolution;
+		long long length = format_csv_row( &formatter, iterations, result_buffer + result_size );
+		row_offsets[my_rows[row_i].y_i] = length;
+		result_size += length;
+	}
+	end_phase( timings, PHASE_FORMAT );
+
+	if( settings->verbose ){
+		set_calc_end = clock();
+		double seconds = (double)(set_calc_end - set_calc_begin) / CLOCKS_PER_SEC;
+		printf("Rank %d took %f seconds to calculate its share of the points.\n", my_rank, seconds);
+	}
+
+	// Each row's length is only non zero on the rank that formatted it, so
+	// summing gives every rank all of them. Turn the lengths into offsets.
+	begin_phase( timings, PHASE_EXCHANGE );
+	TRACE_BEGIN( "MPI_Allreduce" );
+	MPI_Allreduce( MPI_IN_PLACE, row_offsets, y_resolution, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD );
+	TRACE_END();
+	long long offset = strlen(CSV_HEADER);
+	for( int y_i=0; y_i<y_resolution; y_i++ ){
+		long long length = row_offsets[y_i];
+		row_offsets[y_i] = offset;
+		offset += length;
+	}
+	end_phase( timings, PHASE_EXCHANGE );
+
+	struct extents row_extents;
+	init_extents( &row_extents );
+	for( int row_i=0; row_i<my_num_rows; row_i++ ){
+		int y_i = my_rows[row_i].y_i;
+		long long next_offset = y_i + 1 < y_resolution ? row_offsets[y_i+1] : offset;
+		add_extent( &row_extents, row_offsets[y_i], next_offset - row_offsets[y_i] );
+	}
+	MPI_Datatype rows_type;
+	commit_extents_type( &row_extents, &rows_type );
+
+	// Only need to write the header once, so only have the root write the header.
+	begin_phase( timings, PHASE_WRITE );
+	if( my_rank == ROOT_RANK ){
+		FILE * file;
+		file = fopen(settings->output_file, "w+");
+		fprintf(file, CSV_HEADER);
+		fclose(file);
+	}
+
+	MPI_File file;
+	TRACE_BEGIN( "MPI_File_open" );
+	MPI_File_open( MPI_COMM_WORLD, settings->output_file, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &file );
+	TRACE_END();
+	TRACE_BEGIN( "MPI_File_write_all" );
+	MPI_File_set_view( file, 0, MPI_BYTE, rows_type, "native", MPI_INFO_NULL );
+	write_all_large( file, result_buffer, result_size, MPI_BYTE );
+	TRACE_END();
+	TRACE_BEGIN( "MPI_File_close" );
+	MPI_File_close(&file);
+	TRACE_END();
+	end_phase( timings, PHASE_WRITE );
+
+	MPI_Type_free( &rows_type );
+	free_extents( &row_extents );
+	free(row_offsets);
 	free(result_buffer);
-	free(char_buffer);
+	free_csv_formatter( &formatter );
+	free(my_rows);
+	free(computed);
+	free(unique_rows);
+}
+
+// Append a line describing this run and how long its phases took to the
+// timings file. The header is written first if the file is empty.
+void write_timings( const struct settings * settings, const struct phase_timings * timings, int my_rank, int n_procs ){
+	double min[NUM_PHASES + 1], mean[NUM_PHASES + 1], max[NUM_PHASES + 1];
+	reduce_phase_timings( timings, ROOT_RANK, MPI_COMM_WORLD, min, mean, max );
+	if( my_rank != ROOT_RANK ){
+		return;
+	}
+	FILE * file = fopen( settings->timings_file, "a" );
+	if( file == NULL ){
+		fprintf(stderr, "Could not write timings to %s.\n", settings->timings_file);
+		return;
+	}
+	if( ftell( file ) == 0 ){
+		fprintf(file, "ranks,limit,x_resolution,y_resolution,high_density_ratio,wall_min,wall_mean,wall_max");
+		for( int phase=0; phase<NUM_PHASES; phase++ ){
+			fprintf(file, ",%s_min,%s_mean,%s_max", phase_names[phase], phase_names[phase], phase_names[phase]);
+		}
+		fprintf(file, "\n");
+	}
+	fprintf(file, "%d,%d,%d,%d,%f,%f,%f,%f", n_procs, settings->max_iterations, settings->x_resolution, settings->y_resolution, settings->high_density_ratio, min[NUM_PHASES], mean[NUM_PHASES], max[NUM_PHASES]);
+	for( int phase=0; phase<NUM_PHASES; phase++ ){
+		fprintf(file, ",%f,%f,%f", min[phase], mean[phase], max[phase]);
+	}
+	fprintf(file, "\n");
+	fclose(file);
+}
+
+// Have root write out every rank's spans, if tracing.
+void finish_trace( const struct settings * settings ){
+	if( TRACE_FINISH( settings->trace_file, ROOT_RANK ) != 0 ){
+		fprintf(stderr, "Could not write the trace to %s.\n", settings->trace_file);
+	}
+}
+
+// Have root report every rank's counters, if counting.
+void finish_counters( const struct settings * settings ){
+	const char * path = settings->counters_file[0] != '\0' ? settings->counters_file : NULL;
+	if( counters_finish( path, ROOT_RANK ) != 0 ){
+		fprintf(stderr, "Could not write the counters to %s.\n", path);
+	}
+}
+
+int main(int argc, char **argv){
+
+	int verbose, max_iterations, x_resolution, y_resolution;
+	struct settings settings;
+
+	int my_rank, n_procs;
+
+	MPI_Init(&argc,&argv);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_size(MPI_COMM_WORLD,&n_procs);
+
+	// Have the root process parse the command line arguments so any output will
+	// only be printed once.
+	if(my_rank == ROOT_RANK) {
+		struct arguments arguments;
+		arguments.verbose = 0;
+		arguments.high_density_ratio = 0.0;
+		arguments.output_file = NULL;
+		arguments.center_x = DEFAULT_CENTER_X;
+		arguments.center_y = DEFAULT_CENTER_Y;
+		arguments.scale = DEFAULT_SCALE;
+		arguments.precision = PRECISION_AUTO;
+		arguments.cache_directory = NULL;
+		arguments.cache_megabytes = DEFAULT_CACHE_MEGABYTES;
+		arguments.keyframes_file = NULL;
+		arguments.num_frames = 0;
+		arguments.memory_cap = 0;
+		arguments.format = FORMAT_CSV;
+		arguments.symmetry = 0;
+		arguments.timings_file = NULL;
+		arguments.trace_file = NULL;
+		arguments.counters = 0;
+		arguments.counters_file = NULL;
+		arguments.serve_path = NULL;
+		arguments.aggregate_group = -1;
+		arguments.resume = 0;
+		arguments.pyramid_file = NULL;
+		arguments.pooling = POOLING_MAX;
+		arguments.keep_orbits = 0;
+		arguments.refine = 0;
+		arguments.args[0] = "0";
+		arguments.args[1] = "0";
+		arguments.args[2] = "0";
+
+		argp_parse (&argp, argc, argv, 0, 0, &arguments);
+
+		if( arguments.keyframes_file != NULL ){
+			if( arguments.output_file == NULL ){
+				arguments.output_file = DEFAULT_FRAME_PATTERN;
+			}
+			if( !valid_frame_pattern( arguments.output_file ) ){
+				fprintf(stderr, "Output file name must contain one integer conversion, such as %%05d, for the frame number.\n");
+				MPI_Abort( MPI_COMM_WORLD, 1 );
+			}
+			if( strlen(arguments.keyframes_file) >= PATH_MAX ){
+				fprintf(stderr, "Keyframes file name is too long.\n");
+				MPI_Abort( MPI_COMM_WORLD, 1 );
+			}
+		} else if( arguments.output_file == NULL ){
+			if( arguments.format == FORMAT_RLE ){
+				arguments.output_file = "mandelbrot_set.rle";
+			} else if( arguments.format == FORMAT_RAW ){
+				arguments.output_file = "mandelbrot_set.raw";
+			} else {
+				arguments.output_file = "mandelbrot_set.csv";
+			}
+		}
+		if( arguments.format == FORMAT_RLE && (arguments.keyframes_file != NULL || arguments.memory_cap > 0) ){
+			fprintf(stderr, "The rle format can not be used with --keyframes or --memory.\n");
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+		if( arguments.format == FORMAT_RAW && (arguments.keyframes_file != NULL || arguments.memory_cap > 0) ){
+			fprintf(stderr, "The raw format can not be used with --keyframes or --memory.\n");
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+		if( arguments.resume && arguments.format != FORMAT_RAW ){
+			fprintf(stderr, "--resume can only be used with raw output.\n");
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+		if( (arguments.keep_orbits || arguments.refine) && (arguments.format != FORMAT_RAW || arguments.precision != PRECISION_DOUBLE || arguments.resume || arguments.cache_directory != NULL) ){
+			fprintf(stderr, "--orbits and --refine can only be used for raw output with -p double, without --resume or --cache.\n");
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+		if( arguments.symmetry && (arguments.format != FORMAT_CSV || arguments.keyframes_file != NULL || arguments.memory_cap > 0) ){
+			fprintf(stderr, "--symmetry can only be used for csv output without --keyframes or --memory.\n");
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+		if( arguments.timings_file != NULL && (arguments.keyframes_file != NULL || strlen(arguments.timings_file) >= PATH_MAX) ){
+			fprintf(stderr, "--timings can not be used with --keyframes, and its file name must be shorter than %d.\n", PATH_MAX);
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+		if( arguments.trace_file != NULL ){
+#ifndef TRACE
+			fprintf(stderr, "--trace needs a build with tracing compiled in, make TRACE=1.\n");
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+#endif
+			if( strlen(arguments.trace_file) >= PATH_MAX ){
+				fprintf(stderr, "Trace file name is too long.\n");
+				MPI_Abort( MPI_COMM_WORLD, 1 );
+			}
+		}
+		if( arguments.counters_file != NULL && strlen(arguments.counters_file) >= PATH_MAX ){
+			fprintf(stderr, "Counters file name is too long.\n");
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+
+		// Leaves room for the names of the journal and orbits of raw output, of
+		// which the refined orbits' is the longest.
+		if( strlen(arguments.output_file) + strlen(NEW_ORBITS_SUFFIX) >= PATH_MAX ){
+			fprintf(stderr, "Output file name is too long.\n");
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+		if( arguments.aggregate_group >= 0 && (arguments.format != FORMAT_CSV || arguments.keyframes_file != NULL || arguments.memory_cap > 0 || arguments.symmetry) ){
+			fprintf(stderr, "--aggregate can only be used for csv output without --keyframes, --memory or --symmetry.\n");
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+		if( arguments.pyramid_file != NULL && (arguments.format != FORMAT_CSV || arguments.keyframes_file != NULL || arguments.memory_cap > 0 || arguments.symmetry || strlen(arguments.pyramid_file) >= PATH_MAX) ){
+			fprintf(stderr, "--pyramid can only be used for csv output without --keyframes, --memory or --symmetry, and its file name must be shorter than %d.\n", PATH_MAX);
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+		if( arguments.serve_path != NULL && (arguments.keyframes_file != NULL || arguments.timings_file != NULL || strlen(arguments.serve_path) >= PATH_MAX) ){
+			fprintf(stderr, "--serve can not be used with --keyframes or --timings, and its socket path must be shorter than %d.\n", PATH_MAX);
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+
+		memset( &settings, 0, sizeof(settings) );
+		sscanf(arguments.args[0],"%d",&settings.max_iterations);
+		sscanf(arguments.args[1],"%d",&settings.x_resolution);
+		sscanf(arguments.args[2],"%d",&settings.y_resolution);
+		settings.verbose = arguments.verbose;
+		settings.precision = arguments.precision;
+		settings.high_density_ratio = arguments.high_density_ratio;
+		settings.scale = arguments.scale;
+		strcpy( settings.center_x, arguments.center_x );
+		strcpy( settings.center_y, arguments.center_y );
+		if( arguments.keyframes_file == NULL ){
+			struct double_double center_x, center_y;
+			struct viewport viewport;
+			dd_parse( arguments.center_x, &center_x );
+			dd_parse( arguments.center_y, &center_y );
+			init_viewport( &viewport, center_x, center_y, settings.scale, settings.x_resolution, settings.y_resolution );
+			if( viewport_too_deep( &viewport ) ){
+				fprintf(stderr, "The pixels are too close together for this center to tell them apart; use a larger scale or fewer pixels.\n");
+				MPI_Abort( MPI_COMM_WORLD, 1 );
+			}
+		}
+		strcpy( settings.output_file, arguments.output_file );
+		if( arguments.cache_directory != NULL ){
+			if( strlen(arguments.cache_directory) >= PATH_MAX ){
+				fprintf(stderr, "Cache directory name is too long.\n");
+				MPI_Abort( MPI_COMM_WORLD, 1 );
+			}
+			strcpy( settings.cache_directory, arguments.cache_directory );
+		}
+		settings.cache_bytes = arguments.cache_megabytes * 1024 * 1024;
+		if( arguments.keyframes_file != NULL ){
+			strcpy( settings.keyframes_file, arguments.keyframes_file );
+		}
+		settings.num_frames = arguments.num_frames;
+		settings.memory_cap = arguments.memory_cap;
+		settings.format = arguments.format;
+		settings.symmetry = arguments.symmetry;
+		settings.aggregate_group = arguments.aggregate_group;
+		settings.resume = arguments.resume;
+		settings.pooling = arguments.pooling;
+		settings.keep_orbits = arguments.keep_orbits;
+		settings.refine = arguments.refine;
+		if( arguments.pyramid_file != NULL ){
+			strcpy( settings.pyramid_file, arguments.pyramid_file );
+		}
+		if( arguments.timings_file != NULL ){
+			strcpy( settings.timings_file, arguments.timings_file );
+		}
+		if( arguments.trace_file != NULL ){
+			strcpy( settings.trace_file, arguments.trace_file );
+		}
+		settings.counters = arguments.counters;
+		if( arguments.counters_file != NULL ){
+			strcpy( settings.counters_file, arguments.counters_file );
+		}
+		if( arguments.serve_path != NULL ){
+			strcpy( settings.serve_path, arguments.serve_path );
+		}
+	}
+
+	// Broadcast the command line arguments processed by root.
+	MPI_Bcast( &settings, sizeof(settings), MPI_BYTE, ROOT_RANK, MPI_COMM_WORLD );
+
+	max_iterations = settings.max_iterations;
+	x_resolution = settings.x_resolution;
+	y_resolution = settings.y_resolution;
+	verbose = settings.verbose;
+
+	TRACE_INIT( settings.trace_file[0] != '\0', MPI_COMM_WORLD );
+	counters_init( settings.counters, MPI_COMM_WORLD );
+
+	if( settings.serve_path[0] != '\0' ){
+		int status = serve_tiles( settings.serve_path, ROOT_RANK, MPI_COMM_WORLD, verbose );
+		finish_trace( &settings );
+		finish_counters( &settings );
+		MPI_Finalize();
+		return status == 0 ? 0 : 1;
+	}
+
+	if( settings.keyframes_file[0] != '\0' ){
+		render_sequence( &settings, my_rank, n_procs );
+		finish_trace( &settings );
+		finish_counters( &settings );
+		MPI_Finalize();
+		return 0;
+	}
+
+	// Start every rank's wall clock together.
+	struct phase_timings timings;
+	MPI_Barrier( MPI_COMM_WORLD );
+	init_phase_timings( &timings );
+
+	struct double_double center_x, center_y;
+	dd_parse( settings.center_x, &center_x );
+	dd_parse( settings.center_y, &center_y );
+	struct viewport viewport;
+	init_viewport( &viewport, center_x, center_y, settings.scale, x_resolution, y_resolution );
+	int use_cache = settings.cache_directory[0] != '\0';
+	if( use_cache ){
+		// Tiles on the edges extend past the viewport.
+		viewport.margin = TILE_SIZE;
+	}
+
+	// Only root computes the reference orbit for perturbation, the other ranks
+	// receive a copy of it.
+	struct renderer renderer;
+	init_renderer( &renderer, &viewport, max_iterations, settings.precision, my_rank == ROOT_RANK );
+	if( renderer.precision == PRECISION_PERTURBATION ){
+		broadcast_reference_orbit( &renderer.orbit, my_rank );
+		if( my_rank == ROOT_RANK && verbose ){
+			printf("Using perturbation, skipping %d iterations with series approximation.\n", renderer.orbit.skip);
+		}
+	}
+
+	struct tile_cache cache;
+	if( use_cache ){
+		init_tile_cache( &cache, settings.cache_directory, &renderer );
+		fill_tile_cache( &cache, &timings, my_rank, n_procs, verbose );
+	}
+	clock_t begin, end;
+	if( my_rank == ROOT_RANK && verbose ){
+		begin = clock();
+	}
+
+	if( settings.refine ){
+		refine_raw( &settings, &renderer, &timings, my_rank, n_procs );
+	} else if( settings.format == FORMAT_RAW ){
+		render_raw( &settings, &renderer, use_cache ? &cache : NULL, &timings, my_rank, n_procs );
+	} else if( settings.format == FORMAT_RLE ){
+		render_rle( &settings, &renderer, use_cache ? &cache : NULL, &timings, my_rank, n_procs );
+	} else if( settings.symmetry ){
+		render_symmetric( &settings, &renderer, use_cache ? &cache : NULL, &timings, my_rank, n_procs );
+	} else if( settings.memory_cap > 0 ){
+		render_streaming( &settings, &renderer, use_cache ? &cache : NULL, &timings, my_rank, n_procs );
+	} else {
+		render_chunked( &settings, &renderer, use_cache ? &cache : NULL, &timings, my_rank, n_procs );
+	}
+	finish_phase_timings( &timings );
+	if( settings.timings_file[0] != '\0' ){
+		write_timings( &settings, &timings, my_rank, n_procs );
+	}
+
+	free_renderer( &renderer );
+	if( use_cache ){
+		free_tile_cache( &cache );
+		if( my_rank == ROOT_RANK ){
+			evict_tile_cache( settings.cache_directory, settings.cache_bytes );
+		}
+	}
 
 	if( my_rank == ROOT_RANK && verbose ){
 		end = clock();
 	  double seconds = (double)(end - begin) / CLOCKS_PER_SEC;
 		printf("Took %f seconds.\n", seconds);
 	}
+	finish_trace( &settings );
+	finish_counters( &settings );
 	MPI_Finalize();
 	return 0;
 }
@@ -0,0 +1,172 @@
+#include "CUnit/Basic.h"
+#include "CUnit/CUnit.h"
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Small enough that every test has to split its writes.
+#define MAX_IO_COUNT 5
+#include "large_io.c"
+
+#define ROOT_RANK 0
+#define TEST_FILE "temp_large_io.bin"
+
+// Read the whole test file on root, after every rank has finished writing it
+// and before any goes on to replace it.
+static long read_test_file( unsigned char * contents, long capacity ){
+	MPI_Barrier( MPI_COMM_WORLD );
+	FILE * file = fopen( TEST_FILE, "rb" );
+	long size = file != NULL ? fread( contents, 1, capacity, file ) : -1;
+	if( file != NULL ){
+		fclose(file);
+	}
+	MPI_Barrier( MPI_COMM_WORLD );
+	return size;
+}
+
+void test_extents_split(){
+	struct extents extents;
+	init_extents( &extents );
+	add_extent( &extents, 0, 3 );
+	add_extent( &extents, 3, 9 );
+	add_extent( &extents, 12, 0 );
+	add_extent( &extents, 20, 2 );
+	CU_ASSERT( extents.num_extents == 4 );
+	if( extents.num_extents == 4 ){
+		CU_ASSERT( extents.offsets[0] == 0 && extents.lengths[0] == 5 );
+		CU_ASSERT( extents.offsets[1] == 5 && extents.lengths[1] == 5 );
+		CU_ASSERT( extents.offsets[2] == 10 && extents.lengths[2] == 2 );
+		CU_ASSERT( extents.offsets[3] == 20 && extents.lengths[3] == 2 );
+	}
+	free_extents( &extents );
+}
+
+void test_write_all_large(){
+	// Every rank writes bytes of its own rank to every n_procs-th run of 7 bytes,
+	// through a file view, so both the view and the count pass MAX_IO_COUNT.
+	int my_rank, n_procs;
+	MPI_Comm_rank( MPI_COMM_WORLD, &my_rank );
+	MPI_Comm_size( MPI_COMM_WORLD, &n_procs );
+	int run = 7, num_runs = 3;
+	struct extents extents;
+	init_extents( &extents );
+	for( int run_i=0; run_i<num_runs; run_i++ ){
+		add_extent( &extents, (long long)(run_i * n_procs + my_rank) * run, run );
+	}
+	MPI_Datatype type;
+	commit_extents_type( &extents, &type );
+	unsigned char * values = (unsigned char*)malloc(run * num_runs);
+	memset( values, 'a' + my_rank, run * num_runs );
+
+	MPI_File file;
+	MPI_File_delete( TEST_FILE, MPI_INFO_NULL );
+	MPI_File_open( MPI_COMM_WORLD, TEST_FILE, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &file );
+	MPI_File_set_view( file, 0, MPI_BYTE, type, "native", MPI_INFO_NULL );
+	CU_ASSERT( write_all_large( file, values, run * num_runs, MPI_BYTE ) == MPI_SUCCESS );
+	MPI_File_close( &file );
+
+	long size = run * num_runs * n_procs;
+	unsigned char * contents = (unsigned char*)malloc(size + 1);
+	if( my_rank == ROOT_RANK ){
+		CU_ASSERT( read_test_file( contents, size + 1 ) == size );
+		for( long byte_i=0; byte_i<size; byte_i++ ){
+			CU_ASSERT( contents[byte_i] == 'a' + (byte_i / run) % n_procs );
+		}
+	} else {
+		read_test_file( contents, 0 );
+	}
+	MPI_Type_free( &type );
+	free_extents( &extents );
+	free(values);
+	free(contents);
+}
+
+void test_write_at_large(){
+	// Every rank writes a run of ints of its own rank, one rank's after another.
+	int my_rank, n_procs;
+	MPI_Comm_rank( MPI_COMM_WORLD, &my_rank );
+	MPI_Comm_size( MPI_COMM_WORLD, &n_procs );
+	int count = 13;
+	int * values = (int*)malloc(sizeof(int)*count);
+	for( int value_i=0; value_i<count; value_i++ ){
+		values[value_i] = my_rank * count + value_i;
+	}
+
+	MPI_File file;
+	MPI_File_delete( TEST_FILE, MPI_INFO_NULL );
+	MPI_File_open( MPI_COMM_WORLD, TEST_FILE, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &file );
+	CU_ASSERT( write_at_large( file, sizeof(int) * my_rank * count, values, count, MPI_INT ) == MPI_SUCCESS );
+	MPI_File_close( &file );
+
+	long size = sizeof(int) * count * n_procs;
+	int * contents = (int*)malloc(size + sizeof(int));
+	if( my_rank == ROOT_RANK ){
+		CU_ASSERT( read_test_file( (unsigned char*)contents, size + sizeof(int) ) == size );
+		for( int value_i=0; value_i<count * n_procs; value_i++ ){
+			CU_ASSERT( contents[value_i] == value_i );
+		}
+	} else {
+		read_test_file( (unsigned char*)contents, 0 );
+	}
+	free(values);
+	free(contents);
+}
+
+void test_at_all_large(){
+	// Every rank writes pairs of ints, as one type, after the ranks before it,
+	// then reads back those of the next rank.
+	int my_rank, n_procs;
+	MPI_Comm_rank( MPI_COMM_WORLD, &my_rank );
+	MPI_Comm_size( MPI_COMM_WORLD, &n_procs );
+	MPI_Datatype pair_type;
+	MPI_Type_contiguous( 2, MPI_INT, &pair_type );
+	MPI_Type_commit( &pair_type );
+	int count = 11;
+	int * values = (int*)malloc(sizeof(int)*2*count);
+	for( int value_i=0; value_i<2*count; value_i++ ){
+		values[value_i] = my_rank * 2 * count + value_i;
+	}
+
+	MPI_File file;
+	MPI_File_delete( TEST_FILE, MPI_INFO_NULL );
+	MPI_File_open( MPI_COMM_WORLD, TEST_FILE, MPI_MODE_RDWR | MPI_MODE_CREATE, MPI_INFO_NULL, &file );
+	CU_ASSERT( write_at_all_large( file, sizeof(int) * 2 * count * my_rank, values, count, pair_type ) == MPI_SUCCESS );
+	MPI_File_sync( file );
+	MPI_Barrier( MPI_COMM_WORLD );
+	MPI_File_sync( file );
+	int next_rank = (my_rank + 1) % n_procs;
+	CU_ASSERT( read_at_all_large( file, sizeof(int) * 2 * count * next_rank, values, count, pair_type ) == MPI_SUCCESS );
+	MPI_File_close( &file );
+	for( int value_i=0; value_i<2*count; value_i++ ){
+		CU_ASSERT( values[value_i] == next_rank * 2 * count + value_i );
+	}
+	MPI_Type_free( &pair_type );
+	free(values);
+}
+
+int main(int argc, char **argv){
+	MPI_Init(&argc,&argv);
+	int my_rank;
+	MPI_Comm_rank( MPI_COMM_WORLD, &my_rank );
+	// Report the results once.
+	if( my_rank != ROOT_RANK ){
+		freopen( "/dev/null", "w", stdout );
+	}
+
+	CU_initialize_registry();
+	CU_pSuite suite = CU_add_suite("AddTestSuite", 0, 0);
+	CU_add_test(suite, "test that extents are merged and split at MAX_IO_COUNT", test_extents_split);
+	CU_add_test(suite, "test that write_all_large() writes counts past MAX_IO_COUNT", test_write_all_large);
+	CU_add_test(suite, "test that write_at_large() writes counts past MAX_IO_COUNT in pieces", test_write_at_large);
+	CU_add_test(suite, "test that write_at_all_large() and read_at_all_large() take counts past MAX_IO_COUNT", test_at_all_large);
+	CU_basic_run_tests();
+	CU_cleanup_registry();
+
+	if( my_rank == ROOT_RANK ){
+		remove( TEST_FILE );
+	}
+	MPI_Finalize();
+	return 0;
+}
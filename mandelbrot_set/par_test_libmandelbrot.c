@@ -0,0 +1,68 @@
+#include "CUnit/Basic.h"
+#include "CUnit/CUnit.h"
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmandelbrot_mpi.h"
+
+#define ROOT_RANK 0
+
+// Every rank runs the tests, since each render needs all of them, but only
+// root's buffer is filled in, so only root's checks mean anything.
+void compare_mpi_to_serial( const struct mandelbrot_region * region, int first_row, int num_rows, int root ){
+	int my_rank;
+	MPI_Comm_rank( MPI_COMM_WORLD, &my_rank );
+	long long num_pixels = (long long)num_rows * region->x_resolution;
+	int * gathered = (int*)malloc(sizeof(int)*(num_pixels + 1));
+	CU_ASSERT( mandelbrot_render_mpi( region, first_row, num_rows, my_rank == root ? gathered : NULL, root, MPI_COMM_WORLD ) == 0 );
+	if( my_rank == root ){
+		int * serial = (int*)malloc(sizeof(int)*(num_pixels + 1));
+		mandelbrot_render( region, first_row, num_rows, serial );
+		CU_ASSERT( memcmp( serial, gathered, sizeof(int)*num_pixels ) == 0 );
+		free(serial);
+	}
+	free(gathered);
+}
+
+void test_mpi_matches_serial(){
+	struct mandelbrot_region region;
+	mandelbrot_region_init( &region, "-0.5", "0.0", 3.0, 70, 50, 300 );
+	compare_mpi_to_serial( &region, 0, 50, ROOT_RANK );
+	compare_mpi_to_serial( &region, 11, 17, ROOT_RANK );
+	// Fewer rows than ranks, and a different root.
+	compare_mpi_to_serial( &region, 49, 1, 1 );
+	compare_mpi_to_serial( &region, 0, 2, 1 );
+	// Deep enough for perturbation.
+	mandelbrot_region_init( &region, "-1.75", "0.0", 1e-14, 40, 40, 500 );
+	region.precision = PRECISION_AUTO;
+	compare_mpi_to_serial( &region, 0, 40, ROOT_RANK );
+}
+
+void test_mpi_invalid_rows(){
+	struct mandelbrot_region region;
+	mandelbrot_region_init( &region, "-0.5", "0.0", 3.0, 10, 10, 100 );
+	CU_ASSERT( mandelbrot_render_mpi( &region, 5, 6, NULL, ROOT_RANK, MPI_COMM_WORLD ) != 0 );
+}
+
+int main(int argc, char **argv){
+	MPI_Init(&argc,&argv);
+	int my_rank;
+	MPI_Comm_rank( MPI_COMM_WORLD, &my_rank );
+	// Report the results once.
+	if( my_rank != ROOT_RANK ){
+		freopen( "/dev/null", "w", stdout );
+	}
+
+	CU_initialize_registry();
+	CU_pSuite suite = CU_add_suite("AddTestSuite", 0, 0);
+	CU_add_test(suite, "test that mandelbrot_render_mpi() matches mandelbrot_render()", test_mpi_matches_serial);
+	CU_add_test(suite, "test that mandelbrot_render_mpi() refuses rows outside the region", test_mpi_invalid_rows);
+	CU_basic_run_tests();
+	CU_cleanup_registry();
+
+	MPI_Finalize();
+	return 0;
+}
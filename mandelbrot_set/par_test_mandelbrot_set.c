@@ -3,6 +3,16 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "libmandelbrot.h"
+// The library keeps its own double-double arithmetic to itself.
+#include "double_double.c"
+#include "tile_client.c"
+#include "raw_format.c"
+#include "pyramid_format.c"
 
 #define BUFSIZE 128
 
@@ -78,6 +88,99 @@ void compare_num_processes( char * seq_file_name, int np ){
 	system("rm temp_par_mandelbrot_set.csv");
 }
 
+void compare_seq_to_par_with_options( char * options ){
+	char buffer[4*BUFSIZE];
+	snprintf(
+		buffer,
+		sizeof(buffer),
+		"./seq_mandelbrot_set 200 50 50 %s -o temp_seq_mandelbrot_set.csv",
+		options
+	);
+	system( buffer );
+	snprintf(
+		buffer,
+		sizeof(buffer),
+		"mpirun -np 4 ./par_mandelbrot_set 200 50 50 %s -o temp_par_mandelbrot_set.csv",
+		options
+	);
+	system( buffer );
+
+	FILE *fp;
+
+	fp = popen("diff temp_seq_mandelbrot_set.csv temp_par_mandelbrot_set.csv", "r");
+	CU_ASSERT(fp != NULL);
+	// diff will print nothing and cause fgets to return NULL if the files are the
+	// same.
+	CU_ASSERT( fgets(buffer, BUFSIZE, fp) == NULL );
+	pclose(fp);
+
+	system("rm temp_seq_mandelbrot_set.csv");
+	system("rm temp_par_mandelbrot_set.csv");
+}
+
+void test_viewport_against_seq(){
+	compare_seq_to_par_with_options( "-x -0.75 -y 0.1 -s 0.5" );
+	compare_seq_to_par_with_options( "-x -0.75 -y 0.1 -s 0.5 -p perturbation" );
+	compare_seq_to_par_with_options( "-x -0.743643887037158704752191506114774 -y 0.131825904205311970493132056385139 -s 1e-20" );
+}
+
+void test_tile_cache_against_seq(){
+	system("rm -rf temp_tile_cache");
+	// The first run fills the cache, the second is served from it.
+	compare_seq_to_par_with_options( "-x -0.75 -y 0.1 -s 0.5 -c temp_tile_cache" );
+	compare_seq_to_par_with_options( "-x -0.75 -y 0.1 -s 0.5 -c temp_tile_cache" );
+	// Panned views reuse part of the cache.
+	compare_seq_to_par_with_options( "-x -0.7 -y 0.1 -s 0.5 -c temp_tile_cache" );
+	system("rm -rf temp_tile_cache");
+}
+
+void compare_frame_to_seq( int frame_i, char * options ){
+	char buffer[4*BUFSIZE];
+	snprintf(
+		buffer,
+		sizeof(buffer),
+		"./seq_mandelbrot_set 200 50 50 %s -o temp_seq_mandelbrot_set.csv",
+		options
+	);
+	system( buffer );
+
+	FILE *fp;
+	snprintf( buffer, sizeof(buffer), "diff temp_seq_mandelbrot_set.csv temp_frame_%d.csv", frame_i );
+	fp = popen(buffer, "r");
+	CU_ASSERT(fp != NULL);
+	// diff will print nothing and cause fgets to return NULL if the files are the
+	// same.
+	CU_ASSERT( fgets(buffer, BUFSIZE, fp) == NULL );
+	pclose(fp);
+
+	system("rm temp_seq_mandelbrot_set.csv");
+}
+
+void test_animation_against_seq(){
+	FILE * keyframes = fopen("temp_keyframes.txt", "w");
+	fprintf(keyframes, "-0.75 0.1 2.0\n");
+	fprintf(keyframes, "-0.75 0.1 0.5\n");
+	fclose(keyframes);
+
+	// Frame 1 reuses pixels of frame 0, frame 2 those of frame 1, whenever they
+	// are rendered by the same rank.
+	for( int np=1; np<=3; np++ ){
+		char buffer[BUFSIZE];
+		snprintf(
+			buffer,
+			sizeof(buffer),
+			"mpirun -np %d ./par_mandelbrot_set 200 50 50 -k temp_keyframes.txt -n 3 -o temp_frame_%%d.csv",
+			np
+		);
+		system( buffer );
+		compare_frame_to_seq( 0, "-x -0.75 -y 0.1 -s 2.0" );
+		compare_frame_to_seq( 1, "-x -0.75 -y 0.1 -s 1.0" );
+		compare_frame_to_seq( 2, "-x -0.75 -y 0.1 -s 0.5" );
+		system("rm temp_frame_*.csv");
+	}
+	system("rm temp_keyframes.txt");
+}
+
 void test_num_processes_does_not_change(){
 	system("./seq_mandelbrot_set 100 100 100 -o temp_seq_mandelbrot_set.csv");
 	compare_num_processes("temp_seq_mandelbrot_set.csv", 3);
@@ -117,12 +220,529 @@ void test_high_density_ratio_does_not_change(){
 	system("rm temp_seq_mandelbrot_set.csv");
 }
 
+void compare_streaming( char * seq_file_name, int np, char * memory ){
+	char buffer[BUFSIZE];
+	snprintf(
+		buffer,
+		sizeof(buffer),
+		"mpirun -np %d ./par_mandelbrot_set 100 100 100 -o temp_par_mandelbrot_set.csv -m %s",
+		np,
+		memory
+	);
+	system( buffer );
+
+	FILE *fp;
+	snprintf( buffer, sizeof(buffer), "diff %s temp_par_mandelbrot_set.csv", seq_file_name );
+	fp = popen(buffer, "r");
+	CU_ASSERT(fp != NULL);
+	// diff will print nothing and cause fgets to return NULL if the files are the
+	// same.
+	CU_ASSERT( (fgets(buffer, BUFSIZE, fp) == NULL) );
+	pclose(fp);
+
+	system("rm temp_par_mandelbrot_set.csv");
+}
+
+void compare_aggregated( char * seq_file_name, int np, char * options ){
+	char buffer[BUFSIZE];
+	snprintf(
+		buffer,
+		sizeof(buffer),
+		"mpirun -np %d ./par_mandelbrot_set 100 100 100 -o temp_par_mandelbrot_set.csv %s",
+		np,
+		options
+	);
+	system( buffer );
+
+	FILE *fp;
+	snprintf( buffer, sizeof(buffer), "diff %s temp_par_mandelbrot_set.csv", seq_file_name );
+	fp = popen(buffer, "r");
+	CU_ASSERT(fp != NULL);
+	// diff will print nothing and cause fgets to return NULL if the files are the
+	// same.
+	CU_ASSERT( (fgets(buffer, BUFSIZE, fp) == NULL) );
+	pclose(fp);
+
+	system("rm temp_par_mandelbrot_set.csv");
+}
+
+void test_streaming_does_not_change(){
+	system("./seq_mandelbrot_set 100 100 100 -o temp_seq_mandelbrot_set.csv");
+	// From one row per rank per band up to the whole image in one band.
+	compare_streaming("temp_seq_mandelbrot_set.csv", 1, "1");
+	compare_streaming("temp_seq_mandelbrot_set.csv", 3, "1");
+	compare_streaming("temp_seq_mandelbrot_set.csv", 3, "64K");
+	compare_streaming("temp_seq_mandelbrot_set.csv", 4, "1G");
+	system("rm temp_seq_mandelbrot_set.csv");
+}
+
+void test_aggregate_does_not_change(){
+	system("./seq_mandelbrot_set 100 100 100 -o temp_seq_mandelbrot_set.csv");
+	// One writer for the node, and writers for groups of ranks within it.
+	compare_aggregated("temp_seq_mandelbrot_set.csv", 4, "-a");
+	compare_aggregated("temp_seq_mandelbrot_set.csv", 4, "-a2");
+	compare_aggregated("temp_seq_mandelbrot_set.csv", 3, "-a2");
+	compare_aggregated("temp_seq_mandelbrot_set.csv", 1, "-a");
+	system("rm temp_seq_mandelbrot_set.csv");
+}
+
+void test_symmetry_against_seq(){
+	// Copied rows hold the counts of their reflection, which can differ from
+	// their own by rounding, so compare against seq_main.c copying the same rows.
+	compare_seq_to_par_with_options( "-r" );
+	compare_seq_to_par_with_options( "-x -0.75 -y 0.1 -s 0.5 -r" );
+	compare_seq_to_par_with_options( "-x -0.75 -y 0.15 -s 0.6 -r" );
+	compare_seq_to_par_with_options( "-x -1.75 -y 0 -s 1e-14 -r" );
+}
+
+void test_rle_against_seq(){
+	system("./seq_mandelbrot_set 200 50 50 -x -0.75 -y 0.1 -s 0.5 -o temp_seq_mandelbrot_set.csv");
+	FILE *fp;
+	char buffer[BUFSIZE];
+	for( int np=1; np<=4; np+=3 ){
+		snprintf(
+			buffer,
+			sizeof(buffer),
+			"mpirun -np %d ./par_mandelbrot_set 200 50 50 -x -0.75 -y 0.1 -s 0.5 -f rle -o temp_par_mandelbrot_set.rle",
+			np
+		);
+		system( buffer );
+		system("./decompress_mandelbrot_set temp_par_mandelbrot_set.rle -o temp_par_mandelbrot_set.csv");
+
+		fp = popen("diff temp_seq_mandelbrot_set.csv temp_par_mandelbrot_set.csv", "r");
+		CU_ASSERT(fp != NULL);
+		// diff will print nothing and cause fgets to return NULL if the files are the
+		// same.
+		CU_ASSERT( fgets(buffer, BUFSIZE, fp) == NULL );
+		pclose(fp);
+	}
+
+	// Rows 20 to 37 start partway through a chunk and end partway through
+	// another. Each row is 50 lines, after the header.
+	system("./decompress_mandelbrot_set temp_par_mandelbrot_set.rle -r 20:37 -o temp_par_mandelbrot_set.csv");
+	fp = popen("sed -n '1p;1002,1901p' temp_seq_mandelbrot_set.csv | diff - temp_par_mandelbrot_set.csv", "r");
+	CU_ASSERT(fp != NULL);
+	CU_ASSERT( fgets(buffer, BUFSIZE, fp) == NULL );
+	pclose(fp);
+
+	system("rm temp_seq_mandelbrot_set.csv");
+	system("rm temp_par_mandelbrot_set.csv");
+	system("rm temp_par_mandelbrot_set.rle");
+}
+
+void test_raw_resume_against_seq(){
+	system("./seq_mandelbrot_set 200 50 50 -x -0.75 -y 0.1 -s 0.5 -o temp_seq_mandelbrot_set.csv");
+	system("mpirun -np 2 ./par_mandelbrot_set 200 50 50 -x -0.75 -y 0.1 -s 0.5 -f raw -o temp_par_mandelbrot_set.raw");
+
+	// Pretend the render died before rows 10 to 29 and row 45 were written,
+	// scribbling over them, then resume it with a different number of ranks.
+	FILE *fp = fopen("temp_par_mandelbrot_set.raw", "r+b");
+	FILE *journal = fopen("temp_par_mandelbrot_set.raw.journal", "r+b");
+	CU_ASSERT(fp != NULL);
+	CU_ASSERT(journal != NULL);
+	if( fp != NULL && journal != NULL ){
+		struct raw_header header;
+		init_raw_header( &header, 50, 50, 200 );
+		int junk[50];
+		memset( junk, 0xff, sizeof(junk) );
+		char missing = 0;
+		for( int y_i=10; y_i<=45; y_i++ ){
+			if( y_i >= 30 && y_i != 45 ){
+				continue;
+			}
+			fseek( fp, raw_row_offset( &header, y_i ), SEEK_SET );
+			fwrite( junk, sizeof(int), 50, fp );
+			fseek( journal, sizeof(struct journal_header) + y_i, SEEK_SET );
+			fwrite( &missing, sizeof(char), 1, journal );
+		}
+		fclose(fp);
+		fclose(journal);
+	}
+	system("mpirun -np 3 ./par_mandelbrot_set 200 50 50 -x -0.75 -y 0.1 -s 0.5 -f raw -o temp_par_mandelbrot_set.raw --resume");
+	system("./decompress_mandelbrot_set temp_par_mandelbrot_set.raw -o temp_par_mandelbrot_set.csv");
+
+	char buffer[BUFSIZE];
+	fp = popen("diff temp_seq_mandelbrot_set.csv temp_par_mandelbrot_set.csv", "r");
+	CU_ASSERT(fp != NULL);
+	CU_ASSERT( fgets(buffer, BUFSIZE, fp) == NULL );
+	pclose(fp);
+
+	// Every row is journaled once the render is done.
+	journal = fopen("temp_par_mandelbrot_set.raw.journal", "rb");
+	CU_ASSERT(journal != NULL);
+	if( journal != NULL ){
+		struct journal_header header;
+		char done[51];
+		CU_ASSERT( fread( &header, sizeof(header), 1, journal ) == 1 );
+		CU_ASSERT( fread( done, sizeof(char), 51, journal ) == 50 );
+		for( int y_i=0; y_i<50; y_i++ ){
+			CU_ASSERT( done[y_i] != 0 );
+		}
+		fclose(journal);
+	}
+
+	system("rm temp_seq_mandelbrot_set.csv");
+	system("rm temp_par_mandelbrot_set.csv");
+	system("rm temp_par_mandelbrot_set.raw");
+	system("rm temp_par_mandelbrot_set.raw.journal");
+}
+
+// Check every pixel of every level of a pyramid against pooling the counts
+// seq_main.c wrote to temp_seq_mandelbrot_set.csv.
+void check_pyramid( const char * path, const int * counts, int x_resolution, int y_resolution, int pooling ){
+	struct pyramid_file pyramid;
+	CU_ASSERT( 0 == open_pyramid_file( path, &pyramid ) );
+	if( pyramid.file == NULL ){
+		return;
+	}
+	const struct pyramid_header * header = &pyramid.header;
+	CU_ASSERT( header->x_resolution == x_resolution );
+	CU_ASSERT( header->y_resolution == y_resolution );
+	CU_ASSERT( header->pooling == pooling );
+	CU_ASSERT( header->num_levels == 3 );
+	float * tile = (float*)malloc(sizeof(float)*header->tile_size*header->tile_size);
+	int num_wrong = 0;
+	for( int level=0; level<header->num_levels; level++ ){
+		for( int tile_y=0; tile_y<pyramid_tiles_y( header, level ); tile_y++ ){
+			for( int tile_x=0; tile_x<pyramid_tiles_x( header, level ); tile_x++ ){
+				CU_ASSERT( 0 == read_pyramid_tile( &pyramid, level, tile_x, tile_y, tile ) );
+				int width = pyramid_tile_width( header, level, tile_x );
+				for( int pixel_i=0; pixel_i<width*pyramid_tile_height( header, level, tile_y ); pixel_i++ ){
+					int x_i = tile_x * header->tile_size + pixel_i % width;
+					int y_i = tile_y * header->tile_size + pixel_i / width;
+					double pooled = 0.0;
+					for( int below_y=y_i<<level; below_y<((y_i+1)<<level) && below_y<y_resolution; below_y++ ){
+						for( int below_x=x_i<<level; below_x<((x_i+1)<<level) && below_x<x_resolution; below_x++ ){
+							double count = counts[below_y*x_resolution + below_x];
+							if( pooling == POOLING_MEAN ){
+								pooled += count;
+							} else if( count > pooled ){
+								pooled = count;
+							}
+						}
+					}
+					if( pooling == POOLING_MEAN ){
+						pooled /= pyramid_pool_size( header, level, x_i, y_i );
+					}
+					if( tile[pixel_i] != (float)pooled ){
+						num_wrong++;
+					}
+				}
+			}
+		}
+	}
+	CU_ASSERT( 0 == num_wrong );
+	free(tile);
+	close_pyramid_file( &pyramid );
+}
+
+void test_pyramid_against_seq(){
+	// Large enough for three levels, with rows and columns left over at the edges.
+	int x_resolution = 601, y_resolution = 300;
+	system("./seq_mandelbrot_set 100 601 300 -x -0.75 -y 0.1 -s 1.5 -o temp_seq_mandelbrot_set.csv");
+	int * counts = (int*)malloc(sizeof(int)*x_resolution*y_resolution);
+	FILE *fp = fopen("temp_seq_mandelbrot_set.csv", "r");
+	CU_ASSERT(fp != NULL);
+	if( fp == NULL ){
+		free(counts);
+		return;
+	}
+	fscanf(fp, "x,y,z\n");
+	for( int pixel_i=0; pixel_i<x_resolution*y_resolution; pixel_i++ ){
+		if( fscanf(fp, "%*[^,],%*[^,],%d\n", &counts[pixel_i]) != 1 ){
+			counts[pixel_i] = -1;
+		}
+	}
+	fclose(fp);
+
+	// The bands of the ranks split the pools differently for each number of ranks.
+	char buffer[BUFSIZE];
+	for( int np=1; np<=4; np+=3 ){
+		snprintf(
+			buffer,
+			sizeof(buffer),
+			"mpirun -np %d ./par_mandelbrot_set 100 601 300 -x -0.75 -y 0.1 -s 1.5 -o temp_par_mandelbrot_set.csv -P temp_pyramid.bin",
+			np
+		);
+		system( buffer );
+		check_pyramid( "temp_pyramid.bin", counts, x_resolution, y_resolution, POOLING_MAX );
+	}
+	system("mpirun -np 3 ./par_mandelbrot_set 100 601 300 -x -0.75 -y 0.1 -s 1.5 -o temp_par_mandelbrot_set.csv -P temp_pyramid.bin -l mean");
+	check_pyramid( "temp_pyramid.bin", counts, x_resolution, y_resolution, POOLING_MEAN );
+
+	free(counts);
+	system("rm temp_seq_mandelbrot_set.csv");
+	system("rm temp_par_mandelbrot_set.csv");
+	system("rm temp_pyramid.bin");
+}
+
+void test_refine_against_seq(){
+	FILE *fp;
+	char buffer[BUFSIZE];
+	system("mpirun -np 2 ./par_mandelbrot_set 100 50 50 -x -0.75 -y 0.1 -s 0.5 -p double -f raw -z -o temp_par_mandelbrot_set.raw");
+	// Raise the limit twice, on other numbers of ranks, checking against
+	// rendering from scratch each time.
+	int limits[2] = { 400, 2000 };
+	for( int limit_i=0; limit_i<2; limit_i++ ){
+		snprintf(
+			buffer,
+			sizeof(buffer),
+			"mpirun -np %d ./par_mandelbrot_set %d 50 50 -x -0.75 -y 0.1 -s 0.5 -p double -f raw -e -o temp_par_mandelbrot_set.raw",
+			3 + limit_i,
+			limits[limit_i]
+		);
+		system( buffer );
+		snprintf(
+			buffer,
+			sizeof(buffer),
+			"./seq_mandelbrot_set %d 50 50 -x -0.75 -y 0.1 -s 0.5 -p double -o temp_seq_mandelbrot_set.csv",
+			limits[limit_i]
+		);
+		system( buffer );
+		system("./decompress_mandelbrot_set temp_par_mandelbrot_set.raw -o temp_par_mandelbrot_set.csv");
+
+		fp = popen("diff temp_seq_mandelbrot_set.csv temp_par_mandelbrot_set.csv", "r");
+		CU_ASSERT(fp != NULL);
+		CU_ASSERT( fgets(buffer, BUFSIZE, fp) == NULL );
+		pclose(fp);
+	}
+
+	// Only the pixels still at the limit are kept for the next refinement.
+	fp = fopen("temp_par_mandelbrot_set.raw.orbits", "rb");
+	CU_ASSERT(fp != NULL);
+	if( fp != NULL ){
+		struct orbits_header header;
+		CU_ASSERT( fread( &header, sizeof(header), 1, fp ) == 1 );
+		CU_ASSERT( header.limit == 2000 );
+		CU_ASSERT( header.num_orbits > 0 && header.num_orbits < 50 * 50 );
+		fclose(fp);
+	}
+
+	system("rm temp_seq_mandelbrot_set.csv");
+	system("rm temp_par_mandelbrot_set.csv");
+	system("rm temp_par_mandelbrot_set.raw");
+	system("rm temp_par_mandelbrot_set.raw.journal");
+	system("rm temp_par_mandelbrot_set.raw.orbits");
+}
+
+void test_timings_are_appended(){
+	system("rm -f temp_timings.csv");
+	system("mpirun -np 3 ./par_mandelbrot_set 100 100 100 -o temp_par_mandelbrot_set.csv -t temp_timings.csv");
+	system("mpirun -np 2 ./par_mandelbrot_set 100 100 100 -o temp_par_mandelbrot_set.csv -t temp_timings.csv");
+
+	// One header and a line per run, each starting with its number of ranks.
+	FILE *fp = fopen("temp_timings.csv", "r");
+	CU_ASSERT(fp != NULL);
+	if( fp != NULL ){
+		char buffer[BUFSIZE * 4];
+		CU_ASSERT( fgets(buffer, sizeof(buffer), fp) != NULL && strncmp(buffer, "ranks,limit,", 12) == 0 );
+		CU_ASSERT( fgets(buffer, sizeof(buffer), fp) != NULL && strncmp(buffer, "3,100,100,100,", 14) == 0 );
+		CU_ASSERT( fgets(buffer, sizeof(buffer), fp) != NULL && strncmp(buffer, "2,100,100,100,", 14) == 0 );
+		CU_ASSERT( fgets(buffer, sizeof(buffer), fp) == NULL );
+		fclose(fp);
+	}
+
+	system("rm temp_timings.csv");
+	system("rm temp_par_mandelbrot_set.csv");
+}
+
+void test_counters_have_every_phase(){
+	system("./seq_mandelbrot_set 100 100 100 -o temp_seq_mandelbrot_set.csv");
+	system("mpirun -np 3 ./par_mandelbrot_set 100 100 100 -o temp_par_mandelbrot_set.csv --counters=temp_counters.json");
+
+	// Counting must not change the output, even where the counters are unavailable.
+	char buffer[BUFSIZE];
+	FILE *fp = popen("diff temp_seq_mandelbrot_set.csv temp_par_mandelbrot_set.csv", "r");
+	CU_ASSERT(fp != NULL);
+	CU_ASSERT( fgets(buffer, BUFSIZE, fp) == NULL );
+	pclose(fp);
+
+	// Every rank should have counted every phase.
+	const char * phases[] = { "compute", "format", "exchange", "write" };
+	for( int phase_i=0; phase_i<4; phase_i++ ){
+		snprintf(
+			buffer,
+			sizeof(buffer),
+			"grep -c '\"name\":\"%s\",\"ranks\":3,' temp_counters.json",
+			phases[phase_i]
+		);
+		fp = popen(buffer, "r");
+		CU_ASSERT(fp != NULL);
+		CU_ASSERT( fgets(buffer, BUFSIZE, fp) != NULL && strcmp(buffer, "1\n") == 0 );
+		pclose(fp);
+	}
+
+	system("rm temp_counters.json");
+	system("rm temp_seq_mandelbrot_set.csv");
+	system("rm temp_par_mandelbrot_set.csv");
+}
+
+#ifdef TRACE
+void test_trace_has_every_phase(){
+	system("mpirun -np 3 ./par_mandelbrot_set 100 100 100 -o temp_par_mandelbrot_set.csv -T temp_trace.json");
+
+	// Every rank should have spent time in every phase and in the write itself.
+	const char * spans[] = { "compute", "format", "exchange", "write", "MPI_File_write_all" };
+	char buffer[BUFSIZE];
+	for( int span_i=0; span_i<5; span_i++ ){
+		snprintf(
+			buffer,
+			sizeof(buffer),
+			"grep '\"name\":\"%s\"' temp_trace.json | grep -o '\"tid\":[0-9]*' | sort -u | wc -l",
+			spans[span_i]
+		);
+		FILE *fp = popen(buffer, "r");
+		CU_ASSERT(fp != NULL);
+		CU_ASSERT( fgets(buffer, BUFSIZE, fp) != NULL && strcmp(buffer, "3\n") == 0 );
+		pclose(fp);
+	}
+
+	system("rm temp_trace.json");
+	system("rm temp_par_mandelbrot_set.csv");
+}
+#endif
+
+// Returns whether the server's tile matches rendering the same region here.
+int tile_matches_library( const struct tile_request * request, const int * tile ){
+	struct mandelbrot_region region;
+	region.center_x = request->center_x;
+	region.center_y = request->center_y;
+	region.scale = request->scale;
+	region.x_resolution = request->x_resolution;
+	region.y_resolution = request->y_resolution;
+	region.limit = request->limit;
+	region.precision = request->precision;
+	long long num_pixels = (long long)request->x_resolution * request->y_resolution;
+	int * expected = (int*)malloc(sizeof(int)*num_pixels);
+	mandelbrot_render( &region, 0, request->y_resolution, expected );
+	int same = memcmp( expected, tile, sizeof(int)*num_pixels ) == 0;
+	free(expected);
+	return same;
+}
+
+void test_serve_tiles(){
+	system("rm -f temp_tiles.sock");
+	system("mpirun -np 3 ./par_mandelbrot_set --serve temp_tiles.sock &");
+	// Give mpirun up to a minute to start the ranks.
+	int fd = -1;
+	for( int attempt=0; attempt<600 && fd<0; attempt++ ){
+		usleep(100000);
+		fd = connect_tile_server("temp_tiles.sock");
+	}
+	CU_ASSERT(fd >= 0);
+	if( fd < 0 ){
+		return;
+	}
+
+	int * tile = (int*)malloc(sizeof(int)*64*48);
+	struct tile_response response;
+	struct tile_request requests[2];
+	init_tile_request( &requests[0], dd_from_double(-0.5), dd_from_double(0.0), 3.0, 64, 48, 200 );
+	CU_ASSERT( send_tile_request( fd, &requests[0] ) == 0 );
+	CU_ASSERT( receive_tile( fd, &response, tile, 64*48 ) == 0 );
+	CU_ASSERT( response.x_resolution == 64 && response.y_resolution == 48 );
+	CU_ASSERT( tile_matches_library( &requests[0], tile ) );
+
+	// The same request twice in one write is waiting twice at once, so both are
+	// answered by one render.
+	init_tile_request( &requests[0], dd_from_double(-1.75), dd_from_double(0.0), 1e-14, 32, 32, 500 );
+	requests[1] = requests[0];
+	CU_ASSERT( write_fully( fd, requests, sizeof(requests) ) == 0 );
+	for( int request_i=0; request_i<2; request_i++ ){
+		CU_ASSERT( receive_tile( fd, &response, tile, 64*48 ) == 0 );
+		CU_ASSERT( response.num_coalesced == 2 );
+		CU_ASSERT( tile_matches_library( &requests[0], tile ) );
+	}
+
+	// An invalid request is refused without closing the connection, and other
+	// clients are served alongside.
+	int other_fd = connect_tile_server("temp_tiles.sock");
+	CU_ASSERT(other_fd >= 0);
+	requests[1].x_resolution = 0;
+	CU_ASSERT( send_tile_request( fd, &requests[1] ) == 0 );
+	CU_ASSERT( receive_tile( fd, &response, tile, 64*48 ) != 0 && response.status == -1 );
+	// Nor is there float precision any more.
+	requests[1] = requests[0];
+	requests[1].precision = 3;
+	CU_ASSERT( send_tile_request( fd, &requests[1] ) == 0 );
+	CU_ASSERT( receive_tile( fd, &response, tile, 64*48 ) != 0 && response.status == -1 );
+	init_tile_request( &requests[1], dd_from_double(-0.75), dd_from_double(0.1), 0.01, 48, 40, 300 );
+	CU_ASSERT( send_tile_request( other_fd, &requests[1] ) == 0 );
+	CU_ASSERT( receive_tile( other_fd, &response, tile, 64*48 ) == 0 );
+	CU_ASSERT( tile_matches_library( &requests[1], tile ) );
+
+	// A client that asks for more large tiles than its socket holds and reads
+	// none of them holds up no one else. Give up after a minute rather than hang.
+	int greedy_fd = connect_tile_server("temp_tiles.sock");
+	CU_ASSERT(greedy_fd >= 0);
+	struct tile_request large[8];
+	for( int request_i=0; request_i<8; request_i++ ){
+		init_tile_request( &large[request_i], dd_from_double(-0.5), dd_from_double(0.0), 3.0, 1024, 1024, 1 + request_i );
+	}
+	CU_ASSERT( write_fully( greedy_fd, large, sizeof(large) ) == 0 );
+	// Ask once the server is well into answering them.
+	usleep(500000);
+	struct timeval timeout = { 60, 0 };
+	setsockopt( other_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout) );
+	CU_ASSERT( send_tile_request( other_fd, &requests[1] ) == 0 );
+	CU_ASSERT( receive_tile( other_fd, &response, tile, 64*48 ) == 0 );
+	CU_ASSERT( tile_matches_library( &requests[1], tile ) );
+	close(greedy_fd);
+	close(other_fd);
+
+	// A tile asked for while the same one is rendering, or just after, is
+	// answered by that render, even to a client that stopped writing after
+	// asking.
+	int * slow_tile = (int*)malloc(sizeof(int)*128*128);
+	init_tile_request( &requests[1], dd_from_double(-0.5), dd_from_double(0.0), 3.0, 128, 128, 50000 );
+	CU_ASSERT( send_tile_request( fd, &requests[1] ) == 0 );
+	usleep(200000);
+	int late_fd = connect_tile_server("temp_tiles.sock");
+	CU_ASSERT(late_fd >= 0);
+	CU_ASSERT( send_tile_request( late_fd, &requests[1] ) == 0 );
+	shutdown( late_fd, SHUT_WR );
+	CU_ASSERT( receive_tile( fd, &response, slow_tile, 128*128 ) == 0 );
+	CU_ASSERT( receive_tile( late_fd, &response, slow_tile, 128*128 ) == 0 );
+	CU_ASSERT( response.num_coalesced == 2 );
+	CU_ASSERT( tile_matches_library( &requests[1], slow_tile ) );
+	close(late_fd);
+	free(slow_tile);
+
+	requests[0].type = TILE_REQUEST_SHUTDOWN;
+	CU_ASSERT( send_tile_request( fd, &requests[0] ) == 0 );
+	close(fd);
+	// The server removes its socket as it stops.
+	int stopped = 0;
+	for( int attempt=0; attempt<300 && !stopped; attempt++ ){
+		usleep(100000);
+		stopped = access("temp_tiles.sock", F_OK) != 0;
+	}
+	CU_ASSERT( stopped );
+	free(tile);
+}
+
 int main(){
 	CU_initialize_registry();
 	CU_pSuite suite = CU_add_suite("AddTestSuite", 0, 0);
 	CU_add_test(suite, "test that par_main.c reports the same values as seq_main.c", test_par_against_seq);
 	CU_add_test(suite, "test that par_main.c's output does not change for different numbers of processes", test_num_processes_does_not_change);
 	CU_add_test(suite, "test that par_main.c's output does not change for different high density ratios", test_high_density_ratio_does_not_change);
+	CU_add_test(suite, "test that par_main.c matches seq_main.c for zoomed viewports", test_viewport_against_seq);
+	CU_add_test(suite, "test that par_main.c matches seq_main.c when using the tile cache", test_tile_cache_against_seq);
+	CU_add_test(suite, "test that animation frames match seq_main.c", test_animation_against_seq);
+	CU_add_test(suite, "test that par_main.c's output does not change when streaming", test_streaming_does_not_change);
+	CU_add_test(suite, "test that rle output decompresses to seq_main.c's output", test_rle_against_seq);
+	CU_add_test(suite, "test that a resumed raw render decompresses to seq_main.c's output", test_raw_resume_against_seq);
+	CU_add_test(suite, "test that refining a raw render to a higher limit matches seq_main.c's output", test_refine_against_seq);
+	CU_add_test(suite, "test that par_main.c matches seq_main.c when copying mirrored rows", test_symmetry_against_seq);
+	CU_add_test(suite, "test that every level of a pyramid pools seq_main.c's counts", test_pyramid_against_seq);
+	CU_add_test(suite, "test that par_main.c's output does not change when aggregating writes per node", test_aggregate_does_not_change);
+	CU_add_test(suite, "test that par_main.c appends a line of timings per run", test_timings_are_appended);
+	CU_add_test(suite, "test that par_main.c counts every phase on every rank", test_counters_have_every_phase);
+	CU_add_test(suite, "test that par_main.c --serve renders the tiles requested", test_serve_tiles);
+#ifdef TRACE
+	CU_add_test(suite, "test that par_main.c traces every phase on every rank", test_trace_has_every_phase);
+#endif
 	CU_basic_run_tests();
 	CU_cleanup_registry();
 	return 0;
@@ -0,0 +1,107 @@
+#include <complex.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "double_double.h"
+#include "perturbation.h"
+
+// How small the neglected cubic term of the series approximation must stay,
+// relative to the linear term, for iterations to be skipped.
+#define SERIES_TOLERANCE 1e-12
+
+static double norm( double complex z ){
+	return creal(z) * creal(z) + cimag(z) * cimag(z);
+}
+
+// Advance the series coefficients alongside the reference orbit for as long as
+// the cubic approximation of delta_z stays accurate for every pixel within
+// max_delta of the reference. The orbit itself does not depend on max_delta, so
+// it can be reused for any number of viewports around the same center.
+void approximate_series( struct reference_orbit * orbit, int limit, double max_delta ){
+	double complex a = 0.0;
+	double complex b = 0.0;
+	double complex c = 0.0;
+	int n = 0;
+	// Leave at least one reference point for the pixel loop to step from.
+	while( n + 1 < limit && n + 2 < orbit->length ){
+		double complex two_z = 2.0 * orbit->z[n];
+		double complex next_a = two_z * a + 1.0;
+		double complex next_b = two_z * b + a * a;
+		double complex next_c = two_z * c + 2.0 * a * b;
+
+		double linear = cabs(next_a) * max_delta;
+		double cubic = cabs(next_c) * max_delta * max_delta * max_delta;
+		if( cubic > SERIES_TOLERANCE * linear ){
+			break;
+		}
+		// No pixel may escape inside the skipped iterations.
+		if( cabs(orbit->z[n+1]) + 2.0 * linear >= 2.0 ){
+			break;
+		}
+		a = next_a;
+		b = next_b;
+		c = next_c;
+		n++;
+	}
+	orbit->skip = n;
+	orbit->series_a = a;
+	orbit->series_b = b;
+	orbit->series_c = c;
+}
+
+void compute_reference_orbit( struct double_double c_re, struct double_double c_im, int limit, double max_delta, struct reference_orbit * orbit ){
+	orbit->z = (double complex*)malloc(sizeof(double complex)*(limit+1));
+
+	// Iterate the reference point with double-double arithmetic so its orbit is
+	// accurate to far below the spacing of the pixels around it.
+	struct double_double z_re = dd_from_double( 0.0 );
+	struct double_double z_im = dd_from_double( 0.0 );
+	orbit->z[0] = 0.0;
+	int n = 0;
+	while( n < limit ){
+		struct double_double z_re_squared = dd_mul( z_re, z_re );
+		struct double_double z_im_squared = dd_mul( z_im, z_im );
+		z_im = dd_add( dd_mul_double( dd_mul( z_re, z_im ), 2.0 ), c_im );
+		z_re = dd_add( dd_sub( z_re_squared, z_im_squared ), c_re );
+		n++;
+		orbit->z[n] = dd_to_double( z_re ) + dd_to_double( z_im ) * I;
+		if( norm( orbit->z[n] ) > 4.0 ){
+			break;
+		}
+	}
+	orbit->length = n + 1;
+
+	approximate_series( orbit, limit, max_delta );
+}
+
+int in_mandelbrot_set_perturbed( const struct reference_orbit * orbit, double complex delta_c, int limit ){
+	// Start from where the series approximation leaves off. delta_z is the
+	// difference between this pixel's orbit and the reference orbit.
+	double complex delta_z = ((orbit->series_c * delta_c + orbit->series_b) * delta_c + orbit->series_a) * delta_c;
+	int ref_i = orbit->skip;
+	int i = orbit->skip;
+	while( i<limit ){
+		delta_z = (2.0 * orbit->z[ref_i] + delta_z) * delta_z + delta_c;
+		ref_i++;
+		double complex z = orbit->z[ref_i] + delta_z;
+		if( norm(z) > 4.0 ){
+			return i;
+		}
+		// Once the pixel's orbit passes closer to 0 than the reference, or the
+		// reference has escaped, rebase onto the start of the reference orbit.
+		// This avoids the precision loss ("glitches") of subtracting two nearly
+		// equal orbits.
+		if( norm(z) < norm(delta_z) || ref_i == orbit->length - 1 ){
+			delta_z = z;
+			ref_i = 0;
+		}
+		i++;
+	}
+	return i;
+}
+
+void free_reference_orbit( struct reference_orbit * orbit ){
+	free(orbit->z);
+	orbit->z = NULL;
+	orbit->length = 0;
+}
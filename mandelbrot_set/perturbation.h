@@ -0,0 +1,28 @@
+#ifndef PERTURBATION_H
+#define PERTURBATION_H
+
+#include <complex.h>
+
+#include "double_double.h"
+
+// The orbit of a single high precision reference point, rounded to doubles, that
+// neighbouring pixels are iterated relative to.
+struct reference_orbit {
+	// Number of entries in z. z[0] is 0 and the orbit stops early if the
+	// reference escapes.
+	int length;
+	double complex * z;
+	// Iteration the series approximation lets every pixel start from, and the
+	// coefficients of delta_z = a * delta_c + b * delta_c^2 + c * delta_c^3 there.
+	int skip;
+	double complex series_a;
+	double complex series_b;
+	double complex series_c;
+};
+
+void compute_reference_orbit( struct double_double c_re, struct double_double c_im, int limit, double max_delta, struct reference_orbit * orbit );
+void approximate_series( struct reference_orbit * orbit, int limit, double max_delta );
+int in_mandelbrot_set_perturbed( const struct reference_orbit * orbit, double complex delta_c, int limit );
+void free_reference_orbit( struct reference_orbit * orbit );
+
+#endif
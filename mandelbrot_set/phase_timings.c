@@ -0,0 +1,56 @@
+#include <mpi.h>
+
+#include "phase_timings.h"
+#include "../common/trace.h"
+#include "../common/perf_counters.h"
+
+const char * phase_names[NUM_PHASES] = { "compute", "format", "exchange", "write" };
+
+// Starts the wall clock too.
+void init_phase_timings( struct phase_timings * timings ){
+	for( int phase=0; phase<NUM_PHASES; phase++ ){
+		timings->seconds[phase] = 0.0;
+		timings->started[phase] = 0.0;
+	}
+	timings->wall_started = MPI_Wtime();
+	timings->wall = 0.0;
+}
+
+// Each phase is also a span of the trace, and a phase of the counters, named
+// after it.
+void begin_phase( struct phase_timings * timings, int phase ){
+	TRACE_BEGIN( phase_names[phase] );
+	counters_begin( phase_names[phase] );
+	timings->started[phase] = MPI_Wtime();
+}
+
+void end_phase( struct phase_timings * timings, int phase ){
+	timings->seconds[phase] += MPI_Wtime() - timings->started[phase];
+	counters_end();
+	TRACE_END();
+}
+
+void finish_phase_timings( struct phase_timings * timings ){
+	timings->wall = MPI_Wtime() - timings->wall_started;
+}
+
+// Give root the minimum, mean and maximum over the ranks of each phase, followed
+// by those of the wall time, so each array needs NUM_PHASES + 1 entries.
+void reduce_phase_timings( const struct phase_timings * timings, int root, MPI_Comm comm, double * min, double * mean, double * max ){
+	double seconds[NUM_PHASES + 1];
+	for( int phase=0; phase<NUM_PHASES; phase++ ){
+		seconds[phase] = timings->seconds[phase];
+	}
+	seconds[NUM_PHASES] = timings->wall;
+	int my_rank, n_procs;
+	MPI_Comm_rank( comm, &my_rank );
+	MPI_Comm_size( comm, &n_procs );
+	MPI_Reduce( seconds, min, NUM_PHASES + 1, MPI_DOUBLE, MPI_MIN, root, comm );
+	MPI_Reduce( seconds, mean, NUM_PHASES + 1, MPI_DOUBLE, MPI_SUM, root, comm );
+	MPI_Reduce( seconds, max, NUM_PHASES + 1, MPI_DOUBLE, MPI_MAX, root, comm );
+	if( my_rank == root ){
+		for( int phase=0; phase<=NUM_PHASES; phase++ ){
+			mean[phase] /= n_procs;
+		}
+	}
+}
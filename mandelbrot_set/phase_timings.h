@@ -0,0 +1,30 @@
+#ifndef PHASE_TIMINGS_H
+#define PHASE_TIMINGS_H
+
+#include <mpi.h>
+
+// The parts of a render timed separately.
+#define PHASE_COMPUTE 0
+#define PHASE_FORMAT 1
+#define PHASE_EXCHANGE 2
+#define PHASE_WRITE 3
+#define NUM_PHASES 4
+
+// Wall clock time spent in each phase by one rank. A phase may be entered any
+// number of times, its time adds up.
+struct phase_timings {
+	double seconds[NUM_PHASES];
+	double started[NUM_PHASES];
+	double wall_started;
+	double wall;
+};
+
+extern const char * phase_names[NUM_PHASES];
+
+void init_phase_timings( struct phase_timings * timings );
+void begin_phase( struct phase_timings * timings, int phase );
+void end_phase( struct phase_timings * timings, int phase );
+void finish_phase_timings( struct phase_timings * timings );
+void reduce_phase_timings( const struct phase_timings * timings, int root, MPI_Comm comm, double * min, double * mean, double * max );
+
+#endif
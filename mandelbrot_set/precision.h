@@ -0,0 +1,12 @@
+#ifndef PRECISION_H
+#define PRECISION_H
+
+// How pixels are iterated, kept apart from render.h so libmandelbrot.h can
+// offer them without declaring the renderer.
+#define PRECISION_AUTO 0
+#define PRECISION_DOUBLE 1
+#define PRECISION_PERTURBATION 2
+// 3 was float, which is no longer offered.
+#define PRECISION_DOUBLE_DOUBLE 4
+
+#endif
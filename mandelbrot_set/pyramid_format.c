@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pyramid_format.h"
+
+// Adds levels until one fits in a single tile. The coordinates are left for the
+// caller to fill in.
+void init_pyramid_header( struct pyramid_header * header, int x_resolution, int y_resolution, int limit, int tile_size, int pooling ){
+	memset( header, 0, sizeof(*header) );
+	strcpy( header->magic, PYRAMID_MAGIC );
+	header->x_resolution = x_resolution;
+	header->y_resolution = y_resolution;
+	header->limit = limit;
+	header->tile_size = tile_size;
+	header->pooling = pooling;
+	header->num_levels = 1;
+	while( pyramid_level_width( header, header->num_levels - 1 ) > tile_size
+			|| pyramid_level_height( header, header->num_levels - 1 ) > tile_size ){
+		header->num_levels++;
+	}
+}
+
+// Returns -1 if name is not a known pooling.
+int parse_pooling( const char * name ){
+	if( strcmp( name, "max" ) == 0 ){
+		return POOLING_MAX;
+	} else if( strcmp( name, "mean" ) == 0 ){
+		return POOLING_MEAN;
+	}
+	return -1;
+}
+
+// A pixel of a level covers 2^level full resolution pixels each way, or fewer
+// on the right and bottom edges.
+int pyramid_level_width( const struct pyramid_header * header, int level ){
+	return (int)(((long long)header->x_resolution + (1LL << level) - 1) >> level);
+}
+
+int pyramid_level_height( const struct pyramid_header * header, int level ){
+	return (int)(((long long)header->y_resolution + (1LL << level) - 1) >> level);
+}
+
+int pyramid_tiles_x( const struct pyramid_header * header, int level ){
+	return (pyramid_level_width( header, level ) + header->tile_size - 1) / header->tile_size;
+}
+
+int pyramid_tiles_y( const struct pyramid_header * header, int level ){
+	return (pyramid_level_height( header, level ) + header->tile_size - 1) / header->tile_size;
+}
+
+int pyramid_num_tiles( const struct pyramid_header * header ){
+	int num_tiles = 0;
+	for( int level=0; level<header->num_levels; level++ ){
+		num_tiles += pyramid_tiles_x( header, level ) * pyramid_tiles_y( header, level );
+	}
+	return num_tiles;
+}
+
+// Where a tile is in the index.
+int pyramid_tile_number( const struct pyramid_header * header, int level, int tile_x, int tile_y ){
+	int tile_number = 0;
+	for( int previous=0; previous<level; previous++ ){
+		tile_number += pyramid_tiles_x( header, previous ) * pyramid_tiles_y( header, previous );
+	}
+	return tile_number + tile_y * pyramid_tiles_x( header, level ) + tile_x;
+}
+
+int pyramid_tile_width( const struct pyramid_header * header, int level, int tile_x ){
+	int width = pyramid_level_width( header, level ) - tile_x * header->tile_size;
+	return width < header->tile_size ? width : header->tile_size;
+}
+
+int pyramid_tile_height( const struct pyramid_header * header, int level, int tile_y ){
+	int height = pyramid_level_height( header, level ) - tile_y * header->tile_size;
+	return height < header->tile_size ? height : header->tile_size;
+}
+
+// How many full resolution pixels the pixel of a level covers.
+int pyramid_pool_size( const struct pyramid_header * header, int level, int x_i, int y_i ){
+	long long first_x = (long long)x_i << level;
+	long long first_y = (long long)y_i << level;
+	long long max_x = first_x + (1LL << level);
+	long long max_y = first_y + (1LL << level);
+	if( max_x > header->x_resolution ){
+		max_x = header->x_resolution;
+	}
+	if( max_y > header->y_resolution ){
+		max_y = header->y_resolution;
+	}
+	return (int)((max_x - first_x) * (max_y - first_y));
+}
+
+long long pyramid_data_offset( const struct pyramid_header * header ){
+	return sizeof(struct pyramid_header) + sizeof(long long) * ((long long)pyramid_num_tiles( header ) + 1);
+}
+
+// Every tile's size follows from the header, so the index can be worked out
+// before any tile is rendered. index needs pyramid_num_tiles + 1 entries.
+void init_pyramid_index( const struct pyramid_header * header, long long * index ){
+	int tile_number = 0;
+	index[0] = pyramid_data_offset( header );
+	for( int level=0; level<header->num_levels; level++ ){
+		for( int tile_y=0; tile_y<pyramid_tiles_y( header, level ); tile_y++ ){
+			for( int tile_x=0; tile_x<pyramid_tiles_x( header, level ); tile_x++ ){
+				long long tile_pixels = (long long)pyramid_tile_width( header, level, tile_x ) * pyramid_tile_height( header, level, tile_y );
+				index[tile_number+1] = index[tile_number] + sizeof(float) * tile_pixels;
+				tile_number++;
+			}
+		}
+	}
+}
+
+// Read the header and index of a pyramid. Returns 0 on success and -1 if the file
+// could not be read or is not in this format.
+int open_pyramid_file( const char * path, struct pyramid_file * pyramid ){
+	pyramid->index = NULL;
+	pyramid->file = fopen( path, "rb" );
+	if( pyramid->file == NULL ){
+		return -1;
+	}
+	struct pyramid_header * header = &pyramid->header;
+	if( fread( header, sizeof(*header), 1, pyramid->file ) != 1
+			|| memcmp( header->magic, PYRAMID_MAGIC, sizeof(PYRAMID_MAGIC) ) != 0
+			|| header->x_resolution <= 0 || header->y_resolution <= 0 || header->tile_size <= 0
+			|| header->num_levels <= 0 || header->num_levels > 31 ){
+		close_pyramid_file( pyramid );
+		return -1;
+	}
+	int num_tiles = pyramid_num_tiles( header );
+	pyramid->index = (long long*)malloc(sizeof(long long)*(num_tiles+1));
+	if( fread( pyramid->index, sizeof(long long), num_tiles + 1, pyramid->file ) != (size_t)num_tiles + 1 ){
+		close_pyramid_file( pyramid );
+		return -1;
+	}
+	return 0;
+}
+
+// Read one tile into values, which must hold tile_size * tile_size floats.
+// Returns 0 on success and -1 if there is no such tile or the file is too short.
+int read_pyramid_tile( struct pyramid_file * pyramid, int level, int tile_x, int tile_y, float * values ){
+	const struct pyramid_header * header = &pyramid->header;
+	if( level < 0 || level >= header->num_levels
+			|| tile_x < 0 || tile_x >= pyramid_tiles_x( header, level )
+			|| tile_y < 0 || tile_y >= pyramid_tiles_y( header, level ) ){
+		return -1;
+	}
+	int tile_number = pyramid_tile_number( header, level, tile_x, tile_y );
+	long long size = pyramid->index[tile_number+1] - pyramid->index[tile_number];
+	if( size < 0 || size > (long long)sizeof(float) * header->tile_size * header->tile_size
+			|| fseek( pyramid->file, pyramid->index[tile_number], SEEK_SET ) != 0
+			|| fread( values, 1, size, pyramid->file ) != (size_t)size ){
+		return -1;
+	}
+	return 0;
+}
+
+void close_pyramid_file( struct pyramid_file * pyramid ){
+	if( pyramid->file != NULL ){
+		fclose( pyramid->file );
+		pyramid->file = NULL;
+	}
+	free(pyramid->index);
+	pyramid->index = NULL;
+}
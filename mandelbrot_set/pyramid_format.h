@@ -0,0 +1,64 @@
+#ifndef PYRAMID_FORMAT_H
+#define PYRAMID_FORMAT_H
+
+#include <stdio.h>
+
+#define PYRAMID_MAGIC "MBPYR01"
+// Width and height of a full tile, in pixels of its level.
+#define PYRAMID_TILE_SIZE 256
+
+#define POOLING_MAX 0
+#define POOLING_MEAN 1
+
+// Levels of detail of a grid of iteration counts, cut into tiles so a viewer
+// reads only the part of the level it shows. Level 0 is the full resolution, and
+// each pixel of the next level pools the 2 by 2 pixels beneath it, until a level
+// fits in one tile. The file is laid out as
+//   struct pyramid_header
+//   long long index[num_tiles+1], the file offset of each tile and of the end
+//   the tiles themselves
+// in the byte order of the machine that wrote it. Tiles are in order of level,
+// then row major within the level. A tile is the float value of each of its
+// pixels in row major order, and tiles on the right and bottom edges of a level
+// are only as large as the part of the level they cover.
+// A pixel's value is the maximum or mean of the counts of the full resolution
+// pixels it covers, so counts above 2^24 are rounded.
+struct pyramid_header {
+	char magic[8];
+	int x_resolution;
+	int y_resolution;
+	int limit;
+	int tile_size;
+	int num_levels;
+	int pooling;
+	// The coordinates of the first and last columns and rows of level 0.
+	double x_first;
+	double x_last;
+	double y_first;
+	double y_last;
+};
+
+struct pyramid_file {
+	FILE * file;
+	struct pyramid_header header;
+	long long * index;
+};
+
+void init_pyramid_header( struct pyramid_header * header, int x_resolution, int y_resolution, int limit, int tile_size, int pooling );
+int parse_pooling( const char * name );
+int pyramid_level_width( const struct pyramid_header * header, int level );
+int pyramid_level_height( const struct pyramid_header * header, int level );
+int pyramid_tiles_x( const struct pyramid_header * header, int level );
+int pyramid_tiles_y( const struct pyramid_header * header, int level );
+int pyramid_num_tiles( const struct pyramid_header * header );
+int pyramid_tile_number( const struct pyramid_header * header, int level, int tile_x, int tile_y );
+int pyramid_tile_width( const struct pyramid_header * header, int level, int tile_x );
+int pyramid_tile_height( const struct pyramid_header * header, int level, int tile_y );
+int pyramid_pool_size( const struct pyramid_header * header, int level, int x_i, int y_i );
+long long pyramid_data_offset( const struct pyramid_header * header );
+void init_pyramid_index( const struct pyramid_header * header, long long * index );
+int open_pyramid_file( const char * path, struct pyramid_file * pyramid );
+int read_pyramid_tile( struct pyramid_file * pyramid, int level, int tile_x, int tile_y, float * values );
+void close_pyramid_file( struct pyramid_file * pyramid );
+
+#endif
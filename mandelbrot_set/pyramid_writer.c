@@ -0,0 +1,426 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/trace.h"
+#include "large_io.h"
+#include "pyramid_writer.h"
+
+// A level row a band only reaches part of, as every rank sees it. The owner is
+// the band holding the row's first full resolution row, which ends up with the
+// whole pool.
+struct pyramid_partial {
+	int level;
+	int row;
+	int owner;
+};
+
+// The rank owning a partial level row, sorted by level then row for lookups.
+struct pyramid_row_owner {
+	int level;
+	int row;
+	int rank;
+};
+
+// A run of a level row that falls in one tile, and where it goes in the file.
+struct pyramid_segment {
+	long long offset;
+	const double * values;
+	int level;
+	int row;
+	int first_x;
+	int length;
+};
+
+static int compare_pyramid_segments( const void * a, const void * b ){
+	const struct pyramid_segment * segment_a = (const struct pyramid_segment*)a;
+	const struct pyramid_segment * segment_b = (const struct pyramid_segment*)b;
+	return (segment_a->offset > segment_b->offset) - (segment_a->offset < segment_b->offset);
+}
+
+static int compare_pyramid_row_owners( const void * a, const void * b ){
+	const struct pyramid_row_owner * owner_a = (const struct pyramid_row_owner*)a;
+	const struct pyramid_row_owner * owner_b = (const struct pyramid_row_owner*)b;
+	if( owner_a->level != owner_b->level ){
+		return (owner_a->level > owner_b->level) - (owner_a->level < owner_b->level);
+	}
+	return (owner_a->row > owner_b->row) - (owner_a->row < owner_b->row);
+}
+
+static inline void pool_value( double * pooled, double value, int pooling ){
+	if( pooling == POOLING_MAX ){
+		if( value > *pooled ){
+			*pooled = value;
+		}
+	} else {
+		*pooled += value;
+	}
+}
+
+// Every rank must pass its bands of rows, which may be empty, and together the
+// bands of every rank must cover each row once.
+void init_pyramid_builder( struct pyramid_builder * builder, const struct pyramid_header * header, const int * first_y_i, const int * max_y_i, int num_bands ){
+	builder->header = *header;
+	builder->num_bands = num_bands;
+	builder->bands = (struct pyramid_band*)malloc(sizeof(struct pyramid_band)*num_bands);
+	int num_levels = header->num_levels;
+	for( int band_i=0; band_i<num_bands; band_i++ ){
+		struct pyramid_band * band = &builder->bands[band_i];
+		band->first_y_i = first_y_i[band_i];
+		band->max_y_i = max_y_i[band_i];
+		band->first_row = (int*)malloc(sizeof(int)*num_levels);
+		band->num_rows = (int*)malloc(sizeof(int)*num_levels);
+		band->values = (double**)malloc(sizeof(double*)*num_levels);
+		for( int level=0; level<num_levels; level++ ){
+			if( band->max_y_i > band->first_y_i ){
+				band->first_row[level] = band->first_y_i >> level;
+				band->num_rows[level] = ((band->max_y_i - 1) >> level) - band->first_row[level] + 1;
+			} else {
+				band->first_row[level] = 0;
+				band->num_rows[level] = 0;
+			}
+			band->values[level] = (double*)calloc((long long)band->num_rows[level] * pyramid_level_width( header, level ) + 1, sizeof(double));
+		}
+	}
+}
+
+// Pool a row of the band into level 0 and 1. The higher levels are pooled from
+// level 1 by reduce_pyramid, once the band is complete.
+void pyramid_add_row( struct pyramid_builder * builder, int band_i, int y_i, const int * iterations ){
+	const struct pyramid_header * header = &builder->header;
+	struct pyramid_band * band = &builder->bands[band_i];
+	int x_resolution = header->x_resolution;
+	double * row = band->values[0] + (long long)(y_i - band->first_row[0]) * x_resolution;
+	for( int x_i=0; x_i<x_resolution; x_i++ ){
+		row[x_i] = iterations[x_i];
+	}
+	if( header->num_levels > 1 ){
+		double * pooled = band->values[1] + (long long)((y_i >> 1) - band->first_row[1]) * pyramid_level_width( header, 1 );
+		for( int x_i=0; x_i<x_resolution; x_i++ ){
+			pool_value( &pooled[x_i >> 1], iterations[x_i], header->pooling );
+		}
+	}
+}
+
+// Whether a band holds, or is to be given, the whole pool of a level row.
+static int owns_row( const struct pyramid_band * band, int level, int row ){
+	long long first_y_i = (long long)row << level;
+	return first_y_i >= band->first_y_i && first_y_i < band->max_y_i;
+}
+
+static int owns_whole_row( const struct pyramid_header * header, const struct pyramid_band * band, int level, int row ){
+	long long max_y_i = ((long long)row + 1) << level;
+	if( max_y_i > header->y_resolution ){
+		max_y_i = header->y_resolution;
+	}
+	return owns_row( band, level, row ) && max_y_i <= band->max_y_i;
+}
+
+// Find which rank each gathered partial row is to be sent to, or -1 for those
+// already with their owner. Every partial row has an owner among them, and they
+// are looked up in a table of the owners sorted by level and row, since there
+// are a few per band on every rank.
+static void find_owners( const struct pyramid_partial * all_partials, const int * counts, const int * displacements, int n_procs, int * partial_owners ){
+	int total_partials = displacements[n_procs-1] + counts[n_procs-1];
+	struct pyramid_row_owner * owners = (struct pyramid_row_owner*)malloc(sizeof(struct pyramid_row_owner)*(total_partials + 1));
+	int num_owners = 0;
+	for( int rank=0; rank<n_procs; rank++ ){
+		for( int partial_i=0; partial_i<counts[rank]; partial_i++ ){
+			const struct pyramid_partial * partial = &all_partials[displacements[rank] + partial_i];
+			if( partial->owner ){
+				owners[num_owners].level = partial->level;
+				owners[num_owners].row = partial->row;
+				owners[num_owners].rank = rank;
+				num_owners++;
+			}
+		}
+	}
+	qsort( owners, num_owners, sizeof(struct pyramid_row_owner), compare_pyramid_row_owners );
+	for( int partial_i=0; partial_i<total_partials; partial_i++ ){
+		partial_owners[partial_i] = -1;
+		if( !all_partials[partial_i].owner ){
+			struct pyramid_row_owner key = { all_partials[partial_i].level, all_partials[partial_i].row, 0 };
+			const struct pyramid_row_owner * owner = (const struct pyramid_row_owner*)bsearch( &key, owners, num_owners, sizeof(struct pyramid_row_owner), compare_pyramid_row_owners );
+			partial_owners[partial_i] = owner->rank;
+		}
+	}
+	free(owners);
+}
+
+// Finish pooling every level of each band, then send the level rows shared
+// between bands to the band that owns them, so every level row is whole on
+// exactly one rank. Only the first and last level rows of a band can be shared,
+// so very little is sent. Must be called by every rank of comm.
+void reduce_pyramid( struct pyramid_builder * builder, MPI_Comm comm ){
+	const struct pyramid_header * header = &builder->header;
+	int pooling = header->pooling;
+	int my_rank, n_procs;
+	MPI_Comm_rank( comm, &my_rank );
+	MPI_Comm_size( comm, &n_procs );
+
+	for( int band_i=0; band_i<builder->num_bands; band_i++ ){
+		struct pyramid_band * band = &builder->bands[band_i];
+		for( int level=2; level<header->num_levels; level++ ){
+			int width = pyramid_level_width( header, level );
+			int below_width = pyramid_level_width( header, level - 1 );
+			for( int below_i=0; below_i<band->num_rows[level-1]; below_i++ ){
+				int row = (band->first_row[level-1] + below_i) >> 1;
+				double * pooled = band->values[level] + (long long)(row - band->first_row[level]) * width;
+				const double * below = band->values[level-1] + (long long)below_i * below_width;
+				for( int x_i=0; x_i<below_width; x_i++ ){
+					pool_value( &pooled[x_i >> 1], below[x_i], pooling );
+				}
+			}
+		}
+	}
+
+	// Every rank learns every partial row, so it knows where to send its own and
+	// what it will be sent.
+	int max_partials = 2 * builder->num_bands * header->num_levels;
+	struct pyramid_partial * partials = (struct pyramid_partial*)malloc(sizeof(struct pyramid_partial)*(max_partials + 1));
+	int * partial_bands = (int*)malloc(sizeof(int)*(max_partials + 1));
+	int num_partials = 0;
+	for( int band_i=0; band_i<builder->num_bands; band_i++ ){
+		const struct pyramid_band * band = &builder->bands[band_i];
+		if( band->max_y_i == band->first_y_i ){
+			continue;
+		}
+		for( int level=1; level<header->num_levels; level++ ){
+			int ends[2] = { band->first_row[level], band->first_row[level] + band->num_rows[level] - 1 };
+			for( int end_i=0; end_i<(ends[1] > ends[0] ? 2 : 1); end_i++ ){
+				int row = ends[end_i];
+				if( owns_whole_row( header, band, level, row ) ){
+					continue;
+				}
+				partials[num_partials].level = level;
+				partials[num_partials].row = row;
+				partials[num_partials].owner = owns_row( band, level, row );
+				partial_bands[num_partials] = band_i;
+				num_partials++;
+			}
+		}
+	}
+	TRACE_BEGIN( "MPI_Allgatherv" );
+	int * counts = (int*)malloc(sizeof(int)*n_procs);
+	int * displacements = (int*)malloc(sizeof(int)*n_procs);
+	MPI_Allgather( &num_partials, 1, MPI_INT, counts, 1, MPI_INT, comm );
+	int total_partials = 0;
+	int * int_counts = (int*)malloc(sizeof(int)*n_procs);
+	int * int_displacements = (int*)malloc(sizeof(int)*n_procs);
+	for( int rank=0; rank<n_procs; rank++ ){
+		displacements[rank] = total_partials;
+		total_partials += counts[rank];
+		int_counts[rank] = 3 * counts[rank];
+		int_displacements[rank] = 3 * displacements[rank];
+	}
+	struct pyramid_partial * all_partials = (struct pyramid_partial*)malloc(sizeof(struct pyramid_partial)*(total_partials + 1));
+	MPI_Allgatherv( partials, 3 * num_partials, MPI_INT, all_partials, int_counts, int_displacements, MPI_INT, comm );
+	TRACE_END();
+
+	// Pack the rows to send, grouped by the rank they go to.
+	int * send_counts = (int*)calloc(n_procs,sizeof(int));
+	int * send_displacements = (int*)calloc(n_procs,sizeof(int));
+	int * receive_counts = (int*)calloc(n_procs,sizeof(int));
+	int * receive_displacements = (int*)calloc(n_procs,sizeof(int));
+	int * partial_owners = (int*)malloc(sizeof(int)*(total_partials + 1));
+	find_owners( all_partials, counts, displacements, n_procs, partial_owners );
+	// This rank's own partial rows are its part of the gathered ones.
+	const int * owners = partial_owners + displacements[my_rank];
+	for( int partial_i=0; partial_i<num_partials; partial_i++ ){
+		if( owners[partial_i] >= 0 ){
+			send_counts[owners[partial_i]] += pyramid_level_width( header, partials[partial_i].level );
+		}
+	}
+	for( int rank=0; rank<n_procs; rank++ ){
+		for( int partial_i=0; partial_i<counts[rank]; partial_i++ ){
+			const struct pyramid_partial * partial = &all_partials[displacements[rank] + partial_i];
+			if( partial_owners[displacements[rank] + partial_i] == my_rank ){
+				receive_counts[rank] += pyramid_level_width( header, partial->level );
+			}
+		}
+	}
+	int send_size = 0, receive_size = 0;
+	for( int rank=0; rank<n_procs; rank++ ){
+		send_displacements[rank] = send_size;
+		send_size += send_counts[rank];
+		receive_displacements[rank] = receive_size;
+		receive_size += receive_counts[rank];
+	}
+	double * send_buffer = (double*)malloc(sizeof(double)*(send_size + 1));
+	double * receive_buffer = (double*)malloc(sizeof(double)*(receive_size + 1));
+	int position = 0;
+	for( int rank=0; rank<n_procs; rank++ ){
+		for( int partial_i=0; partial_i<num_partials; partial_i++ ){
+			if( owners[partial_i] != rank ){
+				continue;
+			}
+			const struct pyramid_band * band = &builder->bands[partial_bands[partial_i]];
+			int level = partials[partial_i].level;
+			int width = pyramid_level_width( header, level );
+			memcpy( send_buffer + position, band->values[level] + (long long)(partials[partial_i].row - band->first_row[level]) * width, sizeof(double) * width );
+			position += width;
+		}
+	}
+	TRACE_BEGIN( "MPI_Alltoallv" );
+	MPI_Alltoallv( send_buffer, send_counts, send_displacements, MPI_DOUBLE, receive_buffer, receive_counts, receive_displacements, MPI_DOUBLE, comm );
+	TRACE_END();
+
+	// Rows arrive in the order their senders listed them.
+	position = 0;
+	for( int rank=0; rank<n_procs; rank++ ){
+		for( int partial_i=0; partial_i<counts[rank]; partial_i++ ){
+			const struct pyramid_partial * partial = &all_partials[displacements[rank] + partial_i];
+			if( partial_owners[displacements[rank] + partial_i] != my_rank ){
+				continue;
+			}
+			int level = partial->level;
+			int width = pyramid_level_width( header, level );
+			for( int band_i=0; band_i<builder->num_bands; band_i++ ){
+				struct pyramid_band * band = &builder->bands[band_i];
+				if( owns_row( band, level, partial->row ) ){
+					double * pooled = band->values[level] + (long long)(partial->row - band->first_row[level]) * width;
+					for( int x_i=0; x_i<width; x_i++ ){
+						pool_value( &pooled[x_i], receive_buffer[position + x_i], pooling );
+					}
+				}
+			}
+			position += width;
+		}
+	}
+
+	free(partials);
+	free(partial_bands);
+	free(counts);
+	free(displacements);
+	free(int_counts);
+	free(int_displacements);
+	free(all_partials);
+	free(send_counts);
+	free(send_displacements);
+	free(receive_counts);
+	free(receive_displacements);
+	free(partial_owners);
+	free(send_buffer);
+	free(receive_buffer);
+}
+
+// Write the pyramid to path once it is reduced. Root writes the header and index,
+// and every rank writes the level rows it owns into their tiles with one
+// collective write. Must be called by every rank of comm. Returns 0 on success
+// and -1 if the file could not be written.
+int write_pyramid( const struct pyramid_builder * builder, const char * path, int root, MPI_Comm comm ){
+	const struct pyramid_header * header = &builder->header;
+	int tile_size = header->tile_size;
+	int my_rank;
+	MPI_Comm_rank( comm, &my_rank );
+	int num_tiles = pyramid_num_tiles( header );
+	long long * index = (long long*)malloc(sizeof(long long)*(num_tiles + 1));
+	init_pyramid_index( header, index );
+
+	int status = 0;
+	if( my_rank == root ){
+		FILE * file = fopen( path, "w+" );
+		if( file != NULL ){
+			fwrite( header, sizeof(*header), 1, file );
+			fwrite( index, sizeof(long long), num_tiles + 1, file );
+			fclose(file);
+		} else {
+			status = -1;
+		}
+	}
+
+	// Each owned level row is a run in every tile it crosses.
+	int num_segments = 0;
+	int segments_capacity = 16;
+	struct pyramid_segment * segments = (struct pyramid_segment*)malloc(sizeof(struct pyramid_segment)*segments_capacity);
+	long long num_values = 0;
+	for( int band_i=0; band_i<builder->num_bands; band_i++ ){
+		const struct pyramid_band * band = &builder->bands[band_i];
+		for( int level=0; level<header->num_levels; level++ ){
+			int width = pyramid_level_width( header, level );
+			for( int row_i=0; row_i<band->num_rows[level]; row_i++ ){
+				int row = band->first_row[level] + row_i;
+				if( !owns_row( band, level, row ) ){
+					continue;
+				}
+				int tile_y = row / tile_size;
+				for( int tile_x=0; tile_x<pyramid_tiles_x( header, level ); tile_x++ ){
+					if( num_segments == segments_capacity ){
+						segments_capacity *= 2;
+						segments = (struct pyramid_segment*)realloc(segments, sizeof(struct pyramid_segment)*segments_capacity);
+					}
+					struct pyramid_segment * segment = &segments[num_segments];
+					segment->length = pyramid_tile_width( header, level, tile_x );
+					segment->offset = index[pyramid_tile_number( header, level, tile_x, tile_y )] + sizeof(float) * (long long)(row - tile_y * tile_size) * segment->length;
+					segment->level = level;
+					segment->row = row;
+					segment->first_x = tile_x * tile_size;
+					segment->values = band->values[level] + (long long)row_i * width + segment->first_x;
+					num_values += segment->length;
+					num_segments++;
+				}
+			}
+		}
+	}
+	qsort( segments, num_segments, sizeof(struct pyramid_segment), compare_pyramid_segments );
+
+	// Pack the values in file order, dividing out the pool sizes for means, and
+	// merge the runs that meet in the file.
+	float * values = (float*)malloc(sizeof(float)*(num_values + 1));
+	struct extents extents;
+	init_extents( &extents );
+	long long value_i = 0;
+	for( int segment_i=0; segment_i<num_segments; segment_i++ ){
+		const struct pyramid_segment * segment = &segments[segment_i];
+		for( int x_i=0; x_i<segment->length; x_i++ ){
+			double value = segment->values[x_i];
+			if( header->pooling == POOLING_MEAN ){
+				value /= pyramid_pool_size( header, segment->level, segment->first_x + x_i, segment->row );
+			}
+			values[value_i] = (float)value;
+			value_i++;
+		}
+		add_extent( &extents, segment->offset, sizeof(float) * segment->length );
+	}
+	MPI_Datatype extents_type;
+	commit_extents_type( &extents, &extents_type );
+
+	MPI_File file;
+	TRACE_BEGIN( "MPI_File_open" );
+	int error = MPI_File_open( comm, path, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &file );
+	TRACE_END();
+	if( error == MPI_SUCCESS ){
+		TRACE_BEGIN( "MPI_File_write_all" );
+		MPI_File_set_view( file, 0, MPI_BYTE, extents_type, "native", MPI_INFO_NULL );
+		write_all_large( file, values, sizeof(float) * num_values, MPI_BYTE );
+		TRACE_END();
+		TRACE_BEGIN( "MPI_File_close" );
+		MPI_File_close( &file );
+		TRACE_END();
+	} else {
+		status = -1;
+	}
+
+	MPI_Type_free( &extents_type );
+	free_extents( &extents );
+	free(values);
+	free(segments);
+	free(index);
+	return status;
+}
+
+void free_pyramid_builder( struct pyramid_builder * builder ){
+	for( int band_i=0; band_i<builder->num_bands; band_i++ ){
+		struct pyramid_band * band = &builder->bands[band_i];
+		for( int level=0; level<builder->header.num_levels; level++ ){
+			free(band->values[level]);
+		}
+		free(band->first_row);
+		free(band->num_rows);
+		free(band->values);
+	}
+	free(builder->bands);
+	builder->bands = NULL;
+	builder->num_bands = 0;
+}
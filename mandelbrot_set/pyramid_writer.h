@@ -0,0 +1,33 @@
+#ifndef PYRAMID_WRITER_H
+#define PYRAMID_WRITER_H
+
+#include <mpi.h>
+
+#include "pyramid_format.h"
+
+// A band of rows this rank renders, with every level's pooled values over it.
+// The values are sums, or maxima, of the band's own pixels only, so the level
+// rows the band shares with its neighbours are only part of the pool until
+// reduce_pyramid combines them.
+struct pyramid_band {
+	int first_y_i;
+	int max_y_i;
+	// Per level, the first level row the band reaches and how many it reaches.
+	int * first_row;
+	int * num_rows;
+	double ** values;
+};
+
+struct pyramid_builder {
+	struct pyramid_header header;
+	int num_bands;
+	struct pyramid_band * bands;
+};
+
+void init_pyramid_builder( struct pyramid_builder * builder, const struct pyramid_header * header, const int * first_y_i, const int * max_y_i, int num_bands );
+void pyramid_add_row( struct pyramid_builder * builder, int band_i, int y_i, const int * iterations );
+void reduce_pyramid( struct pyramid_builder * builder, MPI_Comm comm );
+int write_pyramid( const struct pyramid_builder * builder, const char * path, int root, MPI_Comm comm );
+void free_pyramid_builder( struct pyramid_builder * builder );
+
+#endif
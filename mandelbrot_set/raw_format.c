@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "raw_format.h"
+
+void init_raw_header( struct raw_header * header, int x_resolution, int y_resolution, int limit ){
+	memset( header, 0, sizeof(*header) );
+	strcpy( header->magic, RAW_MAGIC );
+	header->x_resolution = x_resolution;
+	header->y_resolution = y_resolution;
+	header->limit = limit;
+}
+
+long long raw_data_offset( const struct raw_header * header ){
+	return sizeof(struct raw_header) + sizeof(double) * ((long long)header->x_resolution + header->y_resolution);
+}
+
+long long raw_row_offset( const struct raw_header * header, int y_i ){
+	return raw_data_offset( header ) + sizeof(int) * (long long)y_i * header->x_resolution;
+}
+
+// The centers are kept as the text they were given in, which is what every rank
+// parses, so they must fit in JOURNAL_CENTER_SIZE.
+void init_journal_header( struct journal_header * header, int x_resolution, int y_resolution, int limit, int precision, double scale, const char * center_x, const char * center_y ){
+	memset( header, 0, sizeof(*header) );
+	strcpy( header->magic, JOURNAL_MAGIC );
+	header->x_resolution = x_resolution;
+	header->y_resolution = y_resolution;
+	header->limit = limit;
+	header->precision = precision;
+	header->scale = scale;
+	strncpy( header->center_x, center_x, JOURNAL_CENTER_SIZE - 1 );
+	strncpy( header->center_y, center_y, JOURNAL_CENTER_SIZE - 1 );
+}
+
+// Both headers must have been made by init_journal_header, or read from a file
+// it wrote, so their padding is zeroed.
+int same_journal( const struct journal_header * a, const struct journal_header * b ){
+	return memcmp( a, b, sizeof(*a) ) == 0;
+}
+
+void init_orbits_header( struct orbits_header * header, int x_resolution, int y_resolution, int limit, int precision, double scale, const char * center_x, const char * center_y ){
+	memset( header, 0, sizeof(*header) );
+	strcpy( header->magic, ORBITS_MAGIC );
+	header->x_resolution = x_resolution;
+	header->y_resolution = y_resolution;
+	header->limit = limit;
+	header->precision = precision;
+	header->scale = scale;
+	strncpy( header->center_x, center_x, JOURNAL_CENTER_SIZE - 1 );
+	strncpy( header->center_y, center_y, JOURNAL_CENTER_SIZE - 1 );
+}
+
+// Whether two sets of orbits are of the same pixels, whatever their limits.
+int same_orbits_region( const struct orbits_header * a, const struct orbits_header * b ){
+	return memcmp( a->magic, b->magic, sizeof(a->magic) ) == 0
+		&& a->x_resolution == b->x_resolution && a->y_resolution == b->y_resolution
+		&& a->precision == b->precision && a->scale == b->scale
+		&& memcmp( a->center_x, b->center_x, JOURNAL_CENTER_SIZE ) == 0
+		&& memcmp( a->center_y, b->center_y, JOURNAL_CENTER_SIZE ) == 0;
+}
+
+// Orders saved orbits by pixel, for qsort.
+int compare_saved_orbits( const void * a, const void * b ){
+	long long pixel_a = ((const struct saved_orbit*)a)->pixel;
+	long long pixel_b = ((const struct saved_orbit*)b)->pixel;
+	return (pixel_a > pixel_b) - (pixel_a < pixel_b);
+}
+
+// Read the header and coordinates of a raw file. Returns 0 on success and -1 if
+// the file could not be read or is not in this format.
+int open_raw_file( const char * path, struct raw_file * raw ){
+	raw->x = NULL;
+	raw->y = NULL;
+	raw->file = fopen( path, "rb" );
+	if( raw->file == NULL ){
+		return -1;
+	}
+	struct raw_header * header = &raw->header;
+	if( fread( header, sizeof(*header), 1, raw->file ) != 1
+			|| memcmp( header->magic, RAW_MAGIC, sizeof(RAW_MAGIC) ) != 0
+			|| header->x_resolution <= 0 || header->y_resolution <= 0 ){
+		close_raw_file( raw );
+		return -1;
+	}
+	raw->x = (double*)malloc(sizeof(double)*header->x_resolution);
+	raw->y = (double*)malloc(sizeof(double)*header->y_resolution);
+	if( fread( raw->x, sizeof(double), header->x_resolution, raw->file ) != (size_t)header->x_resolution
+			|| fread( raw->y, sizeof(double), header->y_resolution, raw->file ) != (size_t)header->y_resolution ){
+		close_raw_file( raw );
+		return -1;
+	}
+	return 0;
+}
+
+// Read rows first_y_i up to max_y_i into iterations. Returns 0 on success and -1
+// if the file is too short.
+int read_raw_rows( struct raw_file * raw, int first_y_i, int max_y_i, int * iterations ){
+	long long num_pixels = (long long)(max_y_i - first_y_i) * raw->header.x_resolution;
+	if( fseek( raw->file, raw_row_offset( &raw->header, first_y_i ), SEEK_SET ) != 0
+			|| fread( iterations, sizeof(int), num_pixels, raw->file ) != (size_t)num_pixels ){
+		return -1;
+	}
+	return 0;
+}
+
+void close_raw_file( struct raw_file * raw ){
+	if( raw->file != NULL ){
+		fclose( raw->file );
+		raw->file = NULL;
+	}
+	free(raw->x);
+	free(raw->y);
+	raw->x = NULL;
+	raw->y = NULL;
+}
@@ -0,0 +1,96 @@
+#ifndef RAW_FORMAT_H
+#define RAW_FORMAT_H
+
+#include <stdio.h>
+
+#define RAW_MAGIC "MBRAW01"
+#define JOURNAL_MAGIC "MBJRN01"
+// Appended to the name of a raw file for the name of its journal.
+#define JOURNAL_SUFFIX ".journal"
+#define ORBITS_MAGIC "MBORB01"
+// Appended to the name of a raw file for the name of its saved orbits.
+#define ORBITS_SUFFIX ".orbits"
+// Refined orbits are written under this name, then renamed over the old ones.
+#define NEW_ORBITS_SUFFIX ORBITS_SUFFIX ".new"
+// Rows handed to a rank at a time, and written before they are journaled.
+#define RAW_ROWS_PER_BATCH 16
+// Longest center coordinate, as text, a journal records.
+#define JOURNAL_CENTER_SIZE 128
+
+// A grid of iteration counts at a fixed width per pixel, so any row can be
+// written or read in place. The file is laid out as
+//   struct raw_header
+//   double x[x_resolution], the real part of each column
+//   double y[y_resolution], the imaginary part of each row
+//   int iterations[y_resolution][x_resolution]
+// in the byte order of the machine that wrote it.
+struct raw_header {
+	char magic[8];
+	int x_resolution;
+	int y_resolution;
+	int limit;
+};
+
+// Alongside a raw file, which of its rows have been written, so a render that
+// died part way can be resumed. The file is laid out as
+//   struct journal_header
+//   char done[y_resolution], non zero once the row is safely in the raw file
+// The header holds everything that decides the counts, so a journal is only
+// resumed by a render of the same region.
+struct journal_header {
+	char magic[8];
+	int x_resolution;
+	int y_resolution;
+	int limit;
+	int precision;
+	double scale;
+	char center_x[JOURNAL_CENTER_SIZE];
+	char center_y[JOURNAL_CENTER_SIZE];
+};
+
+// Alongside a raw file, where z was left for every pixel that reached the
+// limit, so a render at a higher limit only has to carry those pixels on. The
+// file is laid out as
+//   struct orbits_header
+//   struct saved_orbit orbits[num_orbits]
+// Only double precision is saved, since its iteration can be carried on to give
+// exactly the counts of rendering again from scratch.
+struct orbits_header {
+	char magic[8];
+	int x_resolution;
+	int y_resolution;
+	int limit;
+	int precision;
+	double scale;
+	char center_x[JOURNAL_CENTER_SIZE];
+	char center_y[JOURNAL_CENTER_SIZE];
+	long long num_orbits;
+};
+
+struct saved_orbit {
+	// y_i * x_resolution + x_i
+	long long pixel;
+	double z_re;
+	double z_im;
+};
+
+struct raw_file {
+	FILE * file;
+	struct raw_header header;
+	double * x;
+	double * y;
+};
+
+void init_raw_header( struct raw_header * header, int x_resolution, int y_resolution, int limit );
+long long raw_data_offset( const struct raw_header * header );
+long long raw_row_offset( const struct raw_header * header, int y_i );
+void init_journal_header( struct journal_header * header, int x_resolution, int y_resolution, int limit, int precision, double scale, const char * center_x, const char * center_y );
+int same_journal( const struct journal_header * a, const struct journal_header * b );
+void init_orbits_header( struct orbits_header * header, int x_resolution, int y_resolution, int limit, int precision, double scale, const char * center_x, const char * center_y );
+int same_orbits_region( const struct orbits_header * a, const struct orbits_header * b );
+int compare_saved_orbits( const void * a, const void * b );
+int open_raw_file( const char * path, struct raw_file * raw );
+int read_raw_rows( struct raw_file * raw, int first_y_i, int max_y_i, int * iterations );
+void close_raw_file( struct raw_file * raw );
+
+#endif
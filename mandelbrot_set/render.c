@@ -0,0 +1,273 @@
+#include <complex.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mandelbrot_set.h"
+#include "perturbation.h"
+#include "render.h"
+
+// Pixel spacing, relative to the magnitude of the coordinates, below which
+// doubles can no longer tell neighbouring pixels apart reliably.
+#define DEEP_ZOOM_THRESHOLD 1e-12
+// Pixel spacing, relative to the magnitude of the coordinates, below which even
+// a double-double center can not tell neighbouring pixels apart.
+#define DOUBLE_DOUBLE_THRESHOLD 1e-30
+// How close, as a fraction of the pixel spacing, a row's reflection in the real
+// axis must come to another row for the two to share iteration counts.
+#define MIRROR_TOLERANCE 1e-9
+
+void init_viewport( struct viewport * viewport, struct double_double center_x, struct double_double center_y, double scale, int x_resolution, int y_resolution ){
+	viewport->center_x = center_x;
+	viewport->center_y = center_y;
+	viewport->scale = scale;
+	viewport->x_resolution = x_resolution;
+	viewport->y_resolution = y_resolution;
+	viewport->x_step = scale / x_resolution;
+	viewport->y_step = scale / y_resolution;
+	viewport->delta_min = -scale / 2;
+	viewport->margin = 0;
+	viewport->snapped = 0;
+	viewport->lattice_relative = 0;
+	viewport->x_lattice = 0;
+	viewport->y_lattice = 0;
+	// With the default viewport these are exactly -2.0 and -1.5, so the pixel
+	// coordinates match those of the original fixed plane bit for bit.
+	viewport->x_min = dd_to_double( dd_add( center_x, dd_from_double( viewport->delta_min ) ) );
+	viewport->y_min = dd_to_double( dd_add( center_y, dd_from_double( viewport->delta_min ) ) );
+}
+
+double viewport_x( const struct viewport * viewport, int x_i ){
+	if( viewport->snapped ){
+		double offset = (viewport->x_lattice + x_i) * viewport->x_step;
+		if( viewport->lattice_relative ){
+			return dd_to_double( dd_add( viewport->center_x, dd_from_double( offset ) ) );
+		}
+		return offset;
+	}
+	return viewport->x_min + x_i * viewport->x_step;
+}
+
+double viewport_y( const struct viewport * viewport, int y_i ){
+	if( viewport->snapped ){
+		double offset = (viewport->y_lattice + y_i) * viewport->y_step;
+		if( viewport->lattice_relative ){
+			return dd_to_double( dd_add( viewport->center_y, dd_from_double( offset ) ) );
+		}
+		return offset;
+	}
+	return viewport->y_min + y_i * viewport->y_step;
+}
+
+// Offsets of a pixel from the center, as used by perturbation.
+double viewport_delta_x( const struct viewport * viewport, int x_i ){
+	if( viewport->snapped && viewport->lattice_relative ){
+		return (viewport->x_lattice + x_i) * viewport->x_step;
+	}
+	return viewport->delta_min + x_i * viewport->x_step;
+}
+
+double viewport_delta_y( const struct viewport * viewport, int y_i ){
+	if( viewport->snapped && viewport->lattice_relative ){
+		return (viewport->y_lattice + y_i) * viewport->y_step;
+	}
+	return viewport->delta_min + y_i * viewport->y_step;
+}
+
+// Move the viewport by less than a pixel so its pixels sit on a lattice of the
+// pixel spacing. Pixel values then only depend on their lattice index, so renders
+// that overlap, rather than match exactly, still share them. The lattice is
+// anchored at the origin, or at the center for perturbation, where absolute
+// coordinates are too large to index.
+void snap_viewport( struct viewport * viewport, int relative ){
+	viewport->lattice_relative = relative;
+	if( relative ){
+		viewport->x_lattice = llround( viewport->delta_min / viewport->x_step );
+		viewport->y_lattice = llround( viewport->delta_min / viewport->y_step );
+	} else {
+		viewport->x_lattice = llround( viewport->x_min / viewport->x_step );
+		viewport->y_lattice = llround( viewport->y_min / viewport->y_step );
+	}
+	viewport->snapped = 1;
+	viewport->x_min = viewport_x( viewport, 0 );
+	viewport->y_min = viewport_y( viewport, 0 );
+}
+
+// Returns -1 if name is not a known precision.
+int parse_precision( const char * name ){
+	if( strcmp( name, "auto" ) == 0 ){
+		return PRECISION_AUTO;
+	} else if( strcmp( name, "double" ) == 0 ){
+		return PRECISION_DOUBLE;
+	} else if( strcmp( name, "double-double" ) == 0 ){
+		return PRECISION_DOUBLE_DOUBLE;
+	} else if( strcmp( name, "perturbation" ) == 0 ){
+		return PRECISION_PERTURBATION;
+	}
+	return -1;
+}
+
+// Whether a precision positions pixels by their offset from the center, because
+// absolute coordinates in doubles are too coarse to tell the pixels apart.
+int offsets_from_center( int precision ){
+	return precision == PRECISION_PERTURBATION || precision == PRECISION_DOUBLE_DOUBLE;
+}
+
+int select_precision( const struct viewport * viewport, int requested ){
+	if( requested != PRECISION_AUTO ){
+		return requested;
+	}
+	double magnitude = fmax( fabs( viewport->center_x.hi ), fabs( viewport->center_y.hi ) ) + viewport->scale;
+	double spacing = fmin( viewport->x_step, viewport->y_step );
+	// Pick the cheapest precision that is still accurate. Iterating directly in
+	// double-double is never the cheapest, so is only used when asked for.
+	if( spacing < magnitude * DEEP_ZOOM_THRESHOLD ){
+		return PRECISION_PERTURBATION;
+	}
+	return PRECISION_DOUBLE;
+}
+
+// Whether the pixels of a viewport are closer together than any precision can
+// resolve, so a render of it would only repeat the same few pixels.
+int viewport_too_deep( const struct viewport * viewport ){
+	double magnitude = fmax( fabs( viewport->center_x.hi ), fabs( viewport->center_y.hi ) ) + viewport->scale;
+	double spacing = fmin( viewport->x_step, viewport->y_step );
+	return spacing < magnitude * DOUBLE_DOUBLE_THRESHOLD;
+}
+
+// The farthest any pixel, including the margin, gets from the center is the
+// corner of the viewport.
+static double max_delta( const struct viewport * viewport ){
+	double margin = viewport->margin * fmax( viewport->x_step, viewport->y_step );
+	return ( fabs( viewport->delta_min ) + margin ) * sqrt(2.0);
+}
+
+// compute_orbit lets MPI ranks skip computing the reference orbit when it will
+// be broadcast to them instead.
+void init_renderer( struct renderer * renderer, const struct viewport * viewport, int limit, int precision, int compute_orbit ){
+	renderer->viewport = *viewport;
+	renderer->limit = limit;
+	renderer->precision = select_precision( viewport, precision );
+	renderer->orbit.z = NULL;
+	renderer->orbit.length = 0;
+	renderer->owns_orbit = 1;
+	if( renderer->precision == PRECISION_PERTURBATION && compute_orbit ){
+		compute_reference_orbit( viewport->center_x, viewport->center_y, limit, max_delta( viewport ), &renderer->orbit );
+	}
+}
+
+// Use an orbit computed for the same center and limit, without copying it. Only
+// the series approximation is recomputed for this viewport.
+void share_reference_orbit( struct renderer * renderer, const struct reference_orbit * orbit ){
+	renderer->orbit = *orbit;
+	renderer->owns_orbit = 0;
+	approximate_series( &renderer->orbit, renderer->limit, max_delta( &renderer->viewport ) );
+}
+
+// Full precision coordinates of a pixel, for iterating in double-double.
+static struct double_double viewport_x_dd( const struct viewport * viewport, int x_i ){
+	if( viewport->snapped && !viewport->lattice_relative ){
+		return dd_from_double( viewport_x( viewport, x_i ) );
+	}
+	return dd_add( viewport->center_x, dd_from_double( viewport_delta_x( viewport, x_i ) ) );
+}
+
+static struct double_double viewport_y_dd( const struct viewport * viewport, int y_i ){
+	if( viewport->snapped && !viewport->lattice_relative ){
+		return dd_from_double( viewport_y( viewport, y_i ) );
+	}
+	return dd_add( viewport->center_y, dd_from_double( viewport_delta_y( viewport, y_i ) ) );
+}
+
+int render_pixel( const struct renderer * renderer, int x_i, int y_i ){
+	const struct viewport * viewport = &renderer->viewport;
+	if( renderer->precision == PRECISION_PERTURBATION ){
+		double complex delta_c = viewport_delta_x( viewport, x_i ) + viewport_delta_y( viewport, y_i ) * I;
+		return in_mandelbrot_set_perturbed( &renderer->orbit, delta_c, renderer->limit );
+	} else if( renderer->precision == PRECISION_DOUBLE_DOUBLE ){
+		return escape_time_double_double( viewport_x_dd( viewport, x_i ), viewport_y_dd( viewport, y_i ), renderer->limit );
+	}
+	return escape_time_double( viewport_x( viewport, x_i ), viewport_y( viewport, y_i ), renderer->limit );
+}
+
+void render_row( const struct renderer * renderer, int y_i, int * iterations ){
+	const struct viewport * viewport = &renderer->viewport;
+	if( renderer->precision == PRECISION_PERTURBATION ){
+		double delta_y = viewport_delta_y( viewport, y_i );
+		for( int x_i=0; x_i<viewport->x_resolution; x_i++ ){
+			double delta_x = viewport_delta_x( viewport, x_i );
+			iterations[x_i] = in_mandelbrot_set_perturbed( &renderer->orbit, delta_x + delta_y * I, renderer->limit );
+		}
+	} else if( renderer->precision == PRECISION_DOUBLE_DOUBLE ){
+		struct double_double y = viewport_y_dd( viewport, y_i );
+		for( int x_i=0; x_i<viewport->x_resolution; x_i++ ){
+			iterations[x_i] = escape_time_double_double( viewport_x_dd( viewport, x_i ), y, renderer->limit );
+		}
+	} else {
+		double y = viewport_y( viewport, y_i );
+		for( int x_i=0; x_i<viewport->x_resolution; x_i++ ){
+			iterations[x_i] = escape_time_double( viewport_x( viewport, x_i ), y, renderer->limit );
+		}
+	}
+}
+
+// Render a row in double precision, as render_row does, keeping where z was left
+// for each pixel so those that reached the limit can be carried on to a higher
+// one. Only for PRECISION_DOUBLE.
+void render_row_orbits( const struct renderer * renderer, int y_i, int * iterations, double * z_re, double * z_im ){
+	const struct viewport * viewport = &renderer->viewport;
+	double y = viewport_y( viewport, y_i );
+	for( int x_i=0; x_i<viewport->x_resolution; x_i++ ){
+		z_re[x_i] = 0.0;
+		z_im[x_i] = 0.0;
+		iterations[x_i] = continue_escape_time_double( viewport_x( viewport, x_i ), y, &z_re[x_i], &z_im[x_i], 0, renderer->limit );
+	}
+}
+
+// The set is symmetric about the real axis, so a row whose reflection is also a
+// row of the viewport has the same iteration counts as it. Returns the index of
+// that row, or -1 if the reflection falls between rows or outside the viewport.
+// The counts are exactly those of the reflected coordinates, which may differ
+// from the row's own by rounding.
+int mirror_row( const struct renderer * renderer, int y_i ){
+	const struct viewport * viewport = &renderer->viewport;
+	double y, first_y;
+	if( offsets_from_center( renderer->precision ) ){
+		// Offsets are only reflected exactly about a center on the real axis.
+		if( viewport->center_y.hi != 0.0 || viewport->center_y.lo != 0.0 ){
+			return -1;
+		}
+		y = viewport_delta_y( viewport, y_i );
+		first_y = viewport_delta_y( viewport, 0 );
+	} else {
+		y = viewport_y( viewport, y_i );
+		first_y = viewport_y( viewport, 0 );
+	}
+	long long mirror_y_i = llround( (-y - first_y) / viewport->y_step );
+	if( mirror_y_i < 0 || mirror_y_i >= viewport->y_resolution ){
+		return -1;
+	}
+	double mirror_y;
+	if( offsets_from_center( renderer->precision ) ){
+		mirror_y = viewport_delta_y( viewport, mirror_y_i );
+	} else {
+		mirror_y = viewport_y( viewport, mirror_y_i );
+	}
+	if( fabs( mirror_y + y ) > MIRROR_TOLERANCE * viewport->y_step ){
+		return -1;
+	}
+	return mirror_y_i;
+}
+
+// Whether a row has to be computed when rows are copied from their reflection.
+// Of each pair of mirrored rows, the first is computed.
+int is_unique_row( const struct renderer * renderer, int y_i ){
+	int mirror_y_i = mirror_row( renderer, y_i );
+	return mirror_y_i < 0 || mirror_y_i >= y_i;
+}
+
+void free_renderer( struct renderer * renderer ){
+	if( renderer->orbit.z != NULL && renderer->owns_orbit ){
+		free_reference_orbit( &renderer->orbit );
+	}
+}
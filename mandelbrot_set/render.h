@@ -0,0 +1,67 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "double_double.h"
+#include "perturbation.h"
+#include "precision.h"
+
+#define DEFAULT_CENTER_X "-0.5"
+#define DEFAULT_CENTER_Y "0.0"
+#define DEFAULT_SCALE 3.0
+
+
+// The square region of the complex plane being rendered.
+struct viewport {
+	struct double_double center_x;
+	struct double_double center_y;
+	// Width and height of the region.
+	double scale;
+	int x_resolution;
+	int y_resolution;
+	// Coordinates of the first pixel and the spacing between pixels.
+	double x_min;
+	double y_min;
+	double x_step;
+	double y_step;
+	// Offset of the first pixel from the center, used by perturbation.
+	double delta_min;
+	// Pixels beyond the edges that may also be rendered, e.g. to fill whole
+	// cache tiles. The series approximation has to stay valid out to them.
+	int margin;
+	// Set by snap_viewport. Pixel x_i then lies at (x_lattice + x_i) * x_step,
+	// measured from the origin, or from the center if lattice_relative is set.
+	int snapped;
+	int lattice_relative;
+	long long x_lattice;
+	long long y_lattice;
+};
+
+struct renderer {
+	struct viewport viewport;
+	int limit;
+	int precision;
+	struct reference_orbit orbit;
+	// Whether free_renderer should free the orbit, or it is shared.
+	int owns_orbit;
+};
+
+void init_viewport( struct viewport * viewport, struct double_double center_x, struct double_double center_y, double scale, int x_resolution, int y_resolution );
+double viewport_x( const struct viewport * viewport, int x_i );
+double viewport_y( const struct viewport * viewport, int y_i );
+double viewport_delta_x( const struct viewport * viewport, int x_i );
+double viewport_delta_y( const struct viewport * viewport, int y_i );
+void snap_viewport( struct viewport * viewport, int relative );
+int parse_precision( const char * name );
+int offsets_from_center( int precision );
+int select_precision( const struct viewport * viewport, int requested );
+int viewport_too_deep( const struct viewport * viewport );
+void init_renderer( struct renderer * renderer, const struct viewport * viewport, int limit, int precision, int compute_orbit );
+void share_reference_orbit( struct renderer * renderer, const struct reference_orbit * orbit );
+int render_pixel( const struct renderer * renderer, int x_i, int y_i );
+void render_row( const struct renderer * renderer, int y_i, int * iterations );
+void render_row_orbits( const struct renderer * renderer, int y_i, int * iterations, double * z_re, double * z_im );
+int mirror_row( const struct renderer * renderer, int y_i );
+int is_unique_row( const struct renderer * renderer, int y_i );
+void free_renderer( struct renderer * renderer );
+
+#endif
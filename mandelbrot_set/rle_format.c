@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rle_format.h"
+
+// Most bytes a variable length encoding of a 64 bit integer takes.
+#define MAX_VARINT_LENGTH 10
+
+void init_rle_header( struct rle_header * header, int x_resolution, int y_resolution, int limit, int rows_per_chunk ){
+	memset( header, 0, sizeof(*header) );
+	strcpy( header->magic, RLE_MAGIC );
+	header->x_resolution = x_resolution;
+	header->y_resolution = y_resolution;
+	header->limit = limit;
+	header->rows_per_chunk = rows_per_chunk;
+	header->num_chunks = (y_resolution + rows_per_chunk - 1) / rows_per_chunk;
+}
+
+long long rle_index_offset( const struct rle_header * header ){
+	return sizeof(struct rle_header) + sizeof(double) * ((long long)header->x_resolution + header->y_resolution);
+}
+
+long long rle_data_offset( const struct rle_header * header ){
+	return rle_index_offset( header ) + sizeof(long long) * ((long long)header->num_chunks + 1);
+}
+
+// An upper bound on the encoded size of num_pixels counts, reached when no two
+// neighbouring pixels are the same.
+long long rle_max_size( long long num_pixels ){
+	return num_pixels * 2 * MAX_VARINT_LENGTH;
+}
+
+// Write value 7 bits at a time, low bits first, with the high bit of each byte
+// set if more follow. Returns the number of bytes written.
+static int write_varint( unsigned long long value, unsigned char * buffer ){
+	int length = 0;
+	while( value >= 0x80 ){
+		buffer[length] = (value & 0x7f) | 0x80;
+		value >>= 7;
+		length++;
+	}
+	buffer[length] = value;
+	return length + 1;
+}
+
+// Returns the number of bytes read, or 0 if the buffer ends mid value.
+static int read_varint( const unsigned char * buffer, long long size, unsigned long long * value ){
+	*value = 0;
+	for( int length=0; length<size && length<MAX_VARINT_LENGTH; length++ ){
+		*value |= (unsigned long long)(buffer[length] & 0x7f) << (7 * length);
+		if( (buffer[length] & 0x80) == 0 ){
+			return length + 1;
+		}
+	}
+	return 0;
+}
+
+// Returns the number of bytes written to buffer, which must hold at least
+// rle_max_size( num_pixels ) bytes.
+long long rle_encode( const int * iterations, long long num_pixels, unsigned char * buffer ){
+	long long length = 0;
+	long long previous = 0;
+	long long pixel_i = 0;
+	while( pixel_i < num_pixels ){
+		long long run_end = pixel_i + 1;
+		while( run_end < num_pixels && iterations[run_end] == iterations[pixel_i] ){
+			run_end++;
+		}
+		// Store the difference zigzagged, so small steps either way stay small.
+		long long difference = iterations[pixel_i] - previous;
+		unsigned long long zigzag = ((unsigned long long)difference << 1) ^ (unsigned long long)(difference >> 63);
+		length += write_varint( zigzag, buffer + length );
+		length += write_varint( run_end - pixel_i, buffer + length );
+		previous = iterations[pixel_i];
+		pixel_i = run_end;
+	}
+	return length;
+}
+
+// Returns 0 if buffer held exactly num_pixels counts, and -1 otherwise.
+int rle_decode( const unsigned char * buffer, long long size, int * iterations, long long num_pixels ){
+	long long position = 0;
+	long long previous = 0;
+	long long pixel_i = 0;
+	while( position < size ){
+		unsigned long long zigzag, run_length;
+		int length = read_varint( buffer + position, size - position, &zigzag );
+		if( length == 0 ){
+			return -1;
+		}
+		position += length;
+		length = read_varint( buffer + position, size - position, &run_length );
+		if( length == 0 || run_length == 0 || run_length > (unsigned long long)(num_pixels - pixel_i) ){
+			return -1;
+		}
+		position += length;
+		long long value = previous + (long long)((zigzag >> 1) ^ -(zigzag & 1));
+		for( unsigned long long run_i=0; run_i<run_length; run_i++ ){
+			iterations[pixel_i] = value;
+			pixel_i++;
+		}
+		previous = value;
+	}
+	return pixel_i == num_pixels ? 0 : -1;
+}
+
+// Read the header, coordinates and chunk index of an encoded file. Returns 0 on
+// success and -1 if the file could not be read or is not in this format.
+int open_rle_file( const char * path, struct rle_file * rle ){
+	rle->x = NULL;
+	rle->y = NULL;
+	rle->index = NULL;
+	rle->file = fopen( path, "rb" );
+	if( rle->file == NULL ){
+		return -1;
+	}
+	struct rle_header * header = &rle->header;
+	if( fread( header, sizeof(*header), 1, rle->file ) != 1
+			|| memcmp( header->magic, RLE_MAGIC, sizeof(RLE_MAGIC) ) != 0
+			|| header->x_resolution <= 0 || header->y_resolution <= 0 || header->rows_per_chunk <= 0
+			|| header->num_chunks != (header->y_resolution + header->rows_per_chunk - 1) / header->rows_per_chunk ){
+		close_rle_file( rle );
+		return -1;
+	}
+	rle->x = (double*)malloc(sizeof(double)*header->x_resolution);
+	rle->y = (double*)malloc(sizeof(double)*header->y_resolution);
+	rle->index = (long long*)malloc(sizeof(long long)*(header->num_chunks+1));
+	if( fread( rle->x, sizeof(double), header->x_resolution, rle->file ) != (size_t)header->x_resolution
+			|| fread( rle->y, sizeof(double), header->y_resolution, rle->file ) != (size_t)header->y_resolution
+			|| fread( rle->index, sizeof(long long), header->num_chunks + 1, rle->file ) != (size_t)header->num_chunks + 1 ){
+		close_rle_file( rle );
+		return -1;
+	}
+	return 0;
+}
+
+// Decode rows first_y_i up to max_y_i into iterations, reading only the chunks
+// they fall in. Returns 0 on success and -1 if a chunk is missing or corrupt.
+int read_rle_rows( struct rle_file * rle, int first_y_i, int max_y_i, int * iterations ){
+	const struct rle_header * header = &rle->header;
+	long long chunk_pixels = (long long)header->rows_per_chunk * header->x_resolution;
+	int * chunk = (int*)malloc(sizeof(int)*chunk_pixels);
+	unsigned char * encoded = NULL;
+	long long encoded_capacity = 0;
+	int status = 0;
+
+	for( int chunk_i=first_y_i/header->rows_per_chunk; status==0 && chunk_i<header->num_chunks; chunk_i++ ){
+		int chunk_start = chunk_i * header->rows_per_chunk;
+		if( chunk_start >= max_y_i ){
+			break;
+		}
+		int chunk_end = chunk_start + header->rows_per_chunk;
+		if( chunk_end > header->y_resolution ){
+			chunk_end = header->y_resolution;
+		}
+		long long size = rle->index[chunk_i+1] - rle->index[chunk_i];
+		if( size < 0 || size > rle_max_size( chunk_pixels ) ){
+			status = -1;
+			break;
+		}
+		if( size > encoded_capacity ){
+			encoded_capacity = size;
+			encoded = (unsigned char*)realloc(encoded, encoded_capacity);
+		}
+		if( fseek( rle->file, rle->index[chunk_i], SEEK_SET ) != 0
+				|| fread( encoded, 1, size, rle->file ) != (size_t)size
+				|| rle_decode( encoded, size, chunk, (long long)(chunk_end - chunk_start) * header->x_resolution ) != 0 ){
+			status = -1;
+			break;
+		}
+
+		// Copy out the rows of this chunk that were asked for.
+		int copy_start = chunk_start > first_y_i ? chunk_start : first_y_i;
+		int copy_end = chunk_end < max_y_i ? chunk_end : max_y_i;
+		memcpy(
+			iterations + (long long)(copy_start - first_y_i) * header->x_resolution,
+			chunk + (long long)(copy_start - chunk_start) * header->x_resolution,
+			sizeof(int) * (copy_end - copy_start) * header->x_resolution
+		);
+	}
+
+	free(chunk);
+	free(encoded);
+	return status;
+}
+
+void close_rle_file( struct rle_file * rle ){
+	if( rle->file != NULL ){
+		fclose( rle->file );
+		rle->file = NULL;
+	}
+	free(rle->x);
+	free(rle->y);
+	free(rle->index);
+	rle->x = NULL;
+	rle->y = NULL;
+	rle->index = NULL;
+}
@@ -0,0 +1,49 @@
+#ifndef RLE_FORMAT_H
+#define RLE_FORMAT_H
+
+#include <stdio.h>
+
+#define RLE_MAGIC "MBRLE01"
+// Rows in each chunk of the file. Chunks are encoded independently, so any
+// range of rows can be decoded by reading only the chunks that hold it.
+#define RLE_ROWS_PER_CHUNK 16
+
+// A run length encoded grid of iteration counts. The file is laid out as
+//   struct rle_header
+//   double x[x_resolution], the real part of each column
+//   double y[y_resolution], the imaginary part of each row
+//   long long index[num_chunks+1], the file offset of each chunk and of the end
+//   the chunks themselves
+// in the byte order of the machine that wrote it.
+// A chunk is the runs of equal counts over its pixels in row order. Each run is
+// stored as the difference from the previous run's count followed by its length,
+// both as variable length integers, so the interior of the set and the slowly
+// changing bands outside it take only a few bytes per run.
+struct rle_header {
+	char magic[8];
+	int x_resolution;
+	int y_resolution;
+	int limit;
+	int rows_per_chunk;
+	int num_chunks;
+};
+
+struct rle_file {
+	FILE * file;
+	struct rle_header header;
+	double * x;
+	double * y;
+	long long * index;
+};
+
+void init_rle_header( struct rle_header * header, int x_resolution, int y_resolution, int limit, int rows_per_chunk );
+long long rle_index_offset( const struct rle_header * header );
+long long rle_data_offset( const struct rle_header * header );
+long long rle_max_size( long long num_pixels );
+long long rle_encode( const int * iterations, long long num_pixels, unsigned char * buffer );
+int rle_decode( const unsigned char * buffer, long long size, int * iterations, long long num_pixels );
+int open_rle_file( const char * path, struct rle_file * rle );
+int read_rle_rows( struct rle_file * rle, int first_y_i, int max_y_i, int * iterations );
+void close_rle_file( struct rle_file * rle );
+
+#endif
@@ -1,9 +1,16 @@
 #include <argp.h>
 #include <complex.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#include "double_double.c"
 #include "mandelbrot_set.c"
+#include "perturbation.c"
+#include "render.c"
+#include "tile_cache.c"
+#include "csv_format.c"
 
 static char doc[] = "mandelbrot_set -- A simple sequential C script that calculates the Mandelbrot set.";
 
@@ -12,6 +19,13 @@ static char args_doc[] = "Limit X resolution Y resolution";
 static struct argp_option options[] = {
 	{ "verbose", 'v', 0, 0, "Provide verbose output." },
 	{ "output", 'o', "FILE", 0, "Output to specified file instead of standard mandelbrot_set.csv." },
+	{ "center-x", 'x', "REAL", 0, "Real component of the center of the viewport. Defaults to -0.5." },
+	{ "center-y", 'y', "IMAGINARY", 0, "Imaginary component of the center of the viewport. Defaults to 0.0." },
+	{ "scale", 's', "SCALE", 0, "Width and height of the viewport. Defaults to 3.0." },
+	{ "precision", 'p', "PRECISION", 0, "One of auto, double, double-double or perturbation. auto uses double, and perturbation for deep zooms." },
+	{ "cache", 'c', "DIRECTORY", 0, "Reuse tiles of earlier renders stored in DIRECTORY, and store new ones there. Moves the viewport by up to half a pixel so overlapping renders share tiles." },
+	{ "cache-size", 'C', "MEGABYTES", 0, "Evict the least recently used tiles once the cache exceeds this size. Defaults to 1024." },
+	{ "symmetry", 'r', 0, 0, "Copy rows whose reflection in the real axis is also in the viewport instead of computing them again." },
 	{ 0 }
 };
 
@@ -19,6 +33,13 @@ struct arguments {
 	char *args[3];
 	int verbose;
 	char *output_file;
+	struct double_double center_x;
+	struct double_double center_y;
+	double scale;
+	int precision;
+	char *cache_directory;
+	long long cache_megabytes;
+	int symmetry;
 };
 
 static error_t parse_opt( int key, char *arg, struct argp_state *state) {
@@ -30,6 +51,40 @@ static error_t parse_opt( int key, char *arg, struct argp_state *state) {
 		case 'o':
       arguments->output_file = arg;
       break;
+		case 'x':
+			if( dd_parse( arg, &arguments->center_x ) != 0 ){
+				argp_error( state, "invalid center-x '%s'", arg );
+			}
+			break;
+		case 'y':
+			if( dd_parse( arg, &arguments->center_y ) != 0 ){
+				argp_error( state, "invalid center-y '%s'", arg );
+			}
+			break;
+		case 's':
+			arguments->scale = atof(arg);
+			if( arguments->scale <= 0.0 ){
+				argp_error( state, "scale must be positive" );
+			}
+			break;
+		case 'p':
+			arguments->precision = parse_precision( arg );
+			if( arguments->precision < 0 ){
+				argp_error( state, "unknown precision '%s'", arg );
+			}
+			break;
+		case 'c':
+			arguments->cache_directory = arg;
+			break;
+		case 'C':
+			arguments->cache_megabytes = atoll(arg);
+			if( arguments->cache_megabytes < 0 ){
+				argp_error( state, "cache-size can not be negative" );
+			}
+			break;
+		case 'r':
+			arguments->symmetry = 1;
+			break;
 		case ARGP_KEY_ARG:
 			if( state->arg_num >= 3 ){
 				argp_usage( state );
@@ -57,6 +112,13 @@ int main(int argc, char **argv){
 	struct arguments arguments;
 	arguments.verbose = 0;
 	arguments.output_file = "mandelbrot_set.csv";
+	dd_parse( DEFAULT_CENTER_X, &arguments.center_x );
+	dd_parse( DEFAULT_CENTER_Y, &arguments.center_y );
+	arguments.scale = DEFAULT_SCALE;
+	arguments.precision = PRECISION_AUTO;
+	arguments.cache_directory = NULL;
+	arguments.cache_megabytes = DEFAULT_CACHE_MEGABYTES;
+	arguments.symmetry = 0;
 
 	argp_parse (&argp, argc, argv, 0, 0, &arguments);
 
@@ -66,28 +128,85 @@ int main(int argc, char **argv){
 	verbose = arguments.verbose;
 	output_file = arguments.output_file;
 
-	double x_step = 3.0 / x_resolution;
-	double y_step = 3.0 / y_resolution;
+	struct viewport viewport;
+	init_viewport( &viewport, arguments.center_x, arguments.center_y, arguments.scale, x_resolution, y_resolution );
+	if( viewport_too_deep( &viewport ) ){
+		fprintf(stderr, "The pixels are too close together for this center to tell them apart; use a larger scale or fewer pixels.\n");
+		return 1;
+	}
+	if( arguments.cache_directory != NULL ){
+		// Tiles on the edges extend past the viewport.
+		viewport.margin = TILE_SIZE;
+	}
 
 	clock_t begin, end;
 	if( verbose ){
 		begin = clock();
 	}
 
+	struct renderer renderer;
+	init_renderer( &renderer, &viewport, max_iterations, arguments.precision, 1 );
+	if( verbose && renderer.precision == PRECISION_PERTURBATION ){
+		printf("Using perturbation, skipping %d iterations with series approximation.\n", renderer.orbit.skip);
+	}
+
+	struct tile_cache cache;
+	if( arguments.cache_directory != NULL ){
+		init_tile_cache( &cache, arguments.cache_directory, &renderer );
+	}
+	// Snapping to the tile lattice may have moved the viewport.
+	viewport = renderer.viewport;
+
+	int * iterations = (int*)malloc(sizeof(int)*x_resolution);
+	struct csv_formatter formatter;
+	init_csv_formatter( &formatter, &viewport, max_iterations );
+	char * row_buffer = (char*)malloc(sizeof(char)*csv_row_max_size( &formatter ));
+
+	// With symmetry, rows that a later row will copy are kept until then.
+	int ** mirrored_rows = (int**)calloc(y_resolution,sizeof(int*));
+	int num_copied = 0;
+
 	FILE * file;
 	file = fopen(output_file, "w+");
-	fprintf(file, "x,y,z\n");
-	double x, y;
+	fprintf(file, CSV_HEADER);
 	for( int y_i=0; y_i<y_resolution; y_i++ ){
-		y = -1.5 + (y_i * y_step);
-		for( int x_i=0; x_i<x_resolution; x_i++ ){
-			x = -2.0 + x_i * x_step;
-			double complex c = x + y * I;
-			int iterations = in_mandelbrot_set( c, max_iterations );
-			fprintf(file, "%f,%f,%d\n", x, y, iterations);
+		csv_formatter_set_row( &formatter, &viewport, y_i );
+		int mirror_y_i = arguments.symmetry ? mirror_row( &renderer, y_i ) : -1;
+		if( mirror_y_i >= 0 && mirror_y_i < y_i ){
+			memcpy( iterations, mirrored_rows[mirror_y_i], sizeof(int)*x_resolution );
+			free(mirrored_rows[mirror_y_i]);
+			mirrored_rows[mirror_y_i] = NULL;
+			num_copied++;
+		} else {
+			if( arguments.cache_directory != NULL ){
+				tile_cache_row( &cache, y_i, iterations );
+			} else {
+				render_row( &renderer, y_i, iterations );
+			}
+			if( mirror_y_i > y_i ){
+				mirrored_rows[y_i] = (int*)malloc(sizeof(int)*x_resolution);
+				memcpy( mirrored_rows[y_i], iterations, sizeof(int)*x_resolution );
+			}
 		}
+		fwrite( row_buffer, sizeof(char), format_csv_row( &formatter, iterations, row_buffer ), file );
 	}
 	fclose(file);
+	if( verbose && arguments.symmetry ){
+		printf("Copied %d of %d rows from their reflection.\n", num_copied, y_resolution);
+	}
+	free(mirrored_rows);
+
+	free(iterations);
+	free(row_buffer);
+	free_csv_formatter( &formatter );
+	free_renderer( &renderer );
+	if( arguments.cache_directory != NULL ){
+		if( verbose ){
+			printf("Served %d tiles from the cache and computed %d.\n", cache.hits, cache.misses);
+		}
+		free_tile_cache( &cache );
+		evict_tile_cache( arguments.cache_directory, arguments.cache_megabytes * 1024 * 1024 );
+	}
 
 	if( verbose ){
 		end = clock();
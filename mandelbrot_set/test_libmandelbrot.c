@@ -0,0 +1,116 @@
+#include "CUnit/Basic.h"
+#include "CUnit/CUnit.h"
+
+#include <complex.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmandelbrot.h"
+// The library keeps its own in_mandelbrot_set to itself.
+#include "double_double.c"
+#include "mandelbrot_set.c"
+
+// Returns whether the two renders of the region's rows match.
+int compare_serial_to_threaded( const struct mandelbrot_region * region, int first_row, int num_rows, int num_threads ){
+	long long num_pixels = (long long)num_rows * region->x_resolution;
+	int * serial = (int*)malloc(sizeof(int)*num_pixels);
+	int * threaded = (int*)malloc(sizeof(int)*num_pixels);
+	CU_ASSERT( mandelbrot_render( region, first_row, num_rows, serial ) == 0 );
+	CU_ASSERT( mandelbrot_render_threaded( region, first_row, num_rows, threaded, num_threads ) == 0 );
+	int same = memcmp( serial, threaded, sizeof(int)*num_pixels ) == 0;
+	free(serial);
+	free(threaded);
+	return same;
+}
+
+void test_render_matches_in_mandelbrot_set(){
+	struct mandelbrot_region region;
+	CU_ASSERT( mandelbrot_region_init( &region, "-0.5", "0.0", 3.0, 60, 40, 200 ) == 0 );
+	CU_ASSERT( region.precision == PRECISION_DOUBLE );
+	int * iterations = (int*)malloc(sizeof(int)*60*40);
+	CU_ASSERT( mandelbrot_render( &region, 0, 40, iterations ) == 0 );
+	// The default region spans -2 to 1 and -1.5 to 1.5.
+	int mismatches = 0;
+	for( int y_i=0; y_i<40; y_i++ ){
+		for( int x_i=0; x_i<60; x_i++ ){
+			double complex c = (-2.0 + x_i * (3.0 / 60)) + (-1.5 + y_i * (3.0 / 40)) * I;
+			mismatches += iterations[y_i * 60 + x_i] != in_mandelbrot_set( c, 200 );
+		}
+	}
+	CU_ASSERT( mismatches == 0 );
+
+	// Rendering only some rows gives the same counts for them.
+	CU_ASSERT( mandelbrot_render( &region, 13, 7, iterations + 60*40 - 60*7 ) == 0 );
+	int * full = (int*)malloc(sizeof(int)*60*40);
+	mandelbrot_render( &region, 0, 40, full );
+	CU_ASSERT( memcmp( full + 60*13, iterations + 60*40 - 60*7, sizeof(int)*60*7 ) == 0 );
+	free(full);
+	free(iterations);
+}
+
+void test_threaded_matches_serial(){
+	struct mandelbrot_region region;
+	mandelbrot_region_init( &region, "-0.5", "0.0", 3.0, 50, 50, 300 );
+	CU_ASSERT( compare_serial_to_threaded( &region, 0, 50, 1 ) );
+	CU_ASSERT( compare_serial_to_threaded( &region, 0, 50, 3 ) );
+	CU_ASSERT( compare_serial_to_threaded( &region, 7, 20, 4 ) );
+	// More threads than rows, and one per processor.
+	CU_ASSERT( compare_serial_to_threaded( &region, 49, 1, 8 ) );
+	CU_ASSERT( compare_serial_to_threaded( &region, 0, 50, 0 ) );
+	// Every precision, perturbation picked by zooming in.
+	mandelbrot_region_init( &region, "-0.75", "0.1", 1e-5, 40, 40, 500 );
+	CU_ASSERT( compare_serial_to_threaded( &region, 0, 40, 3 ) );
+	mandelbrot_region_init( &region, "-1.75", "0.0", 1e-14, 40, 40, 500 );
+	region.precision = PRECISION_AUTO;
+	CU_ASSERT( compare_serial_to_threaded( &region, 0, 40, 3 ) );
+	region.precision = PRECISION_DOUBLE_DOUBLE;
+	CU_ASSERT( compare_serial_to_threaded( &region, 0, 40, 3 ) );
+}
+
+void test_invalid_requests(){
+	struct mandelbrot_region region;
+	CU_ASSERT( mandelbrot_region_init( &region, "-0.5x", "0.0", 3.0, 10, 10, 100 ) != 0 );
+	CU_ASSERT( mandelbrot_region_init( &region, "-0.5", "0.0", 0.0, 10, 10, 100 ) != 0 );
+	CU_ASSERT( mandelbrot_region_init( &region, "-0.5", "0.0", 3.0, 10, 10, 100 ) == 0 );
+	int iterations[100];
+	CU_ASSERT( mandelbrot_render( &region, 5, 6, iterations ) != 0 );
+	CU_ASSERT( mandelbrot_render( &region, -1, 2, iterations ) != 0 );
+	CU_ASSERT( mandelbrot_render_threaded( &region, 0, 11, iterations, 2 ) != 0 );
+	region.precision = 99;
+	CU_ASSERT( mandelbrot_render( &region, 0, 10, iterations ) != 0 );
+	// What was float.
+	region.precision = 3;
+	CU_ASSERT( mandelbrot_render( &region, 0, 10, iterations ) != 0 );
+	region.precision = PRECISION_AUTO;
+	CU_ASSERT( mandelbrot_render( &region, 10, 0, iterations ) == 0 );
+}
+
+void test_strided_matches_serial(){
+	struct mandelbrot_region region;
+	mandelbrot_region_init( &region, "-0.5", "0.0", 3.0, 30, 40, 200 );
+	int full[30*40], strided[30*40];
+	mandelbrot_render( &region, 0, 40, full );
+	// Every third row from row 2, up to the last row.
+	CU_ASSERT( mandelbrot_render_strided( &region, 2, 13, 3, strided ) == 0 );
+	int mismatches = 0;
+	for( int row_i=0; row_i<13; row_i++ ){
+		mismatches += memcmp( full + 30*(2 + row_i*3), strided + 30*row_i, sizeof(int)*30 ) != 0;
+	}
+	CU_ASSERT( mismatches == 0 );
+	// One row too many, and strides that are not positive.
+	CU_ASSERT( mandelbrot_render_strided( &region, 2, 14, 3, strided ) != 0 );
+	CU_ASSERT( mandelbrot_render_strided( &region, 0, 2, 0, strided ) != 0 );
+	CU_ASSERT( mandelbrot_render_strided( &region, 0, 0, 1, NULL ) == 0 );
+}
+
+int main(){
+	CU_initialize_registry();
+	CU_pSuite suite = CU_add_suite("AddTestSuite", 0, 0);
+	CU_add_test(suite, "test that mandelbrot_render() matches in_mandelbrot_set()", test_render_matches_in_mandelbrot_set);
+	CU_add_test(suite, "test that mandelbrot_render_threaded() matches mandelbrot_render()", test_threaded_matches_serial);
+	CU_add_test(suite, "test that mandelbrot_render_strided() matches mandelbrot_render()", test_strided_matches_serial);
+	CU_add_test(suite, "test that invalid regions and rows are refused", test_invalid_requests);
+	CU_basic_run_tests();
+	CU_cleanup_registry();
+	return 0;
+}
@@ -1,7 +1,15 @@
 #include "CUnit/Basic.h"
 #include "CUnit/CUnit.h"
 
+#include "double_double.c"
 #include "mandelbrot_set.c"
+#include "perturbation.c"
+#include "render.c"
+#include "tile_cache.c"
+#include "animation.c"
+#include "csv_format.c"
+#include "rle_format.c"
+#include "pyramid_format.c"
 
 void test_in_mandelbrot_set(){
 	double complex c = 0.2 + 0.4 * I;
@@ -57,12 +65,445 @@ void test_in_mandelbrot_set_varied_limit(){
 	CU_ASSERT(100000 == in_mandelbrot_set(c, 100000));
 }
 
+void test_dd_parse(){
+	struct double_double value;
+	CU_ASSERT(0 == dd_parse("1.5", &value));
+	CU_ASSERT(1.5 == value.hi && 0.0 == value.lo);
+	CU_ASSERT(0 == dd_parse("-2e3", &value));
+	CU_ASSERT(-2000.0 == value.hi);
+	// 0.1 is not representable as a double, so the low part holds the rounding
+	// error of the high part.
+	CU_ASSERT(0 == dd_parse("0.1", &value));
+	CU_ASSERT(0.1 == value.hi && 0.0 != value.lo);
+	// Digits past double precision are kept in the low part.
+	struct double_double other;
+	CU_ASSERT(0 == dd_parse("0.10000000000000000000000001", &other));
+	CU_ASSERT(value.hi == other.hi && value.lo != other.lo);
+	CU_ASSERT(-1 == dd_parse("abc", &value));
+	CU_ASSERT(-1 == dd_parse("1.5x", &value));
+	CU_ASSERT(-1 == dd_parse("", &value));
+}
+
+void test_default_viewport(){
+	// The default viewport should reproduce the original fixed plane exactly.
+	struct double_double center_x, center_y;
+	dd_parse(DEFAULT_CENTER_X, &center_x);
+	dd_parse(DEFAULT_CENTER_Y, &center_y);
+	struct viewport viewport;
+	init_viewport(&viewport, center_x, center_y, DEFAULT_SCALE, 100, 30);
+	for( int x_i=0; x_i<100; x_i++ ){
+		CU_ASSERT(-2.0 + x_i * (3.0 / 100) == viewport_x(&viewport, x_i));
+	}
+	for( int y_i=0; y_i<30; y_i++ ){
+		CU_ASSERT(-1.5 + y_i * (3.0 / 30) == viewport_y(&viewport, y_i));
+	}
+	// Doubles unless zoomed too deep for them.
+	CU_ASSERT(PRECISION_DOUBLE == select_precision(&viewport, PRECISION_AUTO));
+	init_viewport(&viewport, center_x, center_y, 1e-6, 100, 30);
+	CU_ASSERT(PRECISION_DOUBLE == select_precision(&viewport, PRECISION_AUTO));
+}
+
+void test_default_view_against_in_mandelbrot_set(){
+	// With the default precision, every pixel of the default view should get the
+	// count in_mandelbrot_set gives it.
+	struct double_double center_x, center_y;
+	dd_parse(DEFAULT_CENTER_X, &center_x);
+	dd_parse(DEFAULT_CENTER_Y, &center_y);
+	struct viewport viewport;
+	init_viewport(&viewport, center_x, center_y, DEFAULT_SCALE, 1000, 1000);
+	struct renderer renderer;
+	init_renderer(&renderer, &viewport, 2000, PRECISION_AUTO, 1);
+	int * row = (int*)malloc(sizeof(int)*1000);
+	int mismatches = 0;
+	for( int y_i=0; y_i<1000; y_i++ ){
+		render_row(&renderer, y_i, row);
+		for( int x_i=0; x_i<1000; x_i++ ){
+			double complex c = viewport_x(&viewport, x_i) + viewport_y(&viewport, y_i) * I;
+			mismatches += row[x_i] != in_mandelbrot_set(c, 2000);
+		}
+	}
+	CU_ASSERT(mismatches == 0);
+	free(row);
+	free_renderer(&renderer);
+}
+
+void test_continue_escape_time(){
+	// Points escaping early and late, on the boundary and inside the set.
+	double points[][2] = { { 0.0, 0.0 }, { -1.0, 0.0 }, { 0.3, 0.5 }, { -0.75, 0.1 }, { 0.2501, 0.0 }, { -0.7454, 0.1130 }, { 1.0, 1.0 }, { -2.5, 0.0 } };
+	for( int point_i=0; point_i<8; point_i++ ){
+		double c_re = points[point_i][0];
+		double c_im = points[point_i][1];
+		double z_re = 0.0, z_im = 0.0;
+		int count = continue_escape_time_double(c_re, c_im, &z_re, &z_im, 0, 50);
+		CU_ASSERT(escape_time_double(c_re, c_im, 50) == count);
+		// Carrying on from the limit gives the count of starting again at the
+		// higher limit.
+		if( count == 50 ){
+			count = continue_escape_time_double(c_re, c_im, &z_re, &z_im, 50, 5000);
+			CU_ASSERT(escape_time_double(c_re, c_im, 5000) == count);
+		}
+	}
+}
+
+void test_kernels_agree(){
+	// The double kernel is the original double complex one, and double-double
+	// agrees with it away from the boundary of the set.
+	double points[][2] = { { 0.0, 0.0 }, { -1.0, 0.0 }, { 0.3, 0.5 }, { -0.75, 0.1 }, { 1.0, 1.0 }, { -2.5, 0.0 } };
+	for( int point_i=0; point_i<6; point_i++ ){
+		double c_re = points[point_i][0];
+		double c_im = points[point_i][1];
+		int expected = escape_time_double(c_re, c_im, 100);
+		CU_ASSERT(expected == in_mandelbrot_set(c_re + c_im * I, 100));
+		CU_ASSERT(expected == escape_time_double_double(dd_from_double(c_re), dd_from_double(c_im), 100));
+	}
+	CU_ASSERT(-1 == parse_precision("float"));
+	CU_ASSERT(PRECISION_DOUBLE_DOUBLE == parse_precision("double-double"));
+}
+
+void test_perturbation_matches_double(){
+	// Away from deep zooms, perturbation should agree with direct iteration
+	// except, at most, for a few points right on escape boundaries.
+	struct double_double center_x, center_y;
+	dd_parse("-0.743643887", &center_x);
+	dd_parse("0.131825904", &center_y);
+	struct viewport viewport;
+	init_viewport(&viewport, center_x, center_y, 1e-6, 50, 50);
+	struct renderer direct, perturbed;
+	init_renderer(&direct, &viewport, 1000, PRECISION_DOUBLE, 1);
+	init_renderer(&perturbed, &viewport, 1000, PRECISION_PERTURBATION, 1);
+	int direct_row[50], perturbed_row[50];
+	int mismatches = 0;
+	for( int y_i=0; y_i<50; y_i++ ){
+		render_row(&direct, y_i, direct_row);
+		render_row(&perturbed, y_i, perturbed_row);
+		for( int x_i=0; x_i<50; x_i++ ){
+			mismatches += direct_row[x_i] != perturbed_row[x_i];
+		}
+	}
+	CU_ASSERT(mismatches <= 25);
+	free_renderer(&direct);
+	free_renderer(&perturbed);
+}
+
+void test_perturbation_deep_zoom(){
+	// At a scale of 1e-20 doubles cannot tell the pixels apart, so every pixel
+	// gets the same count, while perturbation still resolves structure.
+	struct double_double center_x, center_y;
+	dd_parse("-0.743643887037158704752191506114774", &center_x);
+	dd_parse("0.131825904205311970493132056385139", &center_y);
+	struct viewport viewport;
+	init_viewport(&viewport, center_x, center_y, 1e-20, 20, 20);
+	CU_ASSERT(PRECISION_PERTURBATION == select_precision(&viewport, PRECISION_AUTO));
+	struct renderer direct, perturbed;
+	init_renderer(&direct, &viewport, 20000, PRECISION_DOUBLE, 1);
+	init_renderer(&perturbed, &viewport, 20000, PRECISION_AUTO, 1);
+	CU_ASSERT(perturbed.orbit.skip > 0);
+	int direct_row[20], perturbed_row[20];
+	int direct_distinct = 0, perturbed_distinct = 0;
+	for( int y_i=0; y_i<20; y_i++ ){
+		render_row(&direct, y_i, direct_row);
+		render_row(&perturbed, y_i, perturbed_row);
+		for( int x_i=1; x_i<20; x_i++ ){
+			direct_distinct += direct_row[x_i] != direct_row[x_i-1];
+			perturbed_distinct += perturbed_row[x_i] != perturbed_row[x_i-1];
+		}
+	}
+	CU_ASSERT(0 == direct_distinct);
+	CU_ASSERT(perturbed_distinct > 20);
+	free_renderer(&direct);
+	free_renderer(&perturbed);
+
+	// Iterating directly in double-double resolves the same structure, and
+	// agrees with perturbation on nearly every pixel.
+	struct renderer full;
+	init_renderer(&full, &viewport, 20000, PRECISION_DOUBLE_DOUBLE, 1);
+	init_renderer(&perturbed, &viewport, 20000, PRECISION_PERTURBATION, 1);
+	int full_row[20];
+	int mismatches = 0;
+	for( int y_i=0; y_i<20; y_i++ ){
+		render_row(&full, y_i, full_row);
+		render_row(&perturbed, y_i, perturbed_row);
+		for( int x_i=0; x_i<20; x_i++ ){
+			mismatches += full_row[x_i] != perturbed_row[x_i];
+		}
+	}
+	CU_ASSERT(mismatches <= 20);
+	free_renderer(&full);
+	free_renderer(&perturbed);
+
+	// Past the resolution of a double-double center the view is refused, but
+	// only relative to the center's magnitude.
+	CU_ASSERT(!viewport_too_deep(&viewport));
+	init_viewport(&viewport, center_x, center_y, 1e-29, 1000, 1000);
+	CU_ASSERT(viewport_too_deep(&viewport));
+	dd_parse("0", &center_x);
+	dd_parse("0", &center_y);
+	init_viewport(&viewport, center_x, center_y, 1e-29, 1000, 1000);
+	CU_ASSERT(!viewport_too_deep(&viewport));
+}
+
+void test_tile_cache(){
+	struct double_double center_x, center_y;
+	dd_parse("-0.3", &center_x);
+	dd_parse("0.2", &center_y);
+	struct viewport viewport;
+	init_viewport(&viewport, center_x, center_y, 1.0, 100, 70);
+	struct renderer renderer;
+	init_renderer(&renderer, &viewport, 100, PRECISION_AUTO, 1);
+	system("rm -rf temp_tile_cache");
+	struct tile_cache cache;
+	init_tile_cache(&cache, "temp_tile_cache", &renderer);
+	CU_ASSERT(renderer.viewport.snapped);
+	CU_ASSERT(!tile_cache_contains(&cache, 0));
+
+	// Rows read through the cache should match rendering the snapped viewport
+	// directly, both when the tiles are computed and when they are loaded.
+	int expected[100], actual[100];
+	for( int pass=0; pass<2; pass++ ){
+		cache.band_tile_y = LLONG_MIN;
+		for( int y_i=0; y_i<70; y_i++ ){
+			render_row(&renderer, y_i, expected);
+			tile_cache_row(&cache, y_i, actual);
+			CU_ASSERT(0 == memcmp(expected, actual, sizeof(expected)));
+		}
+	}
+	CU_ASSERT(cache.misses == cache.tiles_x * cache.tiles_y);
+	CU_ASSERT(cache.hits == cache.misses);
+	CU_ASSERT(tile_cache_contains(&cache, 0));
+
+	// A different limit must not be served the same tiles.
+	struct tile_cache other_cache;
+	renderer.limit = 50;
+	init_tile_cache(&other_cache, "temp_tile_cache", &renderer);
+	CU_ASSERT(!tile_cache_contains(&other_cache, 0));
+
+	// Evicting down to a single tile keeps only the most recently used one.
+	evict_tile_cache("temp_tile_cache", sizeof(struct tile_key) + sizeof(int)*TILE_SIZE*TILE_SIZE);
+	int remaining = 0;
+	for( int tile_i=0; tile_i<cache.tiles_x * cache.tiles_y; tile_i++ ){
+		remaining += tile_cache_contains(&cache, tile_i);
+	}
+	CU_ASSERT(1 == remaining);
+
+	free_tile_cache(&cache);
+	free_tile_cache(&other_cache);
+	free_renderer(&renderer);
+	system("rm -rf temp_tile_cache");
+}
+
+void test_interpolate_keyframes(){
+	struct keyframe keyframes[2];
+	dd_parse("-0.5", &keyframes[0].center_x);
+	dd_parse("0.0", &keyframes[0].center_y);
+	keyframes[0].scale = 4.0;
+	dd_parse("-1.5", &keyframes[1].center_x);
+	dd_parse("1.0", &keyframes[1].center_y);
+	keyframes[1].scale = 1.0;
+	struct keyframe frame;
+	interpolate_keyframes(keyframes, 2, 0, 3, &frame);
+	CU_ASSERT(same_center(&frame, &keyframes[0]) && 4.0 == frame.scale);
+	// The center moves linearly while the scale shrinks geometrically.
+	interpolate_keyframes(keyframes, 2, 1, 3, &frame);
+	CU_ASSERT(-1.0 == dd_to_double(frame.center_x) && 0.5 == dd_to_double(frame.center_y));
+	CU_ASSERT_DOUBLE_EQUAL(2.0, frame.scale, 1e-12);
+	interpolate_keyframes(keyframes, 2, 2, 3, &frame);
+	CU_ASSERT(same_center(&frame, &keyframes[1]) && 1.0 == frame.scale);
+
+	CU_ASSERT(valid_frame_pattern("frame_%05d.csv"));
+	CU_ASSERT(valid_frame_pattern("100%%_%d.csv"));
+	CU_ASSERT(!valid_frame_pattern("frame.csv"));
+	CU_ASSERT(!valid_frame_pattern("frame_%d_%d.csv"));
+	CU_ASSERT(!valid_frame_pattern("frame_%s.csv"));
+}
+
+void test_render_frame_reuse(){
+	// Zooming in by a factor of 2 about the center lands every other pixel of
+	// the new frame on a pixel of the previous one.
+	struct double_double center_x, center_y;
+	dd_parse(DEFAULT_CENTER_X, &center_x);
+	dd_parse(DEFAULT_CENTER_Y, &center_y);
+	struct viewport previous_viewport, viewport;
+	init_viewport(&previous_viewport, center_x, center_y, 3.0, 40, 40);
+	init_viewport(&viewport, center_x, center_y, 1.5, 40, 40);
+	struct renderer previous, renderer;
+	init_renderer(&previous, &previous_viewport, 100, PRECISION_DOUBLE, 1);
+	init_renderer(&renderer, &viewport, 100, PRECISION_DOUBLE, 1);
+
+	int previous_iterations[40*40], iterations[40*40], expected[40];
+	CU_ASSERT(0 == render_frame(&previous, NULL, NULL, previous_iterations));
+	CU_ASSERT(20*20 == render_frame(&renderer, &previous, previous_iterations, iterations));
+	for( int y_i=0; y_i<40; y_i++ ){
+		render_row(&renderer, y_i, expected);
+		CU_ASSERT(0 == memcmp(expected, iterations + y_i*40, sizeof(expected)));
+	}
+
+	// Nothing is reused across different limits.
+	renderer.limit = 50;
+	CU_ASSERT(0 == render_frame(&renderer, &previous, previous_iterations, iterations));
+	free_renderer(&previous);
+	free_renderer(&renderer);
+}
+
+void test_format_int(){
+	char buffer[16];
+	int values[] = { 0, 7, 10, 99, 100, 12345, 1000000, 2147483647, -1, -2147483647 - 1 };
+	for( int value_i=0; value_i<10; value_i++ ){
+		char expected[16];
+		int length = format_int( values[value_i], buffer );
+		buffer[length] = '\0';
+		snprintf( expected, sizeof(expected), "%d", values[value_i] );
+		CU_ASSERT(0 == strcmp(expected, buffer));
+	}
+}
+
+void test_format_csv_row(){
+	// Rows should be byte for byte what printf("%f,%f,%d\n") produces, including
+	// negative zero and coordinates with wide integer parts.
+	char * views[][3] = { { "-0.5", "0.0", "3.0" }, { "12345.5", "-0.0000001", "1e6" } };
+	for( int view_i=0; view_i<2; view_i++ ){
+		struct double_double center_x, center_y;
+		dd_parse(views[view_i][0], &center_x);
+		dd_parse(views[view_i][1], &center_y);
+		struct viewport viewport;
+		init_viewport(&viewport, center_x, center_y, atof(views[view_i][2]), 13, 7);
+		struct csv_formatter formatter;
+		init_csv_formatter(&formatter, &viewport, 100000);
+		char * actual = (char*)malloc(csv_row_max_size(&formatter));
+		char expected[4096];
+		int iterations[13];
+		for( int y_i=0; y_i<7; y_i++ ){
+			int length = 0;
+			for( int x_i=0; x_i<13; x_i++ ){
+				iterations[x_i] = (x_i * 7919 + y_i * 104729) % 100001;
+				length += snprintf(expected + length, sizeof(expected) - length, "%f,%f,%d\n", viewport_x(&viewport, x_i), viewport_y(&viewport, y_i), iterations[x_i]);
+			}
+			csv_formatter_set_row(&formatter, &viewport, y_i);
+			CU_ASSERT(length == format_csv_row(&formatter, iterations, actual));
+			CU_ASSERT(length <= csv_row_max_size(&formatter));
+			CU_ASSERT(0 == memcmp(expected, actual, length));
+		}
+		free(actual);
+		free_csv_formatter(&formatter);
+	}
+}
+
+void test_mirror_row(){
+	struct double_double center_x, center_y;
+	dd_parse(DEFAULT_CENTER_X, &center_x);
+	dd_parse(DEFAULT_CENTER_Y, &center_y);
+	struct viewport viewport;
+	init_viewport(&viewport, center_x, center_y, DEFAULT_SCALE, 20, 100);
+	struct renderer renderer;
+	init_renderer(&renderer, &viewport, 100, PRECISION_AUTO, 1);
+	// Row 0 is at y = -1.5, whose reflection is just past the last row, and row
+	// 50 is on the real axis.
+	CU_ASSERT(-1 == mirror_row(&renderer, 0));
+	CU_ASSERT(50 == mirror_row(&renderer, 50));
+	for( int y_i=1; y_i<100; y_i++ ){
+		CU_ASSERT(100 - y_i == mirror_row(&renderer, y_i));
+	}
+	// Rows 0 to 50 are computed, the rest are copied.
+	int num_unique = 0;
+	for( int y_i=0; y_i<100; y_i++ ){
+		num_unique += is_unique_row(&renderer, y_i);
+	}
+	CU_ASSERT(51 == num_unique);
+	CU_ASSERT(is_unique_row(&renderer, 50) && !is_unique_row(&renderer, 51));
+
+	// Moving the center by a third of a row puts every reflection between rows.
+	dd_parse("0.01", &center_y);
+	init_viewport(&viewport, center_x, center_y, DEFAULT_SCALE, 20, 100);
+	init_renderer(&renderer, &viewport, 100, PRECISION_AUTO, 1);
+	for( int y_i=0; y_i<100; y_i++ ){
+		CU_ASSERT(-1 == mirror_row(&renderer, y_i));
+	}
+}
+
+void test_rle_round_trip(){
+	// Long runs, runs stepping up and down, and pixels with no run at all.
+	int iterations[300], decoded[300];
+	for( int pixel_i=0; pixel_i<300; pixel_i++ ){
+		if( pixel_i < 100 ){
+			iterations[pixel_i] = 1000000;
+		} else if( pixel_i < 200 ){
+			iterations[pixel_i] = pixel_i / 10 % 2 ? 3 : 2;
+		} else {
+			iterations[pixel_i] = (pixel_i * 7919) % 1001;
+		}
+	}
+	unsigned char * encoded = (unsigned char*)malloc(rle_max_size(300));
+	long long size = rle_encode(iterations, 300, encoded);
+	CU_ASSERT(size <= rle_max_size(300));
+	CU_ASSERT(0 == rle_decode(encoded, size, decoded, 300));
+	CU_ASSERT(0 == memcmp(iterations, decoded, sizeof(iterations)));
+	// The first 100 pixels are a single run of three bytes for the count and
+	// one for the length.
+	CU_ASSERT(4 == rle_encode(iterations, 100, encoded));
+
+	// Truncated or overlong data is rejected rather than decoded.
+	size = rle_encode(iterations, 300, encoded);
+	CU_ASSERT(-1 == rle_decode(encoded, size - 1, decoded, 300));
+	CU_ASSERT(-1 == rle_decode(encoded, size, decoded, 299));
+	free(encoded);
+}
+
+void test_pyramid_geometry(){
+	struct pyramid_header header;
+	init_pyramid_header(&header, 601, 300, 100, 256, POOLING_MEAN);
+	// 601 by 300, 301 by 150 and 151 by 75, which fits in one tile.
+	CU_ASSERT(3 == header.num_levels);
+	CU_ASSERT(301 == pyramid_level_width(&header, 1));
+	CU_ASSERT(75 == pyramid_level_height(&header, 2));
+	CU_ASSERT(3 == pyramid_tiles_x(&header, 0));
+	CU_ASSERT(2 == pyramid_tiles_y(&header, 0));
+	CU_ASSERT(2 == pyramid_tiles_x(&header, 1));
+	CU_ASSERT(6 + 2 + 1 == pyramid_num_tiles(&header));
+	CU_ASSERT(6 == pyramid_tile_number(&header, 1, 0, 0));
+	CU_ASSERT(8 == pyramid_tile_number(&header, 2, 0, 0));
+	CU_ASSERT(89 == pyramid_tile_width(&header, 0, 2));
+	CU_ASSERT(44 == pyramid_tile_height(&header, 0, 1));
+
+	// Pixels on the right edge cover only the last column.
+	CU_ASSERT(4 == pyramid_pool_size(&header, 1, 0, 0));
+	CU_ASSERT(2 == pyramid_pool_size(&header, 1, 300, 0));
+	CU_ASSERT(16 == pyramid_pool_size(&header, 2, 0, 74));
+	CU_ASSERT(4 == pyramid_pool_size(&header, 2, 150, 74));
+
+	// The tiles follow one another without gaps.
+	long long index[10];
+	init_pyramid_index(&header, index);
+	CU_ASSERT(pyramid_data_offset(&header) == index[0]);
+	CU_ASSERT(index[1] - index[0] == sizeof(float) * 256 * 256);
+	CU_ASSERT(index[9] - index[8] == sizeof(float) * 151 * 75);
+
+	// A render that fits in one tile is a single level.
+	init_pyramid_header(&header, 256, 10, 100, 256, POOLING_MAX);
+	CU_ASSERT(1 == header.num_levels);
+	CU_ASSERT(POOLING_MEAN == parse_pooling("mean"));
+	CU_ASSERT(-1 == parse_pooling("median"));
+}
+
 int main(){
 	CU_initialize_registry();
 	CU_pSuite suite = CU_add_suite("AddTestSuite", 0, 0);
 	CU_add_test(suite, "test in_mandelbrot_set() on known values", test_in_mandelbrot_set);
 	CU_add_test(suite, "test in_mandelbrot_set() on |c| > 2", test_in_mandelbrot_set_greater_than_2);
 	CU_add_test(suite, "test in_mandelbrot_set() for varied limits", test_in_mandelbrot_set_varied_limit);
+	CU_add_test(suite, "test dd_parse() keeps digits beyond double precision", test_dd_parse);
+	CU_add_test(suite, "test the default viewport matches the original plane", test_default_viewport);
+	CU_add_test(suite, "test the default precision matches in_mandelbrot_set() across the default view", test_default_view_against_in_mandelbrot_set);
+	CU_add_test(suite, "test the kernels of every precision agree", test_kernels_agree);
+	CU_add_test(suite, "test carrying iteration on to a higher limit matches starting again", test_continue_escape_time);
+	CU_add_test(suite, "test perturbation agrees with direct iteration", test_perturbation_matches_double);
+	CU_add_test(suite, "test perturbation resolves deep zooms, up to the resolution of double-double", test_perturbation_deep_zoom);
+	CU_add_test(suite, "test rows served from the tile cache match direct rendering", test_tile_cache);
+	CU_add_test(suite, "test frames are interpolated between keyframes", test_interpolate_keyframes);
+	CU_add_test(suite, "test frames reuse pixels of the previous frame", test_render_frame_reuse);
+	CU_add_test(suite, "test format_int() matches %d", test_format_int);
+	CU_add_test(suite, "test format_csv_row() matches printf", test_format_csv_row);
+	CU_add_test(suite, "test mirror_row() finds reflections in the real axis", test_mirror_row);
+	CU_add_test(suite, "test rle_decode() undoes rle_encode()", test_rle_round_trip);
+	CU_add_test(suite, "test the levels and tiles of a pyramid", test_pyramid_geometry);
 	CU_basic_run_tests();
 	CU_cleanup_registry();
 	return 0;
@@ -0,0 +1,273 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "render.h"
+#include "tile_cache.h"
+
+#define TILE_MAGIC "MBTILE1"
+#define TILE_EXTENSION ".tile"
+#define LOCK_FILE "lock"
+// Temporary files older than this were left behind by a job that died while
+// writing them.
+#define STALE_SECONDS 3600
+
+static long long floor_div( long long a, long long b ){
+	long long quotient = a / b;
+	if( (a % b != 0) && ((a < 0) != (b < 0)) ){
+		quotient--;
+	}
+	return quotient;
+}
+
+// Snaps renderer's viewport to the tile lattice. The caller should print
+// coordinates from renderer->viewport afterwards so they match the cached tiles.
+void init_tile_cache( struct tile_cache * cache, const char * directory, struct renderer * renderer ){
+	// Tiles are positioned relative to the center for perturbation.
+	snap_viewport( &renderer->viewport, offsets_from_center( renderer->precision ) );
+	const struct viewport * viewport = &renderer->viewport;
+
+	cache->directory = directory;
+	cache->renderer = *renderer;
+	cache->first_tile_x = floor_div( viewport->x_lattice, TILE_SIZE );
+	cache->first_tile_y = floor_div( viewport->y_lattice, TILE_SIZE );
+	long long last_tile_x = floor_div( viewport->x_lattice + viewport->x_resolution - 1, TILE_SIZE );
+	long long last_tile_y = floor_div( viewport->y_lattice + viewport->y_resolution - 1, TILE_SIZE );
+	cache->tiles_x = last_tile_x - cache->first_tile_x + 1;
+	cache->tiles_y = last_tile_y - cache->first_tile_y + 1;
+	cache->band = (int*)malloc(sizeof(int)*cache->tiles_x*TILE_SIZE*TILE_SIZE);
+	cache->band_tile_y = LLONG_MIN;
+	cache->hits = 0;
+	cache->misses = 0;
+
+	// Several ranks may try this at once, only one needs to succeed.
+	mkdir( directory, 0777 );
+}
+
+void make_tile_key( const struct tile_cache * cache, int tile_i, struct tile_key * key ){
+	const struct viewport * viewport = &cache->renderer.viewport;
+	// Zero the padding too, as the key is hashed and compared as raw bytes.
+	memset( key, 0, sizeof(struct tile_key) );
+	strcpy( key->magic, TILE_MAGIC );
+	key->x_step = viewport->x_step;
+	key->y_step = viewport->y_step;
+	key->tile_x = cache->first_tile_x + tile_i % cache->tiles_x;
+	key->tile_y = cache->first_tile_y + tile_i / cache->tiles_x;
+	key->limit = cache->renderer.limit;
+	key->precision = cache->renderer.precision;
+	key->lattice_relative = viewport->lattice_relative;
+	if( viewport->lattice_relative ){
+		key->center_x = viewport->center_x;
+		key->center_y = viewport->center_y;
+	}
+}
+
+// Tiles are named after a FNV-1a hash of their key.
+static void tile_path( const struct tile_cache * cache, const struct tile_key * key, char * path ){
+	unsigned long long hash = 14695981039346656037ULL;
+	const unsigned char * bytes = (const unsigned char*)key;
+	for( size_t byte_i=0; byte_i<sizeof(struct tile_key); byte_i++ ){
+		hash ^= bytes[byte_i];
+		hash *= 1099511628211ULL;
+	}
+	snprintf( path, PATH_MAX, "%s/%016llx%s", cache->directory, hash, TILE_EXTENSION );
+}
+
+int tile_cache_contains( const struct tile_cache * cache, int tile_i ){
+	struct tile_key key;
+	char path[PATH_MAX];
+	make_tile_key( cache, tile_i, &key );
+	tile_path( cache, &key, path );
+	return access( path, R_OK ) == 0;
+}
+
+// Returns 1 and fills iterations if the tile is in the cache.
+static int load_tile( const struct tile_cache * cache, int tile_i, int * iterations ){
+	struct tile_key key, stored_key;
+	char path[PATH_MAX];
+	make_tile_key( cache, tile_i, &key );
+	tile_path( cache, &key, path );
+
+	FILE * file = fopen( path, "rb" );
+	if( file == NULL ){
+		return 0;
+	}
+	int found = fread( &stored_key, sizeof(stored_key), 1, file ) == 1
+		&& memcmp( &stored_key, &key, sizeof(key) ) == 0
+		&& fread( iterations, sizeof(int), TILE_SIZE*TILE_SIZE, file ) == TILE_SIZE*TILE_SIZE;
+	fclose( file );
+	if( found ){
+		// The modification time doubles as the last use for LRU eviction.
+		utimes( path, NULL );
+	}
+	return found;
+}
+
+// Tiles are written to a temporary file and renamed into place, so other jobs
+// never see a partially written tile. Failing to store a tile is not an error,
+// the cache is only an optimization.
+static void store_tile( const struct tile_cache * cache, int tile_i, const int * iterations ){
+	struct tile_key key;
+	char path[PATH_MAX];
+	char temp_path[PATH_MAX];
+	make_tile_key( cache, tile_i, &key );
+	tile_path( cache, &key, path );
+	snprintf( temp_path, PATH_MAX, "%s/tmp.XXXXXX", cache->directory );
+
+	int fd = mkstemp( temp_path );
+	if( fd < 0 ){
+		return;
+	}
+	FILE * file = fdopen( fd, "wb" );
+	int written = file != NULL
+		&& fwrite( &key, sizeof(key), 1, file ) == 1
+		&& fwrite( iterations, sizeof(int), TILE_SIZE*TILE_SIZE, file ) == TILE_SIZE*TILE_SIZE;
+	if( file != NULL ){
+		written = ( fclose( file ) == 0 ) && written;
+	} else {
+		close( fd );
+	}
+	if( !written || rename( temp_path, path ) != 0 ){
+		unlink( temp_path );
+	}
+}
+
+void compute_tile( struct tile_cache * cache, int tile_i, int * iterations ){
+	struct renderer tile_renderer = cache->renderer;
+	struct viewport * viewport = &tile_renderer.viewport;
+	viewport->x_lattice = (cache->first_tile_x + tile_i % cache->tiles_x) * TILE_SIZE;
+	viewport->y_lattice = (cache->first_tile_y + tile_i / cache->tiles_x) * TILE_SIZE;
+	viewport->x_resolution = TILE_SIZE;
+	viewport->y_resolution = TILE_SIZE;
+	for( int y_i=0; y_i<TILE_SIZE; y_i++ ){
+		render_row( &tile_renderer, y_i, iterations + y_i * TILE_SIZE );
+	}
+	store_tile( cache, tile_i, iterations );
+	cache->misses++;
+}
+
+// Fill iterations with a row of the viewport, loading the tiles it falls in from
+// the cache and computing any that are missing.
+void tile_cache_row( struct tile_cache * cache, int y_i, int * iterations ){
+	const struct viewport * viewport = &cache->renderer.viewport;
+	long long lattice_y = viewport->y_lattice + y_i;
+	long long tile_y = floor_div( lattice_y, TILE_SIZE );
+	int band_width = cache->tiles_x * TILE_SIZE;
+
+	if( tile_y != cache->band_tile_y ){
+		int * tile = (int*)malloc(sizeof(int)*TILE_SIZE*TILE_SIZE);
+		for( int tile_x=0; tile_x<cache->tiles_x; tile_x++ ){
+			int tile_i = (tile_y - cache->first_tile_y) * cache->tiles_x + tile_x;
+			if( load_tile( cache, tile_i, tile ) ){
+				cache->hits++;
+			} else {
+				compute_tile( cache, tile_i, tile );
+			}
+			for( int row=0; row<TILE_SIZE; row++ ){
+				memcpy( cache->band + row * band_width + tile_x * TILE_SIZE, tile + row * TILE_SIZE, sizeof(int)*TILE_SIZE );
+			}
+		}
+		free(tile);
+		cache->band_tile_y = tile_y;
+	}
+
+	int * band_row = cache->band + (lattice_y - tile_y * TILE_SIZE) * band_width;
+	long long first_column = viewport->x_lattice - cache->first_tile_x * TILE_SIZE;
+	memcpy( iterations, band_row + first_column, sizeof(int)*viewport->x_resolution );
+}
+
+struct cached_file {
+	char name[NAME_MAX+1];
+	long long size;
+	struct timespec last_used;
+};
+
+static int compare_last_used( const void * a, const void * b ){
+	const struct cached_file * file_a = a;
+	const struct cached_file * file_b = b;
+	if( file_a->last_used.tv_sec != file_b->last_used.tv_sec ){
+		return file_a->last_used.tv_sec < file_b->last_used.tv_sec ? -1 : 1;
+	}
+	if( file_a->last_used.tv_nsec != file_b->last_used.tv_nsec ){
+		return file_a->last_used.tv_nsec < file_b->last_used.tv_nsec ? -1 : 1;
+	}
+	return 0;
+}
+
+// Delete the least recently used tiles until the cache fits in max_bytes. A lock
+// file keeps concurrent jobs from evicting at the same time.
+void evict_tile_cache( const char * directory, long long max_bytes ){
+	char path[PATH_MAX];
+	snprintf( path, PATH_MAX, "%s/%s", directory, LOCK_FILE );
+	int lock = open( path, O_RDWR | O_CREAT, 0666 );
+	if( lock < 0 ){
+		return;
+	}
+	flock( lock, LOCK_EX );
+
+	DIR * dir = opendir( directory );
+	if( dir == NULL ){
+		close( lock );
+		return;
+	}
+	int num_files = 0;
+	int capacity = 64;
+	struct cached_file * files = (struct cached_file*)malloc(sizeof(struct cached_file)*capacity);
+	long long total_bytes = 0;
+	time_t now = time( NULL );
+	struct dirent * entry;
+	while( (entry = readdir( dir )) != NULL ){
+		size_t length = strlen( entry->d_name );
+		int is_tile = length > strlen(TILE_EXTENSION) && strcmp( entry->d_name + length - strlen(TILE_EXTENSION), TILE_EXTENSION ) == 0;
+		int is_temp = strncmp( entry->d_name, "tmp.", 4 ) == 0;
+		if( !is_tile && !is_temp ){
+			continue;
+		}
+		struct stat info;
+		snprintf( path, PATH_MAX, "%s/%s", directory, entry->d_name );
+		if( stat( path, &info ) != 0 ){
+			continue;
+		}
+		if( is_temp ){
+			if( now - info.st_mtime > STALE_SECONDS ){
+				unlink( path );
+			}
+			continue;
+		}
+		if( num_files == capacity ){
+			capacity *= 2;
+			files = (struct cached_file*)realloc(files, sizeof(struct cached_file)*capacity);
+		}
+		strcpy( files[num_files].name, entry->d_name );
+		files[num_files].size = info.st_size;
+		files[num_files].last_used = info.st_mtim;
+		total_bytes += info.st_size;
+		num_files++;
+	}
+	closedir( dir );
+
+	qsort( files, num_files, sizeof(struct cached_file), compare_last_used );
+	for( int file_i=0; file_i<num_files && total_bytes>max_bytes; file_i++ ){
+		snprintf( path, PATH_MAX, "%s/%s", directory, files[file_i].name );
+		if( unlink( path ) == 0 ){
+			total_bytes -= files[file_i].size;
+		}
+	}
+
+	free(files);
+	flock( lock, LOCK_UN );
+	close( lock );
+}
+
+void free_tile_cache( struct tile_cache * cache ){
+	free(cache->band);
+	cache->band = NULL;
+}
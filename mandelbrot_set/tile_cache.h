@@ -0,0 +1,52 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include "render.h"
+
+// Width and height, in pixels, of a cached tile.
+#define TILE_SIZE 64
+#define DEFAULT_CACHE_MEGABYTES 1024
+
+// Everything a tile's iteration counts depend on. Two renders that produce the
+// same key produce the same tile.
+struct tile_key {
+	char magic[8];
+	double x_step;
+	double y_step;
+	// Lattice position of the tile, in units of TILE_SIZE pixels.
+	long long tile_x;
+	long long tile_y;
+	int limit;
+	int precision;
+	int lattice_relative;
+	// Only set for tiles positioned relative to a center.
+	struct double_double center_x;
+	struct double_double center_y;
+};
+
+struct tile_cache {
+	const char * directory;
+	// Renderer snapped to the tile lattice.
+	struct renderer renderer;
+	// Range of tiles, in lattice units, that covers the viewport.
+	long long first_tile_x;
+	long long first_tile_y;
+	int tiles_x;
+	int tiles_y;
+	// One row of tiles, the band the last requested row fell in.
+	int * band;
+	long long band_tile_y;
+	// Number of tiles read from and written to the cache directory.
+	int hits;
+	int misses;
+};
+
+void init_tile_cache( struct tile_cache * cache, const char * directory, struct renderer * renderer );
+void make_tile_key( const struct tile_cache * cache, int tile_i, struct tile_key * key );
+int tile_cache_contains( const struct tile_cache * cache, int tile_i );
+void compute_tile( struct tile_cache * cache, int tile_i, int * iterations );
+void tile_cache_row( struct tile_cache * cache, int y_i, int * iterations );
+void evict_tile_cache( const char * directory, long long max_bytes );
+void free_tile_cache( struct tile_cache * cache );
+
+#endif
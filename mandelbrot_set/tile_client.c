@@ -0,0 +1,95 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "render.h"
+#include "tile_client.h"
+
+// Send all of buffer, however many writes it takes. Returns 0 on success and -1
+// if the connection failed. A closed connection is an error, not a SIGPIPE.
+int write_fully( int fd, const void * buffer, long long size ){
+	const char * position = (const char*)buffer;
+	while( size > 0 ){
+		ssize_t written = send( fd, position, size, MSG_NOSIGNAL );
+		if( written < 0 && errno == EINTR ){
+			continue;
+		}
+		if( written <= 0 ){
+			return -1;
+		}
+		position += written;
+		size -= written;
+	}
+	return 0;
+}
+
+// Returns 0 once size bytes were read, and -1 if the connection failed or was
+// closed first.
+int read_fully( int fd, void * buffer, long long size ){
+	char * position = (char*)buffer;
+	while( size > 0 ){
+		ssize_t num_read = read( fd, position, size );
+		if( num_read < 0 && errno == EINTR ){
+			continue;
+		}
+		if( num_read <= 0 ){
+			return -1;
+		}
+		position += num_read;
+		size -= num_read;
+	}
+	return 0;
+}
+
+// Returns the connected socket, or -1 if nothing is serving at path.
+int connect_tile_server( const char * path ){
+	struct sockaddr_un address;
+	if( strlen(path) >= sizeof(address.sun_path) ){
+		return -1;
+	}
+	memset( &address, 0, sizeof(address) );
+	address.sun_family = AF_UNIX;
+	strcpy( address.sun_path, path );
+	int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if( fd < 0 ){
+		return -1;
+	}
+	if( connect( fd, (struct sockaddr*)&address, sizeof(address) ) != 0 ){
+		close( fd );
+		return -1;
+	}
+	return fd;
+}
+
+// A request to render a tile, with the precision picked by the server.
+void init_tile_request( struct tile_request * request, struct double_double center_x, struct double_double center_y, double scale, int x_resolution, int y_resolution, int limit ){
+	memset( request, 0, sizeof(*request) );
+	request->type = TILE_REQUEST_RENDER;
+	request->x_resolution = x_resolution;
+	request->y_resolution = y_resolution;
+	request->limit = limit;
+	request->precision = PRECISION_AUTO;
+	request->scale = scale;
+	request->center_x = center_x;
+	request->center_y = center_y;
+}
+
+int send_tile_request( int fd, const struct tile_request * request ){
+	return write_fully( fd, request, sizeof(*request) );
+}
+
+// Read the response to the oldest request not yet answered. The tile goes into
+// iterations, which holds capacity ints. Returns 0 if a tile was received, and
+// -1 if the request was refused, the tile is too big or the connection failed.
+int receive_tile( int fd, struct tile_response * response, int * iterations, long long capacity ){
+	if( read_fully( fd, response, sizeof(*response) ) != 0 || response->status != 0 ){
+		return -1;
+	}
+	long long num_pixels = (long long)response->x_resolution * response->y_resolution;
+	if( num_pixels > capacity ){
+		return -1;
+	}
+	return read_fully( fd, iterations, sizeof(int) * num_pixels );
+}
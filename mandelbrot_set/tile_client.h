@@ -0,0 +1,13 @@
+#ifndef TILE_CLIENT_H
+#define TILE_CLIENT_H
+
+#include "tile_protocol.h"
+
+int write_fully( int fd, const void * buffer, long long size );
+int read_fully( int fd, void * buffer, long long size );
+int connect_tile_server( const char * path );
+void init_tile_request( struct tile_request * request, struct double_double center_x, struct double_double center_y, double scale, int x_resolution, int y_resolution, int limit );
+int send_tile_request( int fd, const struct tile_request * request );
+int receive_tile( int fd, struct tile_response * response, int * iterations, long long capacity );
+
+#endif
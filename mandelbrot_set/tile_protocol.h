@@ -0,0 +1,46 @@
+#ifndef TILE_PROTOCOL_H
+#define TILE_PROTOCOL_H
+
+#include "double_double.h"
+
+// What par_mandelbrot_set --serve and its clients say to each other over the
+// Unix domain socket. Both ends are on the same machine, so everything is sent
+// as these structs in native byte order.
+//
+// A client sends any number of requests on a connection, and gets one response
+// per request back in the same order, even after shutting down its end for
+// writing. A response is a struct tile_response followed, if its status is 0,
+// by x_resolution * y_resolution ints, the iteration counts a row at a time in
+// the same order as the csv output.
+
+#define TILE_REQUEST_RENDER 1
+// Stops the server once the requests before it are answered. Gets no response.
+#define TILE_REQUEST_SHUTDOWN 2
+
+// Largest tile the server renders, in pixels.
+#define MAX_TILE_PIXELS (4096 * 4096)
+
+struct tile_request {
+	int type;
+	int x_resolution;
+	int y_resolution;
+	int limit;
+	// One of the PRECISION_ constants of render.h.
+	int precision;
+	double scale;
+	struct double_double center_x;
+	struct double_double center_y;
+};
+
+struct tile_response {
+	// 0 if the tile follows, -1 if the request was invalid.
+	int status;
+	int x_resolution;
+	int y_resolution;
+	// How many requests, this one included, the render answering it has answered
+	// so far. More than 1 when identical requests came in while it was waiting
+	// or rendering, or straight after it.
+	int num_coalesced;
+};
+
+#endif
@@ -0,0 +1,490 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <mpi.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "libmandelbrot_mpi.h"
+#include "render.h"
+#include "tile_client.h"
+#include "tile_server.h"
+
+// A request read from a connection and not yet answered.
+struct pending_tile {
+	struct tile_request request;
+	int connection_i;
+	int answered;
+};
+
+// Bytes of answers a connection may have waiting to be sent before the server
+// stops reading its requests, so a client that asks without reading holds up
+// only itself.
+#define MAX_QUEUED_BYTES (16LL * 1024 * 1024)
+
+// A client connection, with any part of a request read from it so far, and the
+// answers not yet sent, from output_sent up to output_size. A client that shut
+// down its end for writing is read no more, but still sent what it is owed.
+struct tile_connection {
+	int fd;
+	char buffer[sizeof(struct tile_request)];
+	int filled;
+	int read_closed;
+	char * output;
+	long long output_sent;
+	long long output_size;
+	long long output_capacity;
+};
+
+// Everything root keeps while serving. iterations holds the last tile rendered,
+// the answer to last_request, which num_answered requests have had so far.
+struct tile_server {
+	struct tile_connection connections[MAX_TILE_CLIENTS];
+	int num_connections;
+	struct pending_tile * pending;
+	int num_pending;
+	int pending_capacity;
+	int * iterations;
+	long long iterations_capacity;
+	struct tile_request last_request;
+	int have_last;
+	int num_answered;
+	// Set once a client asks for a shutdown.
+	int stopping;
+};
+
+static volatile sig_atomic_t stop_serving = 0;
+// The handler writes to the pipe to wake the server from poll, so a signal
+// that arrives just before the server waits is not missed.
+static int stop_pipe[2] = { -1, -1 };
+
+static void handle_stop_signal( int signal_number ){
+	(void)signal_number;
+	int saved_errno = errno;
+	stop_serving = 1;
+	if( write( stop_pipe[1], "", 1 ) < 0 ){
+		// The pipe is full, so the server is already woken.
+	}
+	errno = saved_errno;
+}
+
+// Compares field by field, since the padding of the structs is whatever the
+// client sent.
+int same_tile_request( const struct tile_request * a, const struct tile_request * b ){
+	return a->type == b->type && a->x_resolution == b->x_resolution && a->y_resolution == b->y_resolution
+		&& a->limit == b->limit && a->precision == b->precision && a->scale == b->scale
+		&& a->center_x.hi == b->center_x.hi && a->center_x.lo == b->center_x.lo
+		&& a->center_y.hi == b->center_y.hi && a->center_y.lo == b->center_y.lo;
+}
+
+int valid_tile_request( const struct tile_request * request ){
+	return request->type == TILE_REQUEST_RENDER
+		&& request->x_resolution > 0 && request->y_resolution > 0
+		&& (long long)request->x_resolution * request->y_resolution <= MAX_TILE_PIXELS
+		&& request->limit > 0 && request->scale > 0.0
+		&& (request->precision == PRECISION_AUTO || request->precision == PRECISION_DOUBLE
+			|| request->precision == PRECISION_PERTURBATION || request->precision == PRECISION_DOUBLE_DOUBLE);
+}
+
+// Called by every rank, with root's request, which is anything but a render to
+// have the other ranks stop. Only root's iterations are filled in.
+static void render_tile( struct tile_request * request, int * iterations, int root, MPI_Comm comm ){
+	MPI_Bcast( request, sizeof(*request), MPI_BYTE, root, comm );
+	if( request->type != TILE_REQUEST_RENDER ){
+		return;
+	}
+	struct mandelbrot_region region;
+	region.center_x = request->center_x;
+	region.center_y = request->center_y;
+	region.scale = request->scale;
+	region.x_resolution = request->x_resolution;
+	region.y_resolution = request->y_resolution;
+	region.limit = request->limit;
+	region.precision = request->precision;
+	mandelbrot_render_mpi( &region, 0, request->y_resolution, iterations, root, comm );
+}
+
+// Returns the listening socket, or -1 if path can not be served on.
+static int open_tile_socket( const char * path ){
+	struct sockaddr_un address;
+	if( strlen(path) >= sizeof(address.sun_path) ){
+		fprintf(stderr, "Socket path %s is too long.\n", path);
+		return -1;
+	}
+	// Only replace a socket left behind by a server that is gone.
+	int fd = connect_tile_server( path );
+	if( fd >= 0 ){
+		close( fd );
+		fprintf(stderr, "Something is already serving on %s.\n", path);
+		return -1;
+	}
+	unlink( path );
+
+	memset( &address, 0, sizeof(address) );
+	address.sun_family = AF_UNIX;
+	strcpy( address.sun_path, path );
+	fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if( fd < 0 || bind( fd, (struct sockaddr*)&address, sizeof(address) ) != 0 || listen( fd, SOMAXCONN ) != 0 ){
+		fprintf(stderr, "Could not serve on %s: %s.\n", path, strerror(errno));
+		if( fd >= 0 ){
+			close( fd );
+		}
+		return -1;
+	}
+	return fd;
+}
+
+// Bytes of the answer to a request.
+static long long response_bytes( const struct tile_request * request ){
+	long long size = sizeof(struct tile_response);
+	if( valid_tile_request( request ) ){
+		size += sizeof(int) * (long long)request->x_resolution * request->y_resolution;
+	}
+	return size;
+}
+
+static void queue_output( struct tile_connection * connection, const void * data, long long size ){
+	if( connection->output_size + size > connection->output_capacity ){
+		// Reuse the space already sent before growing.
+		if( connection->output_sent > 0 ){
+			memmove( connection->output, connection->output + connection->output_sent, connection->output_size - connection->output_sent );
+			connection->output_size -= connection->output_sent;
+			connection->output_sent = 0;
+		}
+		if( connection->output_size + size > connection->output_capacity ){
+			connection->output_capacity = connection->output_size + size;
+			connection->output = (char*)realloc(connection->output, connection->output_capacity);
+		}
+	}
+	memcpy( connection->output + connection->output_size, data, size );
+	connection->output_size += size;
+}
+
+// Send as much of a connection's answers as it will take without blocking, and
+// close it if it failed.
+static void flush_output( struct tile_connection * connection ){
+	while( connection->fd >= 0 && connection->output_sent < connection->output_size ){
+		ssize_t written = send( connection->fd, connection->output + connection->output_sent, connection->output_size - connection->output_sent, MSG_DONTWAIT | MSG_NOSIGNAL );
+		if( written < 0 && errno == EINTR ){
+			continue;
+		}
+		if( written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ){
+			return;
+		}
+		if( written <= 0 ){
+			close( connection->fd );
+			connection->fd = -1;
+		} else {
+			connection->output_sent += written;
+		}
+	}
+	// Let go of the space once everything is sent, since a single tile can be
+	// tens of megabytes.
+	free(connection->output);
+	connection->output = NULL;
+	connection->output_sent = 0;
+	connection->output_size = 0;
+	connection->output_capacity = 0;
+}
+
+// Read every whole request waiting on a connection, until the answers owed to
+// it reach MAX_QUEUED_BYTES. Sets stopping if a shutdown was requested.
+static void read_requests( struct tile_server * server, int connection_i ){
+	struct tile_connection * connection = &server->connections[connection_i];
+	long long owed = connection->output_size - connection->output_sent;
+	for( int pending_i=0; pending_i<server->num_pending; pending_i++ ){
+		if( server->pending[pending_i].connection_i == connection_i && !server->pending[pending_i].answered ){
+			owed += response_bytes( &server->pending[pending_i].request );
+		}
+	}
+	while( connection->fd >= 0 && !connection->read_closed && !server->stopping && owed < MAX_QUEUED_BYTES ){
+		ssize_t num_read = recv( connection->fd, connection->buffer + connection->filled, sizeof(connection->buffer) - connection->filled, MSG_DONTWAIT );
+		if( num_read < 0 && errno == EINTR ){
+			continue;
+		}
+		if( num_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ){
+			return;
+		}
+		if( num_read == 0 ){
+			// The client is done asking, but may still be reading.
+			connection->read_closed = 1;
+			return;
+		}
+		if( num_read < 0 ){
+			close( connection->fd );
+			connection->fd = -1;
+			return;
+		}
+		connection->filled += num_read;
+		if( connection->filled < (int)sizeof(connection->buffer) ){
+			continue;
+		}
+		connection->filled = 0;
+		struct tile_request request;
+		memcpy( &request, connection->buffer, sizeof(request) );
+		if( request.type == TILE_REQUEST_SHUTDOWN ){
+			server->stopping = 1;
+			return;
+		}
+		if( server->num_pending == server->pending_capacity ){
+			server->pending_capacity *= 2;
+			server->pending = (struct pending_tile*)realloc(server->pending, sizeof(struct pending_tile)*server->pending_capacity);
+		}
+		struct pending_tile * tile = &server->pending[server->num_pending];
+		tile->request = request;
+		tile->connection_i = connection_i;
+		tile->answered = 0;
+		server->num_pending++;
+		owed += response_bytes( &request );
+	}
+}
+
+// Answer every pending request, oldest first. Before each render the server
+// reads whatever requests have come in since, so identical requests share the
+// render even if they arrived while an earlier one was rendering, as long as
+// that keeps each connection's answers in the order it asked. A request for the
+// tile rendered last is answered again without rendering it.
+static void answer_pending( struct tile_server * server, int root, MPI_Comm comm, int verbose ){
+	int blocked[MAX_TILE_CLIENTS];
+	for( int first=0; first<server->num_pending; first++ ){
+		if( server->pending[first].answered ){
+			continue;
+		}
+		for( int connection_i=0; connection_i<server->num_connections; connection_i++ ){
+			read_requests( server, connection_i );
+		}
+		struct tile_request request = server->pending[first].request;
+		int valid = valid_tile_request( &request );
+
+		// A connection's next request can share the render if it is the same one.
+		// Past a different request, the rest of that connection has to wait.
+		for( int connection_i=0; connection_i<MAX_TILE_CLIENTS; connection_i++ ){
+			blocked[connection_i] = 0;
+		}
+		int num_coalesced = 0;
+		for( int pending_i=first; pending_i<server->num_pending; pending_i++ ){
+			struct pending_tile * tile = &server->pending[pending_i];
+			if( tile->answered || blocked[tile->connection_i] ){
+				continue;
+			}
+			if( valid && same_tile_request( &tile->request, &request ) ){
+				tile->answered = 2;
+				num_coalesced++;
+			} else {
+				blocked[tile->connection_i] = 1;
+			}
+		}
+		if( !valid ){
+			server->pending[first].answered = 2;
+			num_coalesced = 1;
+		}
+
+		struct tile_response response;
+		memset( &response, 0, sizeof(response) );
+		response.status = valid ? 0 : -1;
+		response.num_coalesced = num_coalesced;
+		long long num_pixels = 0;
+		if( valid ){
+			response.x_resolution = request.x_resolution;
+			response.y_resolution = request.y_resolution;
+			num_pixels = (long long)request.x_resolution * request.y_resolution;
+			if( server->have_last && same_tile_request( &server->last_request, &request ) ){
+				server->num_answered += num_coalesced;
+				response.num_coalesced = server->num_answered;
+			} else {
+				if( num_pixels > server->iterations_capacity ){
+					server->iterations_capacity = num_pixels;
+					server->iterations = (int*)realloc(server->iterations, sizeof(int)*num_pixels);
+				}
+				double begin = MPI_Wtime();
+				render_tile( &request, server->iterations, root, comm );
+				if( verbose ){
+					printf("Rendered a %d by %d tile for %d requests in %f seconds.\n", request.x_resolution, request.y_resolution, num_coalesced, MPI_Wtime() - begin);
+				}
+				server->last_request = request;
+				server->have_last = 1;
+				server->num_answered = num_coalesced;
+			}
+		}
+
+		for( int pending_i=first; pending_i<server->num_pending; pending_i++ ){
+			struct pending_tile * tile = &server->pending[pending_i];
+			if( tile->answered != 2 ){
+				continue;
+			}
+			tile->answered = 1;
+			struct tile_connection * connection = &server->connections[tile->connection_i];
+			if( connection->fd < 0 ){
+				continue;
+			}
+			queue_output( connection, &response, sizeof(response) );
+			queue_output( connection, server->iterations, sizeof(int) * num_pixels );
+		}
+		// Start the answers on their way before the next render.
+		for( int connection_i=0; connection_i<server->num_connections; connection_i++ ){
+			flush_output( &server->connections[connection_i] );
+		}
+	}
+	server->num_pending = 0;
+}
+
+// Accept connections on the socket and answer their requests until a client
+// asks for a shutdown or root is sent SIGINT or SIGTERM. Answers are sent as
+// each client takes them, so a client that does not read holds up no other.
+static void run_tile_server( int listen_fd, int root, MPI_Comm comm, int verbose ){
+	struct tile_server * server = (struct tile_server*)calloc(1, sizeof(struct tile_server));
+	server->pending_capacity = MAX_TILE_CLIENTS;
+	server->pending = (struct pending_tile*)malloc(sizeof(struct pending_tile)*server->pending_capacity);
+	struct pollfd fds[MAX_TILE_CLIENTS + 2];
+
+	while( !stop_serving ){
+		// After a shutdown request, only finish sending the answers before it.
+		int num_unsent = 0;
+		for( int connection_i=0; connection_i<server->num_connections; connection_i++ ){
+			num_unsent += server->connections[connection_i].output_sent < server->connections[connection_i].output_size;
+		}
+		if( server->stopping && num_unsent == 0 ){
+			break;
+		}
+
+		// Leave new connections waiting while every slot is taken, and requests
+		// waiting while too much is owed to their connection.
+		int num_fds = 0;
+		fds[num_fds].fd = stop_pipe[0];
+		fds[num_fds].events = POLLIN;
+		num_fds++;
+		fds[num_fds].fd = server->num_connections < MAX_TILE_CLIENTS && !server->stopping ? listen_fd : -1;
+		fds[num_fds].events = POLLIN;
+		num_fds++;
+		for( int connection_i=0; connection_i<server->num_connections; connection_i++ ){
+			struct tile_connection * connection = &server->connections[connection_i];
+			long long owed = connection->output_size - connection->output_sent;
+			int reading = !server->stopping && !connection->read_closed && owed < MAX_QUEUED_BYTES;
+			fds[num_fds].fd = connection->fd;
+			fds[num_fds].events = (reading ? POLLIN : 0) | (owed > 0 ? POLLOUT : 0);
+			num_fds++;
+		}
+		if( poll( fds, num_fds, -1 ) < 0 ){
+			if( errno == EINTR ){
+				continue;
+			}
+			break;
+		}
+
+		for( int connection_i=0; connection_i<server->num_connections; connection_i++ ){
+			struct pollfd * fd = &fds[connection_i + 2];
+			struct tile_connection * connection = &server->connections[connection_i];
+			if( fd->revents == 0 ){
+				continue;
+			}
+			flush_output( connection );
+			if( fd->events & POLLIN ){
+				read_requests( server, connection_i );
+			} else if( (fd->revents & (POLLHUP | POLLERR)) && connection->fd >= 0 ){
+				// Gone while it was not being read, with nothing left to send it.
+				close( connection->fd );
+				connection->fd = -1;
+			}
+		}
+		answer_pending( server, root, comm, verbose );
+
+		// Drop closed connections, and those done asking once they have all their
+		// answers, now nothing refers to them by index.
+		int num_open = 0;
+		for( int connection_i=0; connection_i<server->num_connections; connection_i++ ){
+			struct tile_connection * connection = &server->connections[connection_i];
+			if( connection->fd >= 0 && connection->read_closed && connection->output_sent == connection->output_size ){
+				close( connection->fd );
+				connection->fd = -1;
+			}
+			if( connection->fd >= 0 ){
+				server->connections[num_open] = *connection;
+				num_open++;
+			} else {
+				free(connection->output);
+			}
+		}
+		server->num_connections = num_open;
+
+		if( (fds[1].revents & POLLIN) && server->num_connections < MAX_TILE_CLIENTS && !server->stopping ){
+			int fd = accept( listen_fd, NULL, NULL );
+			if( fd >= 0 ){
+				fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );
+				struct tile_connection * connection = &server->connections[server->num_connections];
+				memset( connection, 0, sizeof(*connection) );
+				connection->fd = fd;
+				server->num_connections++;
+			}
+		}
+	}
+
+	for( int connection_i=0; connection_i<server->num_connections; connection_i++ ){
+		close( server->connections[connection_i].fd );
+		free(server->connections[connection_i].output);
+	}
+	free(server->pending);
+	free(server->iterations);
+	free(server);
+}
+
+// Keep every rank of comm rendering tiles requested over the Unix domain socket
+// at path, until told to stop. Root talks to the clients, the other ranks only
+// help render. Must be called by every rank. Returns -1 on root if the socket
+// could not be opened, and 0 otherwise.
+int serve_tiles( const char * path, int root, MPI_Comm comm, int verbose ){
+	int my_rank;
+	MPI_Comm_rank( comm, &my_rank );
+	struct tile_request request;
+	if( my_rank != root ){
+		do {
+			render_tile( &request, NULL, root, comm );
+		} while( request.type == TILE_REQUEST_RENDER );
+		return 0;
+	}
+
+	int status = 0;
+	int listen_fd = open_tile_socket( path );
+	if( listen_fd >= 0 && pipe( stop_pipe ) != 0 ){
+		fprintf(stderr, "Could not serve on %s: %s.\n", path, strerror(errno));
+		close( listen_fd );
+		unlink( path );
+		listen_fd = -1;
+	}
+	if( listen_fd >= 0 ){
+		// Neither end may block, the handler least of all.
+		fcntl( stop_pipe[0], F_SETFL, fcntl( stop_pipe[0], F_GETFL ) | O_NONBLOCK );
+		fcntl( stop_pipe[1], F_SETFL, fcntl( stop_pipe[1], F_GETFL ) | O_NONBLOCK );
+		struct sigaction action;
+		memset( &action, 0, sizeof(action) );
+		action.sa_handler = handle_stop_signal;
+		sigaction( SIGINT, &action, NULL );
+		sigaction( SIGTERM, &action, NULL );
+		if( verbose ){
+			printf("Serving tiles on %s.\n", path);
+			fflush(stdout);
+		}
+		run_tile_server( listen_fd, root, comm, verbose );
+		close( listen_fd );
+		unlink( path );
+		// Leave the handler with nothing to write to.
+		signal( SIGINT, SIG_DFL );
+		signal( SIGTERM, SIG_DFL );
+		close( stop_pipe[0] );
+		close( stop_pipe[1] );
+		stop_pipe[0] = -1;
+		stop_pipe[1] = -1;
+	} else {
+		status = -1;
+	}
+
+	// Release the other ranks.
+	memset( &request, 0, sizeof(request) );
+	request.type = TILE_REQUEST_SHUTDOWN;
+	render_tile( &request, NULL, root, comm );
+	return status;
+}
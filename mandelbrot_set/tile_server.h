@@ -0,0 +1,15 @@
+#ifndef TILE_SERVER_H
+#define TILE_SERVER_H
+
+#include <mpi.h>
+
+#include "tile_protocol.h"
+
+// Most connections the server keeps open at once. More wait to be accepted.
+#define MAX_TILE_CLIENTS 64
+
+int same_tile_request( const struct tile_request * a, const struct tile_request * b );
+int valid_tile_request( const struct tile_request * request );
+int serve_tiles( const char * path, int root, MPI_Comm comm, int verbose );
+
+#endif
@@ -5,6 +5,8 @@
 #include <time.h>
 
 #include "twin_prime.c"
+#include "../common/trace.c"
+#include "../common/perf_counters.c"
 
 #define ROOT_RANK 0
 
@@ -14,12 +16,17 @@ static char args_doc[] = "Number of twin primes to calculate Size of batch";
 
 static struct argp_option options[] = {
 	{ "verbose", 'v', 0, 0, "Provide verbose output." },
+	{ "trace", 'T', "FILE", 0, "Write a timeline of when each rank tested numbers, communicated and, for root, checked for twins to FILE in the Chrome trace format, for chrome://tracing or ui.perfetto.dev. Needs a build with make TRACE=1." },
+	{ "counters", 'H', "FILE", OPTION_ARG_OPTIONAL, "Count cycles, instructions, cache and branch misses of each rank while it tests numbers and, for root, checks for twins, and print the minimum, mean and maximum over the ranks, or write them to FILE as JSON, e.g. --counters=counters.json. Counters the machine does not offer, as in many virtual machines and containers, are reported as unavailable." },
 	{ 0 }
 };
 
 struct arguments {
 	char *args[2];
 	int verbose;
+	char *trace_file;
+	int counters;
+	char *counters_file;
 };
 
 static error_t parse_opt( int key, char *arg, struct argp_state *state) {
@@ -28,6 +35,13 @@ static error_t parse_opt( int key, char *arg, struct argp_state *state) {
 		case 'v':
 			arguments->verbose = 1;
 			break;
+		case 'T':
+			arguments->trace_file = arg;
+			break;
+		case 'H':
+			arguments->counters = 1;
+			arguments->counters_file = arg;
+			break;
 		case ARGP_KEY_ARG:
 			if( state->arg_num >= 2 ){
 				argp_usage( state );
@@ -49,8 +63,11 @@ static struct argp argp = { options, parse_opt, args_doc, doc };
 
 int main(int argc, char **argv){
 
-	int n, batch_size, verbose;
-	int * arguments_buffer = (int*)malloc(sizeof(int)*3);
+	int n, batch_size, verbose, counting;
+	int * arguments_buffer = (int*)malloc(sizeof(int)*5);
+	// Only root writes the trace and counters, so only root needs their names.
+	char * trace_file = NULL;
+	char * counters_file = NULL;
 
 	int my_rank, n_procs;
 
@@ -63,24 +80,46 @@ int main(int argc, char **argv){
 	if(my_rank == ROOT_RANK) {
 		struct arguments arguments;
 		arguments.verbose = 0;
+		arguments.trace_file = NULL;
+		arguments.counters = 0;
+		arguments.counters_file = NULL;
 
 		argp_parse (&argp, argc, argv, 0, 0, &arguments);
 
+#ifndef TRACE
+		if( arguments.trace_file != NULL ){
+			fprintf(stderr, "--trace needs a build with tracing compiled in, make TRACE=1.\n");
+			MPI_Abort( MPI_COMM_WORLD, 1 );
+		}
+#endif
+
 		sscanf(arguments.args[0],"%d",&arguments_buffer[0]);
 		sscanf(arguments.args[1],"%d",&arguments_buffer[1]);
 		arguments_buffer[2] = arguments.verbose;
+		arguments_buffer[3] = arguments.trace_file != NULL;
+		arguments_buffer[4] = arguments.counters;
+		trace_file = arguments.trace_file;
+		counters_file = arguments.counters_file;
 	}
 
 	// Broadcast the command line arguments processed by root.
 	// TODO: Calculate number of values to send from structure of arguments
-	MPI_Bcast( arguments_buffer, 3, MPI_INT, ROOT_RANK, MPI_COMM_WORLD );
+	MPI_Bcast( arguments_buffer, 5, MPI_INT, ROOT_RANK, MPI_COMM_WORLD );
 
 	n = arguments_buffer[0];
 	batch_size = arguments_buffer[1];
 	verbose = arguments_buffer[2];
+	// Only read when tracing is compiled in.
+#ifdef TRACE
+	int tracing = arguments_buffer[3];
+#endif
+	counting = arguments_buffer[4];
 
 	free(arguments_buffer);
 
+	TRACE_INIT( tracing, MPI_COMM_WORLD );
+	counters_init( counting, MPI_COMM_WORLD );
+
 	// Variables all processes will use.
 	int found_nth_prime = 0;
 	long long iteration = 0;
@@ -108,16 +147,24 @@ int main(int argc, char **argv){
 
 	while( !found_nth_prime ){
 		// Each process calculates if a different number is prime.
+		TRACE_BEGIN( "is_prime" );
+		counters_begin( "is_prime" );
 		for( int index=0; index<batch_size; index++ ){
 			long long num = 2 + my_rank * batch_size + (primes_per_iter * iteration) + index;
 			result_batch[ index ] = is_prime( num );
 		}
+		counters_end();
+		TRACE_END();
 
 		// Gather results of prime calculations.
+		TRACE_BEGIN( "MPI_Gather" );
 		MPI_Gather( result_batch, batch_size, MPI_INT, gathered_results, batch_size, MPI_INT, ROOT_RANK, MPI_COMM_WORLD );
+		TRACE_END();
 
 		// Have the root process check for the presence of twin primes.
 		if(my_rank == ROOT_RANK){
+			TRACE_BEGIN( "find twins" );
+			counters_begin( "find twins" );
 			for( int index=0; index<primes_per_iter; index++ ){
 				long long num = 2 + index + (primes_per_iter * iteration);
 				if( gathered_results[index] ){
@@ -133,11 +180,15 @@ int main(int argc, char **argv){
 					last_prime = num;
 				}
 			}
+			counters_end();
+			TRACE_END();
 		}
 
 		// Scatter the root's found_nth_prime to report whether the processes can all
 		// stop.
+		TRACE_BEGIN( "MPI_Scatter" );
 		MPI_Scatter( found_nth_prime_buffer, 1, MPI_INT, &found_nth_prime, 1, MPI_INT, ROOT_RANK, MPI_COMM_WORLD );
+		TRACE_END();
 
 		iteration++;
 	}
@@ -154,6 +205,13 @@ int main(int argc, char **argv){
 		free(found_nth_prime_buffer);
   }
 
+	if( TRACE_FINISH( trace_file, ROOT_RANK ) != 0 ){
+		fprintf(stderr, "Could not write the trace to %s.\n", trace_file);
+	}
+	if( counters_finish( counters_file, ROOT_RANK ) != 0 ){
+		fprintf(stderr, "Could not write the counters to %s.\n", counters_file);
+	}
+
 	MPI_Finalize();
 	return 0;
 }
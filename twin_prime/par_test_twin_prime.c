@@ -62,12 +62,54 @@ void test_batch_size_does_not_change(){
 	CU_ASSERT(strcmp(seq_result, par_result) == 0);
 }
 
+void test_counters_have_every_rank(){
+	char seq_result[BUFSIZE] = {0};
+	char par_result[BUFSIZE] = {0};
+	char count[BUFSIZE] = {0};
+
+	// Counting must not change the answer, even where the counters are unavailable.
+	run_command( "./seq_twin_prime 10", seq_result );
+	run_command( "mpirun -np 3 ./par_twin_prime 10 1 --counters=temp_counters.json", par_result );
+	CU_ASSERT(strcmp(seq_result, par_result) == 0);
+
+	// Every rank tests numbers, and only root checks for twins.
+	run_command( "grep -c '\"name\":\"is_prime\",\"ranks\":3,' temp_counters.json", count );
+	CU_ASSERT(strcmp(count, "1\n") == 0);
+	run_command( "grep -c '\"name\":\"find twins\",\"ranks\":1,' temp_counters.json", count );
+	CU_ASSERT(strcmp(count, "1\n") == 0);
+	system("rm temp_counters.json");
+}
+
+#ifdef TRACE
+void test_trace_has_every_rank(){
+	char seq_result[BUFSIZE] = {0};
+	char par_result[BUFSIZE] = {0};
+	char count[BUFSIZE] = {0};
+
+	// Tracing must not change the answer.
+	run_command( "./seq_twin_prime 10", seq_result );
+	run_command( "mpirun -np 3 ./par_twin_prime 10 1 -T temp_trace.json", par_result );
+	CU_ASSERT(strcmp(seq_result, par_result) == 0);
+
+	// Each rank is named once, and gathers at least once.
+	run_command( "grep -c '\"name\":\"rank [0-2]\"' temp_trace.json", count );
+	CU_ASSERT(strcmp(count, "3\n") == 0);
+	run_command( "grep '\"name\":\"MPI_Gather\"' temp_trace.json | grep -o '\"tid\":[0-9]*' | sort -u | wc -l", count );
+	CU_ASSERT(strcmp(count, "3\n") == 0);
+	system("rm temp_trace.json");
+}
+#endif
+
 int main(){
 	CU_initialize_registry();
 	CU_pSuite suite = CU_add_suite("AddTestSuite", 0, 0);
 	CU_add_test(suite, "test that par_main.c reports the same values as seq_main.c", test_par_against_seq);
 	CU_add_test(suite, "test that par_main.c's output does not change for different numbers of processes", test_num_processes_does_not_change);
 	CU_add_test(suite, "test that par_main.c's output does not change for different batch sizes", test_batch_size_does_not_change);
+	CU_add_test(suite, "test that par_main.c counts every rank", test_counters_have_every_rank);
+#ifdef TRACE
+	CU_add_test(suite, "test that par_main.c traces every rank", test_trace_has_every_rank);
+#endif
 	CU_basic_run_tests();
 	CU_cleanup_registry();
 	return 0;